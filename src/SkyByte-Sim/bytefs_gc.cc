@@ -3,8 +3,71 @@
 #include "bytefs_heap.h"
 #include "bytefs_utils.h"
 #include "simulator_clock.h"
+#include "ssd_stat.h"
 
 extern sim_clock* the_clock_pt;
+extern bool multi_stream_enable;
+
+gc_policy_enum gc_policy = GC_GREEDY;
+int gc_fg_threshold = 20;   /* % of blocks free below which GC blocks the flusher */
+int gc_bg_threshold = 0;    /* % of blocks free below which idle-time GC runs, 0 disables */
+
+bool parse_gc_policy(const std::string &name, gc_policy_enum *policy) {
+  if (name == "GREEDY")             { *policy = GC_GREEDY; }
+  else if (name == "COST_BENEFIT")  { *policy = GC_COST_BENEFIT; }
+  else if (name == "WEAR_AWARE")    { *policy = GC_WEAR_AWARE; }
+  else                              { return false; }
+  return true;
+}
+
+bool gc_thresholds_valid(void) {
+  if (gc_fg_threshold <= 0 || gc_fg_threshold >= GC_STOP_THRESHOLD_PCT)
+    return false;
+  return gc_bg_threshold == 0 ||
+         (gc_bg_threshold > gc_fg_threshold && gc_bg_threshold < GC_STOP_THRESHOLD_PCT);
+}
+
+const char *gc_policy_name(gc_policy_enum policy) {
+  switch (policy) {
+    case GC_GREEDY:       return "GREEDY";
+    case GC_COST_BENEFIT: return "COST_BENEFIT";
+    case GC_WEAR_AWARE:   return "WEAR_AWARE";
+  }
+  return "UNKNOWN";
+}
+
+/**
+ * Heap key of a GC candidate, the heap pops the smallest key first. Greedy
+ * takes the block with the fewest valid pages; cost-benefit weighs the space
+ * freed (1 - u) against the copy cost (1 + u) and favors data left untouched
+ * the longest, keyed as the shortfall from the largest benefit possible at
+ * the current write sequence so keys stay non-negative; wear-aware charges
+ * every erase above the least worn block 1/GC_WEAR_WINDOW of a block's worth
+ * of valid pages.
+ */
+static int64_t bytefs_gc_victim_key(struct ssd *ssd, int vpc, int npgs, int erase_cnt,
+                                    uint64_t last_write_seq, int min_erase_cnt) {
+  switch (gc_policy) {
+    case GC_COST_BENEFIT: {
+      double max_age = (double) (ssd->gc_write_seq + 1);
+      double age = (double) (ssd->gc_write_seq - last_write_seq + 1);
+      int64_t key = (int64_t) (max_age * npgs) - (int64_t) (age * (npgs - vpc) / (npgs + vpc) * npgs);
+      bytefs_assert(key >= 0);
+      return key;
+    }
+    case GC_WEAR_AWARE:
+      return vpc + (int64_t) (erase_cnt - min_erase_cnt) * npgs / GC_WEAR_WINDOW;
+    case GC_GREEDY:
+    default:
+      return vpc;
+  }
+}
+
+/* valid page ratio of a victim when GC picks it, the main driver of GC copy cost */
+static inline void bytefs_gc_record_victim(int vpc, int npgs) {
+  int bucket = (int) ((int64_t) vpc * GC_VPC_BUCKETS / npgs);
+  SSD_STAT_ATOMIC_INC(gc_victim_vpc_distribution[bucket < GC_VPC_BUCKETS ? bucket : GC_VPC_BUCKETS - 1]);
+}
 
 #if ALLOCATION_SECHEM_LINE
 static void bytefs_push_back_free_list(struct ssd *ssd, struct ssd_superblock *sb) {
@@ -193,8 +256,10 @@ int bytefs_gc_init(struct ssd *ssd) {
     return -1;
   }
   heap_create(ssd->gc_heaps, ssd->sp.sb_per_ssd);
-  ssd->free_blk_lo_threshold = ssd->sp.blks_per_ch * ssd->sp.nchs * 20 / 100;   //TODO: change this to adjustable value in the future
-  ssd->free_blk_hi_threshold = ssd->sp.blks_per_ch * ssd->sp.nchs * 35 / 100;
+  bytefs_assert_msg(gc_thresholds_valid(), "Invalid GC thresholds fg %d bg %d", gc_fg_threshold, gc_bg_threshold);
+  ssd->free_blk_lo_threshold = ssd->sp.blks_per_ch * ssd->sp.nchs * gc_fg_threshold / 100;
+  ssd->free_blk_hi_threshold = ssd->sp.blks_per_ch * ssd->sp.nchs * GC_STOP_THRESHOLD_PCT / 100;
+  ssd->free_blk_bg_threshold = ssd->sp.blks_per_ch * ssd->sp.nchs * gc_bg_threshold / 100;
 
   bytefs_gc_reset(ssd);
   return 0;
@@ -223,6 +288,7 @@ int bytefs_gc_init(struct ssd *ssd) {
   }
   ssd->free_blk_lo_threshold = ssd->sp.blks_per_ch * ssd->sp.nchs * 10 / 100;
   ssd->free_blk_hi_threshold = ssd->sp.blks_per_ch * ssd->sp.nchs * 25 / 100;
+  ssd->free_blk_bg_threshold = 0;
 
   bytefs_gc_reset(ssd);
   return 0;
@@ -238,6 +304,7 @@ void bytefs_gc_reset(struct ssd *ssd) {
   nand_block *blk;
   struct ssd_superblock *sb;
   ssd->total_free_sbs = 0;
+  ssd->gc_write_seq = 0;
   // The free list
   ssd->free_sbs->sbs_start = NULL;
   ssd->free_sbs->sbs_end = NULL;
@@ -257,6 +324,7 @@ void bytefs_gc_reset(struct ssd *ssd) {
     sb = &ssd->sb[sb_idx];
     sb->blk_idx = sb_idx;
     sb->is_candidate = 0;
+    sb->is_open = 0;
     bytefs_push_back_free_list(ssd, sb);
   }
   // The GC candidate list
@@ -265,6 +333,7 @@ void bytefs_gc_reset(struct ssd *ssd) {
   ssd->gc_candidate_sbs->num_sbs = 0;
   // The GC candidate heap
   heap_clear(ssd->gc_heaps);
+  ssd->gc_heaps_seq = UINT64_MAX;
 }
 #else
 void bytefs_gc_reset(struct ssd *ssd) {
@@ -272,6 +341,7 @@ void bytefs_gc_reset(struct ssd *ssd) {
   int ch_idx, way_idx, blk_idx;
   nand_block *blk;
   ssd->total_free_blks = 0;
+  ssd->gc_write_seq = 0;
   for (ch_idx = 0; ch_idx < spp->nchs; ch_idx++) {
     // Per channel free list
     ssd->free_blks[ch_idx].blocks_start = NULL;
@@ -343,7 +413,8 @@ void bytefs_try_add_gc_candidate_ppa(struct ssd *ssd, struct ppa *ppa) {
 
 #if ALLOCATION_SECHEM_LINE
 void bytefs_try_add_gc_candidate_sb(struct ssd *ssd, struct ssd_superblock *sb) {
-  if (sb->is_candidate || is_sb_free(ssd, sb)) return;
+  // with multi-stream on, open superblocks join once their write stream moves on
+  if (sb->is_candidate || (multi_stream_enable && sb->is_open) || is_sb_free(ssd, sb)) return;
   bytefs_push_back_candidate_list(ssd, sb);
 }
 #else
@@ -387,6 +458,24 @@ int bytefs_should_start_gc(struct ssd *ssd) {
 }
 #endif
 
+#if ALLOCATION_SECHEM_LINE
+int bytefs_should_start_bg_gc(struct ssd *ssd, uint64_t now) {
+  int ch_idx, lun_idx;
+  if (ssd->total_free_sbs > ssd->free_blk_bg_threshold / ssd->sp.tt_luns)
+    return 0;
+  // only when no LUN is busy, so user I/O does not queue behind it
+  for (ch_idx = 0; ch_idx < ssd->sp.nchs; ch_idx++)
+    for (lun_idx = 0; lun_idx < ssd->sp.luns_per_ch; lun_idx++)
+      if (ssd->ch[ch_idx].lun[lun_idx].next_lun_avail_time > now)
+        return 0;
+  return 1;
+}
+#else
+int bytefs_should_start_bg_gc(struct ssd *ssd, uint64_t now) {
+  return 0;
+}
+#endif
+
 #if ALLOCATION_SECHEM_LINE
 int bytefs_should_stop_gc(struct ssd *ssd) {
   return ssd->total_free_sbs >= ssd->free_blk_hi_threshold / ssd->sp.tt_luns;
@@ -398,16 +487,22 @@ int bytefs_should_stop_gc(struct ssd *ssd) {
 #endif
 
 #if ALLOCATION_SECHEM_LINE
+static void put_sb_back_to_candidates(struct ssd *ssd);
+
 void bytefs_generate_gc_heaps(struct ssd *ssd) {
   int ch_idx;
   struct ssd_superblock *sb;
   int max_heap_len = ssd->sp.tt_blks / ssd->sp.tt_luns;
-  heap_clear(ssd->gc_heaps);
+  int min_erase_cnt;
+  // background GC leaves its heap standing between victims
+  put_sb_back_to_candidates(ssd);
   bytefs_add_everyting_to_candidate_list(ssd);
+  bytefs_gc_erase_spread(ssd, &min_erase_cnt, NULL, NULL);
   sb = bytefs_get_front_candidate_list(ssd);
   while (sb && ssd->gc_heaps->count < max_heap_len) {
     bytefs_rm_front_candidate_list(ssd);
-    heap_insert(ssd->gc_heaps, sb->vpc, sb);
+    heap_insert(ssd->gc_heaps, bytefs_gc_victim_key(ssd, sb->vpc, ssd->sp.pgs_per_sb,
+                sb->erase_cnt, sb->last_write_seq, min_erase_cnt), sb);
     sb = bytefs_get_front_candidate_list(ssd);
   }
 }
@@ -416,13 +511,16 @@ void bytefs_generate_gc_heaps(struct ssd *ssd) {
   int ch_idx;
   nand_block *blk;
   int max_heap_len = ssd->free_blk_hi_threshold - ssd->free_blk_lo_threshold;
+  int min_erase_cnt;
+  bytefs_gc_erase_spread(ssd, &min_erase_cnt, NULL, NULL);
   for (ch_idx = 0; ch_idx < ssd->sp.nchs; ch_idx++) {
     heap_clear(&ssd->gc_heaps[ch_idx]);
     bytefs_add_everyting_to_candidate_list(ssd, ch_idx);
     blk = bytefs_get_front_candidate_list(ssd, ch_idx);
     while (blk && ssd->gc_heaps[ch_idx].count < max_heap_len) {
       bytefs_rm_front_candidate_list(ssd, ch_idx);
-      heap_insert(&ssd->gc_heaps[ch_idx], blk->vpc, blk);
+      heap_insert(&ssd->gc_heaps[ch_idx], bytefs_gc_victim_key(ssd, blk->vpc, ssd->sp.pgs_per_blk,
+                  blk->erase_cnt, blk->last_write_seq, min_erase_cnt), blk);
       blk = bytefs_get_front_candidate_list(ssd, ch_idx);
     }
   }
@@ -530,21 +628,102 @@ static void put_nand_blk_back_to_candidates(struct ssd *ssd) {
 #endif
 
 #if ALLOCATION_SECHEM_LINE
-void bytefs_gc(struct ssd *ssd) {      //TODO: how do the GC time work?
+/**
+ * Migrate the valid pages of @gc_sb, erase it and put it on the free list.
+ * The pages of the whole superblock are remapped first, under one mapping
+ * lock hold per block, then their reads, programs and the erases go to the
+ * flush workers as per-LUN batches so every LUN timeline runs in parallel.
+ */
+static void bytefs_gc_reclaim_sb(struct ssd *ssd, struct ssd_superblock *gc_sb) {
   ssdparams *spp = &ssd->sp;
-  struct ssd_superblock *gc_sb;
   nand_block *gc_blk;
   ppa free_blk_ppa, gc_blk_pba;
   uint64_t gc_page_lpn;
-  uint64_t current_time;
-  nand_cmd cmd;
+  uint64_t current_time, done_time;
+  std::vector<nand_batch_cmd> reads, writes, erases;
   int ch_idx = 0, lun_idx = 0, pg_off;
 
+  current_time = the_clock_pt->get_time_sim(); //TODO: replace, done
+  done_time = current_time;
+  bytefs_gc_record_victim(gc_sb->vpc, spp->pgs_per_sb);
+  reads.reserve(gc_sb->vpc);
+  writes.reserve(gc_sb->vpc);
+  erases.reserve(spp->nchs * spp->luns_per_ch);
+  gc_blk_pba = bytefs_get_pba_from_sb(gc_sb);
+  for (ch_idx = 0; ch_idx < spp->nchs; ch_idx++) {
+    for (lun_idx = 0; lun_idx < spp->luns_per_ch; lun_idx++) {
+      gc_blk = &ssd->ch[ch_idx].lun[lun_idx].blk[gc_sb->blk_idx];
+      gc_blk_pba.g.ch = ch_idx;
+      gc_blk_pba.g.lun = lun_idx;
+      gc_blk_pba.g.blk = gc_sb->blk_idx;
+      gc_blk_pba.g.pg = 0;
+      if (gc_blk->vpc != 0) {
+        ssd->maptbl_update_mutex.lock();
+        for (pg_off = 0; pg_off < ssd->sp.pgs_per_blk; pg_off++) {
+          // get ppa of current GC block
+          gc_blk_pba.g.pg = pg_off;
+
+          ppa2pgidx(ssd, &gc_blk_pba);
+          // data migration if this ppa is valid
+          gc_page_lpn = get_rmap_ent(ssd, &gc_blk_pba);
+          if (gc_page_lpn != INVALID_LPN) {
+            // validate the copied entries
+            free_blk_ppa = get_new_page(ssd, WS_GC);
+
+            nand_page *pg = &ssd->ch[free_blk_ppa.g.ch].lun[free_blk_ppa.g.lun].blk[free_blk_ppa.g.blk].pg[free_blk_ppa.g.pg];
+            bytefs_assert(pg->status == PG_FREE);
+
+            set_maptbl_ent(ssd, gc_page_lpn, &free_blk_ppa);
+            set_rmap_ent(ssd, gc_page_lpn, &free_blk_ppa);
+            mark_page_valid(ssd, &free_blk_ppa);
+            ssd_advance_write_pointer(ssd, WS_GC);
+            reads.push_back({gc_blk_pba, {GC_IO, NAND_READ, current_time}, 0});
+            writes.push_back({free_blk_ppa, {GC_IO, NAND_WRITE, 0}, 0});
+          }
+        }
+        ssd->maptbl_update_mutex.unlock();
+      }
+      erases.push_back({gc_blk_pba, {GC_IO, NAND_ERASE, current_time}, 0});
+    }
+  }
+
+  // interact with nand flash, every page is programmed once its own read completed
+  nand_batch_issue(ssd, reads.data(), reads.size());
+  for (size_t i = 0; i < reads.size(); i++) {
+    backend_rw(ssd->bd, reads[i].addr.realppa, ssd->gc_buffer, 0);
+    writes[i].cmd.stime = current_time + reads[i].lat;
+    backend_rw(ssd->bd, writes[i].addr.realppa, ssd->gc_buffer, 1);
+  }
+  nand_batch_issue(ssd, writes.data(), writes.size());
+  for (size_t i = 0; i < writes.size(); i++)
+    done_time = std::max(done_time, writes[i].cmd.stime + writes[i].lat);
+  SSD_STAT_ATOMIC_ADD(gc_migrated_pages, writes.size());
+
+  // erase origional blocks, mark them as free and add the superblock to the free list
+  nand_batch_issue(ssd, erases.data(), erases.size());
+  for (size_t i = 0; i < erases.size(); i++) {
+    done_time = std::max(done_time, current_time + erases[i].lat);
+    gc_blk = &ssd->ch[erases[i].addr.g.ch].lun[erases[i].addr.g.lun].blk[gc_sb->blk_idx];
+    mark_block_free(ssd, &erases[i].addr);
+    bytefs_assert(gc_blk->vpc == 0);
+    bytefs_assert(gc_blk->ipc == 0);
+  }
+  ssd_stat_record_lat(LAT_GC, done_time - current_time);
+
+  mark_sb_free(ssd, gc_sb);
+  bytefs_assert(gc_sb->vpc == 0);
+  bytefs_assert(gc_sb->ipc == 0);
+  bytefs_push_back_free_list(ssd, gc_sb);
+}
+
+void bytefs_gc(struct ssd *ssd) {      //TODO: how do the GC time work?
+  struct ssd_superblock *gc_sb;
+
   // iterate over GC sbs and gather valid pages
       
   bytefs_generate_gc_heaps(ssd);
+  ssd->gc_heaps_seq = UINT64_MAX;
   while (1) {
-    current_time = the_clock_pt->get_time_sim(); //TODO: replace, done
     // get new superblock that is ready for GC
     gc_sb = bytefs_gc_find_next_gc_sb(ssd);
     if (gc_sb == NULL) {
@@ -553,74 +732,8 @@ void bytefs_gc(struct ssd *ssd) {      //TODO: how do the GC time work?
       return;
     }
 
-    gc_blk_pba = bytefs_get_pba_from_sb(gc_sb);
-    // if (gc_sb->vpc != 0) {
-    for (ch_idx = 0; ch_idx < spp->nchs; ch_idx++) {
-      for (lun_idx = 0; lun_idx < spp->luns_per_ch; lun_idx++) {
-        gc_blk = &ssd->ch[ch_idx].lun[lun_idx].blk[gc_sb->blk_idx];
-        gc_blk_pba.g.ch = ch_idx;
-        gc_blk_pba.g.lun = lun_idx;
-        gc_blk_pba.g.blk = gc_sb->blk_idx;
-        gc_blk_pba.g.pg = 0;
-        if (gc_blk->vpc != 0) {
-          for (pg_off = 0; pg_off < ssd->sp.pgs_per_blk; pg_off++) {
-            // get ppa of current GC block
-            gc_blk_pba.g.pg = pg_off;
-
-            ssd->maptbl_update_mutex.lock();
-
-            ppa2pgidx(ssd, &gc_blk_pba);
-            // data migration if this ppa is valid
-            gc_page_lpn = get_rmap_ent(ssd, &gc_blk_pba);
-            if (gc_page_lpn != INVALID_LPN) {
-              // interact with nand flash
-              cmd.type = GC_IO;
-              cmd.cmd = NAND_READ;
-              cmd.stime = current_time;
-              // FIXME: CHECK THIS LATER
-              ssd_advance_status(ssd, &gc_blk_pba, &cmd);
-              backend_rw(ssd->bd, gc_blk_pba.realppa, ssd->gc_buffer, 0);
-              // validate the copied entries
-              free_blk_ppa = get_new_page(ssd);
-
-              // nand_block *blk = get_blk(ssd, free_blk_ppa);
-              // nand_page* pg = &(blk->pg[free_blk_ppa.g.pg]);
-              nand_page *pg = &ssd->ch[free_blk_ppa.g.ch].lun[free_blk_ppa.g.lun].blk[free_blk_ppa.g.blk].pg[free_blk_ppa.g.pg];
-              //std::cout<<"*New page: channel: "<<free_blk_ppa.g.ch<<", lun: "<<free_blk_ppa.g.lun<<", blk: "<<free_blk_ppa.g.blk<<", page: "<<free_blk_ppa.g.pg<<", status: "<<pg->status<<std::endl;
-              bytefs_assert(pg->status == PG_FREE);
-
-              set_maptbl_ent(ssd, gc_page_lpn, &free_blk_ppa);
-              set_rmap_ent(ssd, gc_page_lpn, &free_blk_ppa);
-              mark_page_valid(ssd, &free_blk_ppa);
-              // interact with nand flash
-              cmd.type = GC_IO;
-              cmd.cmd = NAND_WRITE;
-              cmd.stime = current_time;
-              ssd_advance_status(ssd, &free_blk_ppa, &cmd);
-              backend_rw(ssd->bd, free_blk_ppa.realppa, ssd->gc_buffer, 1);
-              ssd_advance_write_pointer(ssd);
-            }
-
-            ssd->maptbl_update_mutex.unlock();
-          }
-        }
-        // erase origional block
-        cmd.type = GC_IO;
-        cmd.cmd = NAND_ERASE;
-        cmd.stime = current_time;
-        ssd_advance_status(ssd, &gc_blk_pba, &cmd);
-        // mark if as free and add to free list
-        mark_block_free(ssd, &gc_blk_pba);
-        bytefs_assert(gc_blk->vpc == 0);
-        bytefs_assert(gc_blk->ipc == 0);
-      }
-    }
-    // }
-    
-    mark_sb_free(ssd, gc_sb);
-    bytefs_assert(gc_sb->vpc == 0);
-    bytefs_assert(gc_sb->ipc == 0);
-    bytefs_push_back_free_list(ssd, gc_sb);
+    bytefs_gc_reclaim_sb(ssd, gc_sb);
+    SSD_STAT_ATOMIC_INC(gc_fg_victims);
 
     // if GC should end, try end it
     if (bytefs_should_stop_gc(ssd)) {
@@ -630,6 +743,41 @@ void bytefs_gc(struct ssd *ssd) {      //TODO: how do the GC time work?
     }
   }
 }
+
+/**
+ * reclaim a single victim, called while the flash is idle. Victim keys and
+ * candidates only change once pages are programmed, so the heap is rebuilt
+ * only when gc_write_seq moved or a victim was taken since it was built.
+ */
+void bytefs_gc_background(struct ssd *ssd) {
+  struct ssd_superblock *gc_sb;
+
+  if (ssd->gc_heaps_seq != ssd->gc_write_seq) {
+    bytefs_generate_gc_heaps(ssd);
+    ssd->gc_heaps_seq = ssd->gc_write_seq;
+  }
+  gc_sb = bytefs_gc_find_next_gc_sb(ssd);
+  if (gc_sb == NULL)
+    return;
+  bytefs_gc_reclaim_sb(ssd, gc_sb);
+  SSD_STAT_ATOMIC_INC(gc_bg_victims);
+  // the erase changed the wear the keys depend on
+  ssd->gc_heaps_seq = UINT64_MAX;
+}
+
+void bytefs_gc_erase_spread(struct ssd *ssd, int *min_erase, int *max_erase, double *avg_erase) {
+  int sb_idx, min_cnt = INT32_MAX, max_cnt = 0;
+  uint64_t total = 0;
+  for (sb_idx = 0; sb_idx < ssd->sp.sb_per_ssd; sb_idx++) {
+    int cnt = ssd->sb[sb_idx].erase_cnt;
+    min_cnt = cnt < min_cnt ? cnt : min_cnt;
+    max_cnt = cnt > max_cnt ? cnt : max_cnt;
+    total += cnt;
+  }
+  if (min_erase) *min_erase = ssd->sp.sb_per_ssd ? min_cnt : 0;
+  if (max_erase) *max_erase = max_cnt;
+  if (avg_erase) *avg_erase = ssd->sp.sb_per_ssd ? (double) total / ssd->sp.sb_per_ssd : 0;
+}
 #else
 void bytefs_gc(struct ssd *ssd) {
   nand_block *gc_blk;
@@ -652,6 +800,7 @@ void bytefs_gc(struct ssd *ssd) {
       return;
     }
     gc_blk_pba = bytefs_get_pba_from_nand_blk(gc_blk);
+    bytefs_gc_record_victim(gc_blk->vpc, ssd->sp.pgs_per_blk);
     if (gc_blk->vpc != 0) {
       for (gc_blk_offset = 0; gc_blk_offset < ssd->sp.pgs_per_blk; gc_blk_offset++) {
         // get ppa of current GC block
@@ -671,7 +820,7 @@ void bytefs_gc(struct ssd *ssd) {
           // validate the copied entries
           // bytefs_log("Free blk ch: %5d way: %5d blk: %5d pg: %5d",
           //     free_blk_ppa.g.ch, free_blk_ppa.g.lun, free_blk_ppa.g.blk, free_blk_ppa.g.pg);
-          free_blk_ppa = get_new_page(ssd);
+          free_blk_ppa = get_new_page(ssd, WS_GC);
           set_maptbl_ent(ssd, gc_page_lpn, &free_blk_ppa);
           set_rmap_ent(ssd, gc_page_lpn, &free_blk_ppa);
           mark_page_valid(ssd, &free_blk_ppa);
@@ -681,7 +830,8 @@ void bytefs_gc(struct ssd *ssd) {
           cmd.stime = current_time;
           ssd_advance_status(ssd, &free_blk_ppa, &cmd);
           backend_rw(ssd->bd, free_blk_ppa.realppa, ssd->gc_buffer, 1);
-          ssd_advance_write_pointer(ssd);
+          ssd_advance_write_pointer(ssd, WS_GC);
+          SSD_STAT_ATOMIC_INC(gc_migrated_pages);
         }
       }
       // erase origional block
@@ -695,6 +845,7 @@ void bytefs_gc(struct ssd *ssd) {
       bytefs_assert(gc_blk->ipc == 0);
       bytefs_push_back_free_list(ssd, gc_blk);
     }
+    SSD_STAT_ATOMIC_INC(gc_fg_victims);
 
     // if GC should end, try end it
     if (bytefs_should_stop_gc(ssd)) {
@@ -704,4 +855,144 @@ void bytefs_gc(struct ssd *ssd) {
     }
   }
 }
+
+void bytefs_gc_background(struct ssd *ssd) {
+}
+
+void bytefs_gc_erase_spread(struct ssd *ssd, int *min_erase, int *max_erase, double *avg_erase) {
+  int ch_idx, lun_idx, blk_idx, min_cnt = INT32_MAX, max_cnt = 0;
+  uint64_t total = 0, nblks = 0;
+  for (ch_idx = 0; ch_idx < ssd->sp.nchs; ch_idx++) {
+    for (lun_idx = 0; lun_idx < ssd->sp.luns_per_ch; lun_idx++) {
+      for (blk_idx = 0; blk_idx < ssd->sp.blks_per_lun; blk_idx++) {
+        int cnt = ssd->ch[ch_idx].lun[lun_idx].blk[blk_idx].erase_cnt;
+        min_cnt = cnt < min_cnt ? cnt : min_cnt;
+        max_cnt = cnt > max_cnt ? cnt : max_cnt;
+        total += cnt;
+        nblks++;
+      }
+    }
+  }
+  if (min_erase) *min_erase = nblks ? min_cnt : 0;
+  if (max_erase) *max_erase = max_cnt;
+  if (avg_erase) *avg_erase = nblks ? (double) total / nblks : 0;
+}
+#endif
+
+#if ALLOCATION_SECHEM_LINE
+static void checkpoint_sb_list(struct ssd *ssd, int num_sbs, struct ssd_superblock *sb,
+                               std::vector<uint64_t> &out) {
+  out.push_back(num_sbs);
+  for (int i = 0; i < num_sbs; i++, sb = sb->next_sb) {
+    bytefs_assert(sb);
+    out.push_back(sb - ssd->sb);
+  }
+}
+
+/* relinks num_sbs superblocks of data, returns the words used, 0 on malformed input */
+static uint64_t restore_sb_list(struct ssd *ssd, const uint64_t *data, uint64_t len,
+                                int *num_sbs, struct ssd_superblock **start, struct ssd_superblock **end) {
+  if (len < 1 || data[0] > len - 1)
+    return 0;
+  *num_sbs = data[0];
+  *start = *end = NULL;
+  for (uint64_t i = 1; i <= data[0]; i++) {
+    if (data[i] >= (uint64_t) ssd->sp.sb_per_ssd)
+      return 0;
+    struct ssd_superblock *sb = &ssd->sb[data[i]];
+    sb->next_sb = NULL;
+    if (*end)
+      (*end)->next_sb = sb;
+    else
+      *start = sb;
+    *end = sb;
+  }
+  return data[0] + 1;
+}
+
+/*
+ * Post-warmup checkpoint of the GC state: the counters, the free and candidate
+ * lists in list order and the victim heap in array order, superblocks by index.
+ */
+void bytefs_gc_checkpoint(struct ssd *ssd, std::vector<uint64_t> &out) {
+  out.push_back(ssd->total_free_sbs);
+  out.push_back(ssd->gc_write_seq);
+  checkpoint_sb_list(ssd, ssd->free_sbs->num_sbs, ssd->free_sbs->sbs_start, out);
+  checkpoint_sb_list(ssd, ssd->gc_candidate_sbs->num_sbs, ssd->gc_candidate_sbs->sbs_start, out);
+  out.push_back(ssd->gc_heaps->count);
+  for (int i = 0; i < ssd->gc_heaps->count; i++) {
+    out.push_back(ssd->gc_heaps->key[i]);
+    out.push_back((struct ssd_superblock *) ssd->gc_heaps->storage[i] - ssd->sb);
+  }
+}
+
+bool bytefs_gc_restore(struct ssd *ssd, const uint64_t *data, uint64_t len) {
+  uint64_t pos = 2, used;
+  if (len < 2)
+    return false;
+  ssd->total_free_sbs = data[0];
+  ssd->gc_write_seq = data[1];
+  used = restore_sb_list(ssd, data + pos, len - pos, &ssd->free_sbs->num_sbs,
+                         &ssd->free_sbs->sbs_start, &ssd->free_sbs->sbs_end);
+  if (!used)
+    return false;
+  pos += used;
+  used = restore_sb_list(ssd, data + pos, len - pos, &ssd->gc_candidate_sbs->num_sbs,
+                         &ssd->gc_candidate_sbs->sbs_start, &ssd->gc_candidate_sbs->sbs_end);
+  if (!used)
+    return false;
+  pos += used;
+  if (pos >= len || data[pos] > (uint64_t) ssd->gc_heaps->capacity || len - pos - 1 != 2 * data[pos])
+    return false;
+  ssd->gc_heaps->count = data[pos++];
+  for (int i = 0; i < ssd->gc_heaps->count; i++, pos += 2) {
+    if (data[pos + 1] >= (uint64_t) ssd->sp.sb_per_ssd)
+      return false;
+    ssd->gc_heaps->key[i] = data[pos];
+    ssd->gc_heaps->storage[i] = &ssd->sb[data[pos + 1]];
+  }
+  ssd->gc_heaps_seq = UINT64_MAX;
+  return true;
+}
+
+/* words of a superblock list at @data, 0 on malformed input */
+static uint64_t check_sb_list(const struct ssdparams *spp, const uint64_t *data, uint64_t len) {
+  if (len < 1 || data[0] > len - 1)
+    return 0;
+  for (uint64_t i = 1; i <= data[0]; i++)
+    if (data[i] >= (uint64_t) spp->sb_per_ssd)
+      return 0;
+  return data[0] + 1;
+}
+
+bool bytefs_gc_checkpoint_valid(const struct ssdparams *spp, const uint64_t *data, uint64_t len) {
+  uint64_t pos = 2, used;
+  if (data == NULL || len < 2)
+    return false;
+  for (int list = 0; list < 2; list++) {
+    used = check_sb_list(spp, data + pos, len - pos);
+    if (!used)
+      return false;
+    pos += used;
+  }
+  if (pos >= len || data[pos] > (uint64_t) spp->sb_per_ssd || len - pos - 1 != 2 * data[pos])
+    return false;
+  for (pos++; pos < len; pos += 2)
+    if (data[pos + 1] >= (uint64_t) spp->sb_per_ssd)
+      return false;
+  return true;
+}
+#else
+void bytefs_gc_checkpoint(struct ssd *ssd, std::vector<uint64_t> &out) {
+  bytefs_err("Warmup checkpoints need the writeline allocation scheme");
+}
+
+bool bytefs_gc_restore(struct ssd *ssd, const uint64_t *data, uint64_t len) {
+  bytefs_err("Warmup checkpoints need the writeline allocation scheme");
+  return false;
+}
+
+bool bytefs_gc_checkpoint_valid(const struct ssdparams *spp, const uint64_t *data, uint64_t len) {
+  return false;
+}
 #endif
@@ -1,6 +1,8 @@
 #ifndef __BYTEFS_GC_H__
 #define __BYTEFS_GC_H__
 
+#include <vector>
+
 #include "ftl.h"
 #include "ftl_mapping.h"
 
@@ -34,6 +36,28 @@ struct gc_candidate_list {
 
 // typedef gc_free_list gc_candidate_list;
 
+/* GC victim selection, chosen by the gc_policy config knob */
+enum gc_policy_enum {
+  GC_GREEDY,        /* fewest valid pages */
+  GC_COST_BENEFIT,  /* age * (1 - u) / (1 + u), u being the valid ratio */
+  GC_WEAR_AWARE,    /* fewest valid pages, penalized by wear above the least worn */
+};
+
+/* free space (% of blocks) foreground GC reclaims up to */
+#define GC_STOP_THRESHOLD_PCT (35)
+/* wear-aware: erases above the least worn block worth a full block of valid pages */
+#define GC_WEAR_WINDOW (16)
+
+extern gc_policy_enum gc_policy;
+extern int gc_fg_threshold;
+extern int gc_bg_threshold;
+
+/* parse a policy name (GREEDY, COST_BENEFIT, WEAR_AWARE), returns false on unknown names */
+bool parse_gc_policy(const std::string &name, gc_policy_enum *policy);
+const char *gc_policy_name(gc_policy_enum policy);
+/* background GC has to kick in before foreground GC, and both below GC_STOP_THRESHOLD_PCT */
+bool gc_thresholds_valid(void);
+
 int bytefs_gc_init(struct ssd *ssd);
 void bytefs_gc_reset(struct ssd *ssd);
 void bytefs_gc_free(struct ssd *ssd);
@@ -52,6 +76,15 @@ struct nand_block *bytefs_get_next_free_blk(struct ssd *ssd, int *start_idx);
 #endif
 int bytefs_should_start_gc(struct ssd *ssd);
 int bytefs_should_stop_gc(struct ssd *ssd);
+int bytefs_should_start_bg_gc(struct ssd *ssd, uint64_t now);
 void bytefs_gc(struct ssd *ssd);
+void bytefs_gc_background(struct ssd *ssd);
+void bytefs_gc_erase_spread(struct ssd *ssd, int *min_erase, int *max_erase, double *avg_erase);
+
+/* GC lists and heap of the post-warmup checkpoint */
+void bytefs_gc_checkpoint(struct ssd *ssd, std::vector<uint64_t> &out);
+bool bytefs_gc_restore(struct ssd *ssd, const uint64_t *data, uint64_t len);
+/* whether bytefs_gc_restore would accept @data, without touching any state */
+bool bytefs_gc_checkpoint_valid(const struct ssdparams *spp, const uint64_t *data, uint64_t len);
 
 #endif
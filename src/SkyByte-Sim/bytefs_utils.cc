@@ -82,6 +82,14 @@ int bytefs_start_threads(void) {
             bytefs_start_thread(&ssd->log_writer_thread_id[log_writer_thread_idx], nullptr, 
                                 log_writer_thread, ("log writer #" + to_string(log_writer_thread_idx)).c_str());
         }
+        if (ssd->n_flush_threads > 1) {
+            bytefs_log("Initizing %ld flush worker threads", ssd->n_flush_threads - 1);
+            ssd->flush_worker_thread_id = new pthread_t[ssd->n_flush_threads - 1];
+            for (uint64_t flush_thread_idx = 0; flush_thread_idx < ssd->n_flush_threads - 1; flush_thread_idx++) {
+                bytefs_start_thread(&ssd->flush_worker_thread_id[flush_thread_idx], nullptr,
+                                    flush_worker_thread, ("flush worker #" + to_string(flush_thread_idx)).c_str());
+            }
+        }
     }
     
     if (promotion_enable || tpp_enable) {
@@ -120,6 +128,13 @@ int bytefs_stop_threads(void) {
             bytefs_cancel_thread(&ssd->log_writer_thread_id[log_writer_thread_idx],
                                 ("log writer #" + to_string(log_writer_thread_idx)).c_str());
         delete[] ssd->log_writer_thread_id;
+        if (ssd->flush_worker_thread_id) {
+            for (uint64_t flush_thread_idx = 0; flush_thread_idx < ssd->n_flush_threads - 1; flush_thread_idx++)
+                bytefs_cancel_thread(&ssd->flush_worker_thread_id[flush_thread_idx],
+                                    ("flush worker #" + to_string(flush_thread_idx)).c_str());
+            delete[] ssd->flush_worker_thread_id;
+            ssd->flush_worker_thread_id = nullptr;
+        }
     }
 
     if (promotion_enable || tpp_enable) {
@@ -147,6 +162,14 @@ void bytefs_stop_threads_gracefully(void) {
         for (uint64_t i = 0; i < ssd->n_log_writer_threads; i++)
             pthread_join(ssd->log_writer_thread_id[i], nullptr);
         bytefs_log("Log writer threads terminated");
+        if (ssd->flush_worker_thread_id) {
+            flush_pool_stop();
+            for (uint64_t i = 0; i < ssd->n_flush_threads - 1; i++)
+                pthread_join(ssd->flush_worker_thread_id[i], nullptr);
+            delete[] ssd->flush_worker_thread_id;
+            ssd->flush_worker_thread_id = nullptr;
+            bytefs_log("Flush worker threads terminated");
+        }
     }
 
     if (promotion_enable || tpp_enable) {
@@ -160,8 +183,7 @@ void bytefs_stop_threads_gracefully(void) {
     // delete ssd->simulator_timer_id;
     if (pinatrace_drive)
     {
-        the_clock_pt->terminate_flag = true;
-        the_clock_pt->workers_cv.notify_all();
+        the_clock_pt->terminate();
         pthread_join(*(ssd->simulator_timer_id), nullptr);
         bytefs_log("Event timer thread terminated");
     }
@@ -5,6 +5,9 @@
 #include <sstream>
 #include <unordered_map>
 #include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <immintrin.h>
 #include "cache.h"
 #include "ftl.h"
 #include "simulator_clock.h"
@@ -14,155 +17,375 @@ extern sim_clock* the_clock_pt;
 extern int64_t mark_count;
 extern int64_t evict_mark_count;
 
-fcache::fcache(int64_t size){
+/* index of the first way in tags[0..n) holding key, -1 if none; n is a multiple of 4 */
+static inline int32_t simd_find_tag(const int64_t *tags, int64_t n, int64_t key){
+#if defined(__AVX2__)
+    __m256i k = _mm256_set1_epi64x(key);
+    for (int64_t i = 0; i < n; i += 4)
+    {
+        __m256i t = _mm256_load_si256((const __m256i *)(tags + i));
+        int m = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(t, k)));
+        if (m)
+        {
+            return i + __builtin_ctz(m);
+        }
+    }
+#elif defined(__SSE2__)
+    __m128i k = _mm_set1_epi64x(key);
+    for (int64_t i = 0; i < n; i += 2)
+    {
+        __m128i t = _mm_load_si128((const __m128i *)(tags + i));
+        // SSE2 has no 64-bit compare, combine the two 32-bit halves
+        __m128i eq = _mm_cmpeq_epi32(t, k);
+        eq = _mm_and_si128(eq, _mm_shuffle_epi32(eq, _MM_SHUFFLE(2, 3, 0, 1)));
+        int m = _mm_movemask_pd(_mm_castsi128_pd(eq));
+        if (m)
+        {
+            return i + __builtin_ctz(m);
+        }
+    }
+#else
+    for (int64_t i = 0; i < n; i++)
+    {
+        if (tags[i] == key)
+        {
+            return i;
+        }
+    }
+#endif
+    return FCACHE_NO_WAY;
+}
+
+
+bool parse_repl_policy(const std::string &name, repl_policy_enum *policy){
+    if (name == "LRU")          { *policy = REPL_LRU; }
+    else if (name == "CLOCK")   { *policy = REPL_CLOCK; }
+    else if (name == "2Q")      { *policy = REPL_2Q; }
+    else if (name == "RRIP")    { *policy = REPL_RRIP; }
+    else                        { return false; }
+    return true;
+}
+
+const char *repl_policy_name(repl_policy_enum policy){
+    switch (policy)
+    {
+        case REPL_LRU:      return "LRU";
+        case REPL_CLOCK:    return "CLOCK";
+        case REPL_2Q:       return "2Q";
+        case REPL_RRIP:     return "RRIP";
+    }
+    return "UNKNOWN";
+}
+
+
+fcache::fcache(int64_t size, repl_policy_enum policy){
     cache_size_CL = size/CL_SIZE;
     curr_size = 0;
+    probation_size = 0;
+    this->policy = policy;
+    hand = 0;
     still_marked_clean_num = 0;
     still_marked_dirty_num = 0;
-    cachemem.reserve(cache_size_CL);
+
+    // pad the tag array to whole cachelines, padding never matches a real tag
+    int64_t tag_slots = (cache_size_CL + 7) / 8 * 8;
+    tags = (int64_t *) aligned_alloc(64, tag_slots * sizeof(int64_t));
+    assert(tags != nullptr);
+    for (int64_t i = 0; i < tag_slots; i++)
+    {
+        tags[i] = FCACHE_INVALID_TAG;
+    }
+    objs = new cache_obj[cache_size_CL];
+    free_ways.reserve(cache_size_CL);
+    for (int64_t i = cache_size_CL - 1; i >= 0; i--)
+    {
+        free_ways.push_back(i);
+    }
+    if (cache_size_CL > FCACHE_SCAN_WAYS)
+    {
+        tag_index.reserve(cache_size_CL);
+    }
 }
 
+fcache::~fcache(){
+    free(tags);
+    delete[] objs;
+}
 
 
-void fcache::fill(int64_t index){
-    if (cachemem.find(index)==cachemem.end())
+int32_t fcache::find_way(int64_t index){
+    if (cache_size_CL > FCACHE_SCAN_WAYS)
     {
-        cache_obj new_obj;
-        new_obj.valid = false;
-        new_obj.isdirty = false;
-        new_obj.node = nullptr;
-        new_obj.PageCnt = 0;
-        new_obj.is_ready = false;
-        new_obj.ready_time = 0;
-        cachemem[index] = new_obj;
+        auto it = tag_index.find(index);
+        return it == tag_index.end() ? FCACHE_NO_WAY : it->second;
     }
+    return simd_find_tag(tags, (cache_size_CL + 7) / 8 * 8, index);
 }
 
 
-void fcache::insert(int64_t index){
-    assert(curr_size < cache_size_CL);
-    cache_obj new_obj;
-    new_obj.valid = true;
-    new_obj.isdirty = false;
-    new_obj.marked_warmup = false;
-    new_obj.node = new LRU_node;
-    new_obj.node->prev = nullptr;
-    new_obj.node->next = nullptr;
-    new_obj.node->cl_index = index;
-    new_obj.PageCnt = 0; // wait for update() to increment it
+cache_obj* fcache::find(int64_t index){
+    int32_t way = find_way(index);
+    return way == FCACHE_NO_WAY ? nullptr : &objs[way];
+}
 
-    //LRU_mutex.lock();
-    if (LRUlist.tail==nullptr)
+
+void fcache::lru_append(int32_t way, uint8_t list_id){
+    LRU_list &list = list_id ? probation_list : LRUlist;
+    cache_obj &obj = objs[way];
+    obj.list_id = list_id;
+    obj.lru_prev = list.tail;
+    obj.lru_next = FCACHE_NO_WAY;
+    if (list.tail==FCACHE_NO_WAY)
     {
-        // assert(curr_size==0);
-        LRUlist.head = new_obj.node;
-        LRUlist.tail = new_obj.node;
+        list.head = way;
     }else
     {
-        LRUlist.tail->next = new_obj.node;
-        new_obj.node->prev = LRUlist.tail;
-        LRUlist.tail = new_obj.node;
+        objs[list.tail].lru_next = way;
     }
-    //LRU_mutex.unlock();
+    list.tail = way;
+    if (list_id)
+    {
+        probation_size++;
+    }
+}
 
-    cachemem[index] = new_obj;
-    curr_size++;
-    /*
-    std::cout<<"333 "<<LRUlist.head<<","<<LRUlist.tail<<","<<curr_size<<std::endl;
-    for (auto m : this->cachemem)
+
+void fcache::lru_unlink(int32_t way){
+    cache_obj &obj = objs[way];
+    LRU_list &list = obj.list_id ? probation_list : LRUlist;
+    if (obj.lru_prev!=FCACHE_NO_WAY)
     {
-        LRU_node* node = m.second.node;
-        if(node){
-        if (node->next!=nullptr)
-        {
-            assert(node->next!=node);
-            assert(node->next->prev==node);
-        }
-        if (node->prev!=nullptr)
-        {
-            assert(node->prev!=node);
-            assert(node->prev->next==node);
-        }
-        }
+        objs[obj.lru_prev].lru_next = obj.lru_next;
+    }else
+    {
+        assert(list.head==way);
+        list.head = obj.lru_next;
     }
-    */
-    
+    if (obj.lru_next!=FCACHE_NO_WAY)
+    {
+        objs[obj.lru_next].lru_prev = obj.lru_prev;
+    }else
+    {
+        assert(list.tail==way);
+        list.tail = obj.lru_prev;
+    }
+    if (obj.list_id)
+    {
+        probation_size--;
+    }
+    obj.lru_prev = FCACHE_NO_WAY;
+    obj.lru_next = FCACHE_NO_WAY;
 }
 
 
-void fcache::insert_nb(int64_t index, uint64_t ready_time, bool mark){
+void fcache::lru_touch(int32_t way){
+    LRU_list &list = objs[way].list_id ? probation_list : LRUlist;
+    if (way!=list.tail)
+    {
+        uint8_t list_id = objs[way].list_id;
+        lru_unlink(way);
+        lru_append(way, list_id);
+    }
+}
+
+
+/*
+ * The recency list is kept for every policy (snapshots walk it), the policy
+ * only decides the insert position, the hit promotion and the victim.
+ */
+void fcache::policy_on_insert(int32_t way){
+    cache_obj &obj = objs[way];
+    switch (policy)
+    {
+        case REPL_2Q:
+            lru_append(way, 1);
+            return;
+        case REPL_CLOCK:
+            obj.rp_bits = 0;
+            break;
+        case REPL_RRIP:
+            obj.rp_bits = REPL_RRIP_MAX - 1;
+            break;
+        case REPL_LRU:
+            break;
+    }
+    lru_append(way, 0);
+}
+
+
+void fcache::policy_on_hit(int32_t way){
+    cache_obj &obj = objs[way];
+    switch (policy)
+    {
+        case REPL_2Q:
+            // a re-reference in probation promotes the page to the main queue
+            if (obj.list_id)
+            {
+                lru_unlink(way);
+                lru_append(way, 0);
+                return;
+            }
+            break;
+        case REPL_CLOCK:
+            obj.rp_bits = 1;
+            break;
+        case REPL_RRIP:
+            obj.rp_bits = 0;
+            break;
+        case REPL_LRU:
+            break;
+    }
+    lru_touch(way);
+}
+
+
+/* only called on a full set, so every way holds a valid page */
+int32_t fcache::policy_choose_victim(){
+    switch (policy)
+    {
+        case REPL_2Q:
+            if (LRUlist.head==FCACHE_NO_WAY ||
+                (probation_list.head!=FCACHE_NO_WAY &&
+                 probation_size > cache_size_CL * REPL_2Q_PROBATION_RATIO))
+            {
+                return probation_list.head;
+            }
+            return LRUlist.head;
+        case REPL_CLOCK:
+            while (objs[hand].rp_bits)
+            {
+                objs[hand].rp_bits = 0;
+                hand = (hand + 1) % cache_size_CL;
+            }
+            {
+                int32_t victim = hand;
+                hand = (hand + 1) % cache_size_CL;
+                return victim;
+            }
+        case REPL_RRIP:
+            while (true)
+            {
+                for (int64_t i = 0; i < cache_size_CL; i++)
+                {
+                    int32_t way = (hand + i) % cache_size_CL;
+                    if (objs[way].rp_bits >= REPL_RRIP_MAX)
+                    {
+                        hand = (way + 1) % cache_size_CL;
+                        return way;
+                    }
+                }
+                for (int64_t i = 0; i < cache_size_CL; i++)
+                {
+                    objs[i].rp_bits++;
+                }
+            }
+        case REPL_LRU:
+            break;
+    }
+    return LRUlist.head;
+}
+
+
+void fcache::fill(int64_t index){
+    // ways are preallocated, nothing to reserve per page
+}
+
+
+int32_t fcache::alloc_way(int64_t index){
     assert(curr_size < cache_size_CL);
-    cache_obj new_obj;
+    assert(find_way(index) == FCACHE_NO_WAY);
+    int32_t way = free_ways.back();
+    free_ways.pop_back();
+    tags[way] = index;
+    if (cache_size_CL > FCACHE_SCAN_WAYS)
+    {
+        tag_index[index] = way;
+    }
+    objs[way] = cache_obj();
+    curr_size++;
+    return way;
+}
+
+
+void fcache::insert(int64_t index, bool demand){
+    int32_t way = alloc_way(index);
+    cache_obj &new_obj = objs[way];
+    new_obj.valid = true;
+    new_obj.isdirty = false;
+    new_obj.marked_warmup = false;
+    new_obj.PageCnt = 0; // wait for update() to increment it
+    new_obj.fresh = demand;
+    if (demand)
+        rstat.misses++;
+
+    //LRU_mutex.lock();
+    policy_on_insert(way);
+    //LRU_mutex.unlock();
+}
+
+
+void fcache::insert_nb(int64_t index, uint64_t ready_time, bool mark, bool demand){
+    int32_t way = alloc_way(index);
+    cache_obj &new_obj = objs[way];
     new_obj.valid = true;
     new_obj.isdirty = false;
     new_obj.is_ready = false;
     new_obj.ready_time = ready_time;
-    new_obj.node = new LRU_node;
-    new_obj.node->prev = nullptr;
-    new_obj.node->next = nullptr;
-    new_obj.node->cl_index = index;
     new_obj.mark = mark;
     mark_count++;
     new_obj.PageCnt = 0; // wait for update() to increment it
+    new_obj.fresh = demand;
+    if (demand)
+        rstat.misses++;
 
     //LRU_mutex.lock();
-    if (LRUlist.tail==nullptr)
-    {
-        // assert(curr_size==0);
-        LRUlist.head = new_obj.node;
-        LRUlist.tail = new_obj.node;
-    }else
-    {
-        LRUlist.tail->next = new_obj.node;
-        new_obj.node->prev = LRUlist.tail;
-        LRUlist.tail = new_obj.node;
-    }
+    policy_on_insert(way);
     //LRU_mutex.unlock();
-
-    cachemem[index] = new_obj;
-    curr_size++;
-
 }
 
 
 
 void fcache::remove(int64_t index){
     assert(curr_size>0);
-    if (cachemem[index].mark && cachemem[index].ready_time > the_clock_pt->time_tick)
+    int32_t way = find_way(index);
+    assert(way != FCACHE_NO_WAY);
+    cache_obj &obj = objs[way];
+    if (obj.mark && obj.ready_time > (uint64_t) the_clock_pt->get_time_sim())
     {
         evict_mark_count++;
     }
-    
-    cachemem[index].valid = false;
-    cachemem[index].isdirty = false;
-    cachemem[index].node = nullptr;
-    cachemem[index].PageCnt = 0;
-    cachemem[index].accessed_cl_set.clear();
-    cachemem[index].dirty_cl_set.clear();
+
+    lru_unlink(way);
+    obj = cache_obj();
+    tags[way] = FCACHE_INVALID_TAG;
+    if (cache_size_CL > FCACHE_SCAN_WAYS)
+    {
+        tag_index.erase(index);
+    }
+    free_ways.push_back(way);
     curr_size--;
 }
 
 bool fcache::is_hit(int64_t index){
-    // assert((LRUlist.head==LRUlist.tail)&&(curr_size<=1)||(LRUlist.head!=LRUlist.tail));
-    return (cachemem[index].valid);
+    return find_way(index) != FCACHE_NO_WAY;
 }
 
 //return 0 if hit, return -1 if totally miss, return rest_waiting_time if miss_on_wait
 int64_t fcache::is_hit_nb(int64_t index, uint64_t current_time){
-    // assert((LRUlist.head==LRUlist.tail)&&(curr_size<=1)||(LRUlist.head!=LRUlist.tail));
-    if (!cachemem[index].valid)
+    cache_obj *obj = find(index);
+    if (obj==nullptr)
     {
         return -1;
     }
-    else if (!cachemem[index].is_ready)
+    if (!obj->is_ready)
     {
-        if (current_time >= cachemem[index].ready_time)
+        if (current_time >= obj->ready_time)
         {
-            cachemem[index].is_ready = true;
+            obj->is_ready = true;
             return 0;
         } else
         {
-            return (cachemem[index].ready_time - current_time);
+            return (obj->ready_time - current_time);
         }
     }
     else
@@ -185,61 +408,41 @@ eviction fcache::miss_evict(int64_t index){
         return ev;
     }else
     {
-        // assert(LRUlist.head!=nullptr);
         //LRU_mutex.lock();
-        LRU_node* evi = LRUlist.head;
-        LRUlist.head->next->prev = nullptr;
-        // std::cout<<LRUlist.head<<","<<LRUlist.head->next<<std::endl;
-        LRUlist.head = evi->next;
+        int32_t way = policy_choose_victim();
+        assert(way!=FCACHE_NO_WAY);
         //LRU_mutex.unlock();
 
-        bool is_dirty = cachemem[evi->cl_index].isdirty;
+        cache_obj &evi = objs[way];
         eviction eev;
-        eev.PageCnt = cachemem[evi->cl_index].PageCnt;
-        eev.accessed_cl_num = cachemem[evi->cl_index].accessed_cl_set.size();
-        eev.dirty_cl_num = cachemem[evi->cl_index].dirty_cl_set.size();
-        
-        remove(evi->cl_index);
-        if (is_dirty)
+        eev.PageCnt = evi.PageCnt;
+        eev.accessed_cl_num = evi.accessed_cl_num();
+        eev.dirty_cl_num = evi.dirty_cl_num();
+        eev.condition = evi.isdirty ? 2 : 1;
+        eev.index = tags[way];
+        if (evi.isdirty)
         {
-            eev.condition = 2;
+            rstat.dirty_evictions++;
+            rstat.dirty_cl_evicted += eev.dirty_cl_num;
         }
         else
         {
-            eev.condition = 1;
+            rstat.clean_evictions++;
         }
-        eev.index = evi->cl_index;
-        delete evi;
 
-        /*
-        std::cout<<"222 "<<LRUlist.head<<","<<LRUlist.tail<<","<<curr_size<<std::endl;
-        for (auto m : this->cachemem)
-        {
-            LRU_node* node = m.second.node;
-            if(node){
-            if (node->next!=nullptr)
-            {
-                assert(node->next!=node);
-                assert(node->next->prev==node);
-            }
-            if (node->prev!=nullptr)
-            {
-                assert(node->prev!=node);
-                assert(node->prev->next==node);
-            }
-            }
-        }
-        */
+        remove(tags[way]);
         return eev;
     }
 }
 
 
 void fcache::readhitCL(int64_t index, int cl_offset){
-    //LRU_mutex.lock();
-    if(cachemem[index].marked_warmup){
-        cachemem[index].marked_warmup = false;
-        if(cachemem[index].isdirty){
+    int32_t way = find_way(index);
+    assert(way != FCACHE_NO_WAY);
+    cache_obj &obj = objs[way];
+    if(obj.marked_warmup){
+        obj.marked_warmup = false;
+        if(obj.isdirty){
             this->still_marked_dirty_num--;
         }
         else
@@ -248,56 +451,34 @@ void fcache::readhitCL(int64_t index, int cl_offset){
         }
     }
 
-    LRU_node* node = cachemem[index].node;
-    if (node!=LRUlist.tail)
+    // the first access after a fill is the miss itself: not a hit, and
+    // only LRU moves the page up, as it always did
+    if (obj.fresh)
     {
-        node->next->prev = node->prev;
-        if (node->prev!=nullptr)
-        {
-            node->prev->next = node->next;
-        } else
-        {
-            // assert(node==LRUlist.head);
-            LRUlist.head = node->next;
-        }
-        
-        LRUlist.tail->next = node;
-        node->prev = LRUlist.tail;
-        node->next = nullptr;
-        LRUlist.tail = node;
+        obj.fresh = false;
+        if (policy == REPL_LRU)
+            lru_touch(way);
     }
-    //LRU_mutex.unlock();
-
-    cachemem[index].accessed_cl_set.insert(cl_offset);
-
-/*
-    std::cout<<"111 "<<LRUlist.head<<std::endl;
-    for (auto m : this->cachemem)
+    else
     {
-        LRU_node* node = m.second.node;
-        if(node){
-        if (node->next!=nullptr)
-        {
-            assert(node->next!=node);
-            assert(node->next->prev==node);
-        }
-        if (node->prev!=nullptr)
-        {
-            assert(node->prev!=node);
-            assert(node->prev->next==node);
-        }
-        }
+        rstat.hits++;
+        //LRU_mutex.lock();
+        policy_on_hit(way);
+        //LRU_mutex.unlock();
     }
-    */
+
+    obj.accessed_cl_map |= 1UL << cl_offset;
     // cachemem[index].PageCnt++;   //wait for update() to increment it
 }
 
 
 void fcache::writehitCL(int64_t index, int cl_offset){
-    //LRU_mutex.lock();
-    if(cachemem[index].marked_warmup){
-        cachemem[index].marked_warmup = false;
-        if(cachemem[index].isdirty){
+    int32_t way = find_way(index);
+    assert(way != FCACHE_NO_WAY);
+    cache_obj &obj = objs[way];
+    if(obj.marked_warmup){
+        obj.marked_warmup = false;
+        if(obj.isdirty){
             this->still_marked_dirty_num--;
         }
         else
@@ -306,38 +487,34 @@ void fcache::writehitCL(int64_t index, int cl_offset){
         }
     }
 
-    LRU_node* node = cachemem[index].node;
-    cachemem[index].isdirty = true;
-    if (node!=LRUlist.tail)
+    obj.isdirty = true;
+    // the first access after a fill is the miss itself: not a hit, and
+    // only LRU moves the page up, as it always did
+    if (obj.fresh)
     {
-        node->next->prev = node->prev;
-        if (node->prev!=nullptr)
-        {
-            node->prev->next = node->next;
-        } else
-        {
-            // assert(node==LRUlist.head);
-            LRUlist.head = node->next;
-        }
-        
-        LRUlist.tail->next = node;
-        node->prev = LRUlist.tail;
-        node->next = nullptr;
-        LRUlist.tail = node;
+        obj.fresh = false;
+        if (policy == REPL_LRU)
+            lru_touch(way);
+    }
+    else
+    {
+        rstat.hits++;
+        //LRU_mutex.lock();
+        policy_on_hit(way);
+        //LRU_mutex.unlock();
     }
-    //LRU_mutex.unlock();
 
-    cachemem[index].dirty_cl_set.insert(cl_offset);
-    cachemem[index].accessed_cl_set.insert(cl_offset);
+    obj.dirty_cl_map |= 1UL << cl_offset;
+    obj.accessed_cl_map |= 1UL << cl_offset;
     // cachemem[index].PageCnt++;   //wait for update() to increment it
 }
 
 
 int64_t fcache::give_dirty_num(){
     int64_t dirty_num = 0;
-    for (auto obj : cachemem)
+    for (int64_t i = 0; i < cache_size_CL; i++)
     {
-        if (obj.second.valid && obj.second.isdirty)
+        if (objs[i].valid && objs[i].isdirty)
         {
             dirty_num++;
         }
@@ -347,15 +524,7 @@ int64_t fcache::give_dirty_num(){
 
 
 int64_t fcache::give_accessed_num(){
-    int64_t accessed_num = 0;
-    for (auto obj : cachemem)
-    {
-        if (obj.second.valid)
-        {
-            accessed_num++;
-        }
-    }
-    return accessed_num;
+    return curr_size;
 }
 
 
@@ -369,12 +538,13 @@ int64_t fcache::give_marked_dirty_num(){
 
 
 void fcache::mark_warmup(){
-    for (auto obj : cachemem)
+    for (int64_t i = 0; i < cache_size_CL; i++)
     {
-        if (obj.second.valid)
+        cache_obj &obj = objs[i];
+        if (obj.valid)
         {
-            obj.second.marked_warmup = true;
-            if(obj.second.isdirty){
+            obj.marked_warmup = true;
+            if(obj.isdirty){
                 this->still_marked_dirty_num++;
             }
             else
@@ -387,14 +557,16 @@ void fcache::mark_warmup(){
 
 
 
-sa_cache::sa_cache(int64_t size_in_byte, int way, int64_t maxthreshold, int64_t resetepoch){
+sa_cache::sa_cache(int64_t size_in_byte, int way, int64_t maxthreshold, int64_t resetepoch,
+        repl_policy_enum policy){
     this->way = way;
+    this->policy = policy;
     this->size_byte = size_in_byte;
     int64_t bank_size = size_byte / way;
     num_sets = bank_size / CL_SIZE;
     for (int i = 0; i < num_sets; i++)
     {
-        fcache* sett = new fcache((int64_t)way*CL_SIZE);
+        fcache* sett = new fcache((int64_t)way*CL_SIZE, policy);
         sets.push_back(sett);
     }
     maxThreshold = maxthreshold;
@@ -425,14 +597,18 @@ void sa_cache::fill(int64_t index){
     sets[set_index]->fill(index / num_sets);
 }
 
-void sa_cache::insert(int64_t index){
+void sa_cache::insert(int64_t index, bool demand){
     int set_index = index % num_sets;
-    sets[set_index]->insert(index / num_sets);
+    sets[set_index]->insert(index / num_sets, demand);
+    if (demand)
+        miss_total.fetch_add(1, std::memory_order_relaxed);
 }
 
-void sa_cache::insert_nb(int64_t index, uint64_t ready_time, bool mark){
+void sa_cache::insert_nb(int64_t index, uint64_t ready_time, bool mark, bool demand){
     int set_index = index % num_sets;
-    sets[set_index]->insert_nb(index / num_sets, ready_time, mark);
+    sets[set_index]->insert_nb(index / num_sets, ready_time, mark, demand);
+    if (demand)
+        miss_total.fetch_add(1, std::memory_order_relaxed);
 }
 
 void sa_cache::remove(int64_t index){
@@ -471,12 +647,18 @@ eviction sa_cache::miss_evict(int64_t index){
 
 void sa_cache::readhitCL(int64_t index, int cl_offset){
     int set_index = index % num_sets;
-    sets[set_index]->readhitCL(index / num_sets, cl_offset);
+    fcache *set = sets[set_index];
+    int64_t hits = set->rstat.hits;
+    set->readhitCL(index / num_sets, cl_offset);
+    hit_total.fetch_add(set->rstat.hits - hits, std::memory_order_relaxed);
 }
 
 void sa_cache::writehitCL(int64_t index, int cl_offset){
     int set_index = index % num_sets;
-    sets[set_index]->writehitCL(index / num_sets, cl_offset);
+    fcache *set = sets[set_index];
+    int64_t hits = set->rstat.hits;
+    set->writehitCL(index / num_sets, cl_offset);
+    hit_total.fetch_add(set->rstat.hits - hits, std::memory_order_relaxed);
 }
 
 int64_t sa_cache::give_dirty_num(){
@@ -516,6 +698,29 @@ int64_t sa_cache::give_marked_accessed_num(){
 }
 
 
+repl_stat sa_cache::give_repl_stat(){
+    repl_stat total;
+    for (auto i : sets)
+    {
+        total.hits += i->rstat.hits;
+        total.misses += i->rstat.misses;
+        total.clean_evictions += i->rstat.clean_evictions;
+        total.dirty_evictions += i->rstat.dirty_evictions;
+        total.dirty_cl_evicted += i->rstat.dirty_cl_evicted;
+    }
+    return total;
+}
+
+void sa_cache::reset_repl_stat(){
+    for (auto i : sets)
+    {
+        i->rstat = repl_stat();
+    }
+    hit_total = 0;
+    miss_total = 0;
+}
+
+
 void sa_cache::mark_warmup(){
     for(auto i :sets)
     {
@@ -537,12 +742,14 @@ int64_t sa_cache::update_and_choose_promotion(int64_t index){
     NetAggCnt++;
     AccessCnt++;
     int set_index = index % num_sets;
-    sets[set_index]->cachemem[index / num_sets].PageCnt++;
+    cache_obj *obj = sets[set_index]->find(index / num_sets);
+    assert(obj != nullptr);
+    obj->PageCnt++;
     bool promotion_flag = false;
-    if (sets[set_index]->cachemem[index / num_sets].PageCnt >= currThreshold)
+    if (obj->PageCnt >= currThreshold)
     {
         promotion_flag = true;
-        AggPromotedCnt = AggPromotedCnt + sets[set_index]->cachemem[index / num_sets].PageCnt;
+        AggPromotedCnt = AggPromotedCnt + obj->PageCnt;
     }
     curr_ratio = AggPromotedCnt / AccessCnt;
     if (curr_ratio <= LOW_RATIO)
@@ -579,62 +786,17 @@ int64_t sa_cache::update_and_choose_promotion(int64_t index){
 
 void sa_cache::do_promotion_evict(int64_t index){
     int set_index = index % num_sets;
-    int64_t page_cnt = sets[set_index]->cachemem[index / num_sets].PageCnt;
-
-    //LRU update:
-    //sets[set_index]->LRU_mutex.lock();
-    LRU_node* evi = sets[set_index]->cachemem[index / num_sets].node;
-    if (evi->next!=nullptr && evi->prev!=nullptr)
-    {
-        evi->next->prev = evi->prev;
-        evi->prev->next = evi->next;
-    }
-    else if (evi->prev==nullptr && evi->next!=nullptr)
-    {
-        assert(sets[set_index]->LRUlist.head==evi);
-        sets[set_index]->LRUlist.head = evi->next;
-        evi->next->prev = nullptr;
-    }
-    else if (evi->prev!=nullptr && evi->next==nullptr)
-    {
-        assert(sets[set_index]->LRUlist.tail==evi);
-        sets[set_index]->LRUlist.tail = evi->prev;
-        evi->prev->next = nullptr;
-    }
-    else
-    {
-        assert(sets[set_index]->LRUlist.head==evi);
-        assert(sets[set_index]->LRUlist.tail==evi);
-        sets[set_index]->LRUlist.head = nullptr;
-        sets[set_index]->LRUlist.tail = nullptr;
-    }
-    //sets[set_index]->LRU_mutex.unlock();
+    cache_obj *obj = sets[set_index]->find(index / num_sets);
+    assert(obj != nullptr);
+    int64_t page_cnt = obj->PageCnt;
 
     promotion_mutex_net.lock();
     NetAggCnt = NetAggCnt - page_cnt;
     assert(NetAggCnt>=0);
     promotion_mutex_net.unlock();
     
+    // remove() also drops the page from the LRU list
     remove(index);
-
-    /*
-    std::cout<<"444 "<<sets[set_index]->LRUlist.head<<std::endl;
-    for (auto m : sets[set_index]->cachemem)
-    {
-        LRU_node* node = m.second.node;
-        if(node){
-        if (node->next!=nullptr)
-        {
-            assert(node->next!=node);
-            assert(node->next->prev==node);
-        }
-        if (node->prev!=nullptr)
-        {
-            assert(node->prev!=node);
-            assert(node->prev->next==node);
-        }
-        }
-    }*/
 }
 
 
@@ -663,57 +825,233 @@ void sa_cache::gen_page_locality_result(std::string filename){
 
 
 
-void sa_cache::snapshot(FILE* output_file){
-    fprintf(output_file, "%ld\n", num_sets);
+// num_sets, then per set its size and the pages from LRU to MRU as (tag << 1 | dirty)
+void sa_cache::snapshot(std::vector<uint64_t> &out){
+    out.push_back(num_sets);
 
     for (int i = 0; i < num_sets; i++)
     {
-        // std::stringstream ss;
         long count = 0;
         fcache* current_set = sets[i];
-        fprintf(output_file, "%ld\n", current_set->curr_size);
+        out.push_back(current_set->curr_size);
         count = current_set->curr_size;
-        LRU_node* evi = current_set->LRUlist.head;
+        // 2Q probation pages first, the main list holds the rest
+        int32_t way = current_set->probation_list.head;
+        if (way==FCACHE_NO_WAY)
+        {
+            way = current_set->LRUlist.head;
+        }
         while (count > 0)
         {
-            assert(evi!=nullptr);
-            bool is_dirty = current_set->cachemem[evi->cl_index].isdirty;
-            if (is_dirty)
+            assert(way!=FCACHE_NO_WAY);
+            cache_obj &evi = current_set->objs[way];
+            out.push_back(((uint64_t)current_set->tags[way] << 1) | (evi.isdirty ? 1 : 0));
+            assert(evi.valid);
+            way = evi.lru_next;
+            if (way==FCACHE_NO_WAY && evi.list_id)
             {
-                fprintf(output_file, "%ld 1\n", evi->cl_index);
-            }else
-            {
-                fprintf(output_file, "%ld 0\n", evi->cl_index);
+                way = current_set->LRUlist.head;
             }
-            assert(current_set->cachemem[evi->cl_index].valid);
-            evi = evi->next;
             count--;
         }
     }
-    fprintf(output_file, "-----------------------------------------------------\n");
 }
 
-void sa_cache::replay_snapshot(FILE* input_file){
-    int64_t num_sets;
-    assert(fscanf(input_file, "%ld\n", &num_sets));
+void sa_cache::replay_snapshot(const uint64_t *data, uint64_t len){
+    uint64_t pos = 0;
+    bytefs_assert(len > 0 && (int64_t)data[pos] == num_sets);
+    pos++;
     for (int i = 0; i < num_sets; i++)
     {
-        long size;
-        assert(fscanf(input_file, "%ld\n", &size));
-        int64_t index;
-        int is_dirty;
-        for (long j = 0; j < size; j++)
+        bytefs_assert(pos < len);
+        uint64_t size = data[pos++];
+        bytefs_assert(size <= len - pos);
+        for (uint64_t j = 0; j < size; j++)
         {
-            assert(fscanf(input_file, "%ld %d\n", &index, &is_dirty));
+            int64_t index = data[pos] >> 1;
+            bool is_dirty = data[pos] & 1;
+            pos++;
             sets[i]->insert(index);
+            cache_obj *obj = sets[i]->find(index);
+            obj->fresh = false;
             if (is_dirty)
             {
-                sets[i]->cachemem[index].isdirty = true;
+                obj->isdirty = true;
             }
             int64_t sa_index = index * num_sets + i;
             bytefs_fill_data(sa_index*PG_SIZE);
         }
     }
+    repl_stat total = give_repl_stat();
+    hit_total = total.hits;
+    miss_total = total.misses;
+}
+
+// converts the text dump older versions wrote, ends after its separator line
+bool sa_cache::snapshot_from_text(FILE* input_file, std::vector<uint64_t> &out){
+    int64_t num_sets;
+    if (fscanf(input_file, "%ld\n", &num_sets) != 1)
+        return false;
+    out.push_back(num_sets);
+    for (int64_t i = 0; i < num_sets; i++)
+    {
+        long size;
+        if (fscanf(input_file, "%ld\n", &size) != 1)
+            return false;
+        out.push_back(size);
+        for (long j = 0; j < size; j++)
+        {
+            int64_t index;
+            int is_dirty;
+            if (fscanf(input_file, "%ld %d\n", &index, &is_dirty) != 2)
+                return false;
+            out.push_back(((uint64_t)index << 1) | (is_dirty ? 1 : 0));
+        }
+    }
     char line[100];
-    char* del = fgets(line, 100, input_file);
-}
\ No newline at end of file
+    return fgets(line, 100, input_file) != NULL;
+}
+/*
+ * Full state for the post-warmup checkpoint, unlike snapshot() nothing is
+ * replayed: promotion counters, then per set its scalars, free way stack and
+ * every way's tag and cache_obj, so a restored cache evicts and promotes
+ * exactly like the one it was taken from.
+ */
+void sa_cache::checkpoint(std::vector<uint64_t> &out){
+    out.push_back(num_sets);
+    out.push_back(way);
+    out.push_back(currThreshold);
+    out.push_back(AggPromotedCnt);
+    out.push_back(NetAggCnt);
+    out.push_back(AccessCnt);
+    uint64_t ratio_bits;
+    memcpy(&ratio_bits, &curr_ratio, sizeof(ratio_bits));
+    out.push_back(ratio_bits);
+    for (int i = 0; i < 65; i++)
+    {
+        out.push_back(((uint64_t)(uint32_t)r_data[i] << 32) | (uint32_t)w_data[i]);
+    }
+
+    for (int i = 0; i < num_sets; i++)
+    {
+        fcache* s = sets[i];
+        out.push_back(s->curr_size);
+        out.push_back(s->probation_size);
+        out.push_back(s->hand);
+        out.push_back(((uint64_t)(uint32_t)s->LRUlist.head << 32) | (uint32_t)s->LRUlist.tail);
+        out.push_back(((uint64_t)(uint32_t)s->probation_list.head << 32) | (uint32_t)s->probation_list.tail);
+        out.push_back(s->still_marked_dirty_num);
+        out.push_back(s->still_marked_clean_num);
+        out.push_back(s->rstat.hits);
+        out.push_back(s->rstat.misses);
+        out.push_back(s->rstat.clean_evictions);
+        out.push_back(s->rstat.dirty_evictions);
+        out.push_back(s->rstat.dirty_cl_evicted);
+        out.push_back(s->free_ways.size());
+        out.insert(out.end(), s->free_ways.begin(), s->free_ways.end());
+        for (int64_t w = 0; w < s->cache_size_CL; w++)
+        {
+            const cache_obj &o = s->objs[w];
+            out.push_back(s->tags[w]);
+            out.push_back((uint64_t)o.valid | (uint64_t)o.is_ready << 1 | (uint64_t)o.isdirty << 2 |
+                          (uint64_t)o.mark << 3 | (uint64_t)o.marked_warmup << 4 | (uint64_t)o.fresh << 5 |
+                          (uint64_t)o.list_id << 8 | (uint64_t)o.rp_bits << 16);
+            out.push_back(((uint64_t)(uint32_t)o.lru_prev << 32) | (uint32_t)o.lru_next);
+            out.push_back(o.PageCnt);
+            out.push_back(o.ready_time);
+            out.push_back(o.accessed_cl_map);
+            out.push_back(o.dirty_cl_map);
+        }
+    }
+}
+
+/* restores a checkpoint() of a cache with the same geometry, false on a mismatch */
+bool sa_cache::restore_checkpoint(const uint64_t *data, uint64_t len){
+    uint64_t pos = 0;
+    if (len < 7 + 65 || (int64_t)data[0] != num_sets || (int)data[1] != way)
+        return false;
+    currThreshold = data[2];
+    AggPromotedCnt = data[3];
+    NetAggCnt = data[4];
+    AccessCnt = data[5];
+    memcpy(&curr_ratio, &data[6], sizeof(curr_ratio));
+    pos = 7;
+    for (int i = 0; i < 65; i++, pos++)
+    {
+        r_data[i] = (int)(data[pos] >> 32);
+        w_data[i] = (int)(uint32_t)data[pos];
+    }
+
+    for (int i = 0; i < num_sets; i++)
+    {
+        fcache* s = sets[i];
+        if (len - pos < 13)
+            return false;
+        s->curr_size = data[pos++];
+        s->probation_size = data[pos++];
+        s->hand = data[pos++];
+        s->LRUlist.head = (int32_t)(data[pos] >> 32);
+        s->LRUlist.tail = (int32_t)data[pos++];
+        s->probation_list.head = (int32_t)(data[pos] >> 32);
+        s->probation_list.tail = (int32_t)data[pos++];
+        s->still_marked_dirty_num = data[pos++];
+        s->still_marked_clean_num = data[pos++];
+        s->rstat.hits = data[pos++];
+        s->rstat.misses = data[pos++];
+        s->rstat.clean_evictions = data[pos++];
+        s->rstat.dirty_evictions = data[pos++];
+        s->rstat.dirty_cl_evicted = data[pos++];
+        uint64_t nfree = data[pos++];
+        if (nfree > (uint64_t)s->cache_size_CL || len - pos < nfree + 7 * s->cache_size_CL)
+            return false;
+        s->free_ways.assign(data + pos, data + pos + nfree);
+        pos += nfree;
+        s->tag_index.clear();
+        for (int64_t w = 0; w < s->cache_size_CL; w++)
+        {
+            cache_obj &o = s->objs[w];
+            s->tags[w] = data[pos++];
+            uint64_t flags = data[pos++];
+            o.valid = flags & 1;
+            o.is_ready = (flags >> 1) & 1;
+            o.isdirty = (flags >> 2) & 1;
+            o.mark = (flags >> 3) & 1;
+            o.marked_warmup = (flags >> 4) & 1;
+            o.fresh = (flags >> 5) & 1;
+            o.list_id = (uint8_t)(flags >> 8);
+            o.rp_bits = (uint8_t)(flags >> 16);
+            o.lru_prev = (int32_t)(data[pos] >> 32);
+            o.lru_next = (int32_t)data[pos++];
+            o.PageCnt = data[pos++];
+            o.ready_time = data[pos++];
+            o.accessed_cl_map = data[pos++];
+            o.dirty_cl_map = data[pos++];
+            if (o.valid && s->cache_size_CL > FCACHE_SCAN_WAYS)
+            {
+                s->tag_index[s->tags[w]] = w;
+            }
+        }
+    }
+    repl_stat total = give_repl_stat();
+    hit_total = total.hits;
+    miss_total = total.misses;
+    return pos == len;
+}
+
+bool sa_cache::checkpoint_valid(const uint64_t *data, uint64_t len){
+    if (data == nullptr || len < 7 + 65)
+        return false;
+    uint64_t sets = data[0], ways = data[1];
+    uint64_t pos = 7 + 65;
+    for (uint64_t i = 0; i < sets; i++)
+    {
+        if (len - pos < 13)
+            return false;
+        pos += 12;
+        uint64_t nfree = data[pos++];
+        if (nfree > ways || len - pos < nfree + 7 * ways)
+            return false;
+        pos += nfree + 7 * ways;
+    }
+    return pos == len;
+}
@@ -9,38 +9,79 @@
 #include <stdio.h>
 #include <iostream>
 #include <unordered_map>
-#include <unordered_set>
 #include <vector>
 #include <mutex>
+#include <atomic>
+#include <string>
 
 
 
-struct LRU_node{
-    LRU_node* prev = nullptr;
-    LRU_node* next = nullptr;
-    int64_t cl_index = 0;
+/* sets up to this associativity are searched with a vector tag compare,
+   larger (host DRAM) sets go through a tag -> way index */
+#define FCACHE_SCAN_WAYS    64
+#define FCACHE_INVALID_TAG  (-1L)
+#define FCACHE_NO_WAY       (-1)
+
+/* 2Q: share of the ways the probation (A1in) queue may hold before it is
+   evicted from ahead of the main queue */
+#define REPL_2Q_PROBATION_RATIO 0.25
+/* RRIP: 2-bit re-reference prediction values, inserts land at distant-1 */
+#define REPL_RRIP_MAX           3
+
+enum repl_policy_enum {
+    REPL_LRU,
+    REPL_CLOCK,
+    REPL_2Q,
+    REPL_RRIP,
+};
+
+/* parse a policy name (LRU, CLOCK, 2Q, RRIP), returns false on unknown names */
+bool parse_repl_policy(const std::string &name, repl_policy_enum *policy);
+const char *repl_policy_name(repl_policy_enum policy);
+
+/* per-tier replacement statistics, summed over all sets */
+struct repl_stat
+{
+    int64_t hits = 0;
+    int64_t misses = 0;
+    int64_t clean_evictions = 0;
+    int64_t dirty_evictions = 0;
+    int64_t dirty_cl_evicted = 0;
 };
 
+/* intrusive LRU list over way slots, threaded through cache_obj::lru_prev/lru_next */
 class LRU_list{
     public:
-        LRU_node* head;
-        LRU_node* tail;
-        LRU_list(){head = nullptr; tail = nullptr;};
+        int32_t head;
+        int32_t tail;
+        LRU_list(){head = FCACHE_NO_WAY; tail = FCACHE_NO_WAY;};
 };
 
 
+/**
+ * State of one way. Accessed and dirty cachelines are tracked as 64-bit
+ * bitmaps (one bit per 64B line of the 4KB page); the tag lives in the
+ * set's separate tag array so the tag compare touches tags only.
+ */
 struct cache_obj
 {
     bool valid = false;
     bool is_ready = false;
     bool isdirty = false;
-    LRU_node* node = nullptr;
-    int64_t PageCnt = 0;
-    uint64_t ready_time = 0;
-    std::unordered_set<int> accessed_cl_set;
-    std::unordered_set<int> dirty_cl_set;
     bool mark = false;
     bool marked_warmup = false;
+    bool fresh = false;         // filled but not yet accessed, its first access is the miss
+    uint8_t list_id = 0;        // 0 main list, 1 2Q probation list
+    uint8_t rp_bits = 0;        // CLOCK reference bit / RRIP prediction value
+    int32_t lru_prev = FCACHE_NO_WAY;
+    int32_t lru_next = FCACHE_NO_WAY;
+    int64_t PageCnt = 0;
+    uint64_t ready_time = 0;
+    uint64_t accessed_cl_map = 0;
+    uint64_t dirty_cl_map = 0;
+
+    int accessed_cl_num() const { return __builtin_popcountll(accessed_cl_map); }
+    int dirty_cl_num() const { return __builtin_popcountll(dirty_cl_map); }
 };
 
 
@@ -55,13 +96,27 @@ struct eviction
 };
 
 
+/**
+ * One cache set. Tags and way state are kept in two contiguous,
+ * cacheline-aligned arrays sized by the associativity; free ways sit on a
+ * stack so inserts never search for a hole.
+ */
 class fcache{
     public:
-        std::unordered_map<int64_t, cache_obj> cachemem;
+        int64_t *tags;
+        cache_obj *objs;
+        std::vector<int32_t> free_ways;
+        std::unordered_map<int64_t, int32_t> tag_index; // only for sets wider than FCACHE_SCAN_WAYS
         LRU_list LRUlist;
+        LRU_list probation_list;
+        int64_t probation_size;
         int64_t cache_size_CL;
         int64_t curr_size;
 
+        repl_policy_enum policy;
+        int32_t hand;               // CLOCK / RRIP sweep position
+        repl_stat rstat;
+
         int64_t still_marked_dirty_num;
         int64_t still_marked_clean_num;
 
@@ -70,14 +125,31 @@ class fcache{
         //std::mutex cache_evict_mutex;
         std::mutex LRU_mutex;
 
-        fcache(int64_t size);
+        fcache(int64_t size, repl_policy_enum policy);
+        ~fcache();
+        // owns its way arrays
+        fcache(const fcache &) = delete;
+        fcache &operator=(const fcache &) = delete;
+
+        int32_t find_way(int64_t index);
+        int32_t alloc_way(int64_t index);
+        cache_obj* find(int64_t index);
+        void lru_append(int32_t way, uint8_t list_id);
+        void lru_unlink(int32_t way);
+        void lru_touch(int32_t way);
+
+        /* replacement policy hooks */
+        void policy_on_insert(int32_t way);
+        void policy_on_hit(int32_t way);
+        int32_t policy_choose_victim();
 
         //Note: Use this with give_access_num();
         void mark_warmup();
 
         void fill(int64_t index);
-        void insert(int64_t index);
-        void insert_nb(int64_t index, uint64_t ready_time, bool mark);
+        /* @demand: filled by a miss, false for promotions and prefetches */
+        void insert(int64_t index, bool demand = true);
+        void insert_nb(int64_t index, uint64_t ready_time, bool mark, bool demand = true);
         void remove(int64_t index);
         bool is_hit(int64_t index);
         //return 0 if hit, return -1 if totally miss, return rest_waiting_time if miss_on_wait
@@ -97,6 +169,7 @@ class sa_cache{
         int way;
         int64_t size_byte;
         int64_t num_sets;
+        repl_policy_enum policy;
         
         /* page promotion algo*/
         int64_t maxThreshold;
@@ -110,16 +183,20 @@ class sa_cache{
         /* page promotion algo*/
 
         std::vector<fcache*> sets;
+        std::atomic<uint64_t> hit_total{0};
+        std::atomic<uint64_t> miss_total{0};
 
         /* Counting the Page locality */
         int r_data[65];
         int w_data[65];
 
-        sa_cache(int64_t size_in_byte, int way, int64_t maxthreshold, int64_t resetepoch);
+        sa_cache(int64_t size_in_byte, int way, int64_t maxthreshold, int64_t resetepoch,
+                repl_policy_enum policy = REPL_LRU);
         ~sa_cache();
         void fill(int64_t index);
-        void insert(int64_t index);
-        void insert_nb(int64_t index, uint64_t ready_time, bool mark);
+        /* @demand: filled by a miss, false for promotions and prefetches */
+        void insert(int64_t index, bool demand = true);
+        void insert_nb(int64_t index, uint64_t ready_time, bool mark, bool demand = true);
         void remove(int64_t index);
         bool is_hit(int64_t index);
         //return 0 if hit, return -1 if totally miss, return rest_waiting_time if miss_on_wait
@@ -135,6 +212,11 @@ class sa_cache{
 
         int64_t give_marked_dirty_num();
         int64_t give_marked_accessed_num();
+        repl_stat give_repl_stat();
+        void reset_repl_stat();
+        /* hits and misses over all sets, readable while the sets are updated */
+        uint64_t give_hits() { return hit_total.load(std::memory_order_relaxed); }
+        uint64_t give_misses() { return miss_total.load(std::memory_order_relaxed); }
 
         /* page promotion algo*/
         void resetCounters();
@@ -153,8 +235,16 @@ class sa_cache{
         /* Counting the Page locality */
         void gen_page_locality_result(std::string filename);
 
-        void snapshot(FILE* output_file);
-        void replay_snapshot(FILE* input_file); //type 0 for cache, type 1 for host_dram
+        /* warmup snapshot of tags, dirty bits and LRU order, see snapshot.h */
+        void snapshot(std::vector<uint64_t> &out);
+        void replay_snapshot(const uint64_t *data, uint64_t len);
+        static bool snapshot_from_text(FILE* input_file, std::vector<uint64_t> &out);
+
+        /* complete state for the post-warmup checkpoint */
+        void checkpoint(std::vector<uint64_t> &out);
+        bool restore_checkpoint(const uint64_t *data, uint64_t len);
+        /* whether @data has the layout of a cache checkpoint, needs no cache */
+        static bool checkpoint_valid(const uint64_t *data, uint64_t len);
 };
 
 
@@ -1,13 +1,16 @@
 #include "cache_controller.h"
+#include "bytefs_utils.h"
+#include "ssd_stat.h"
 
 extern bool promotion_enable;
 extern bool tpp_enable;
 
 cache_controller::cache_controller(int64_t cache_size_in_byte, int way, int64_t maxthreshold, 
-    int64_t resetepoch, int64_t host_dram_size_in_byte, int64_t host_way)
+    int64_t resetepoch, int64_t host_dram_size_in_byte, int64_t host_way,
+    repl_policy_enum cache_policy, repl_policy_enum host_policy)
     : 
-        the_cache(cache_size_in_byte, way, maxthreshold, resetepoch), 
-        host_dram(host_dram_size_in_byte, host_way, maxthreshold, resetepoch),
+        the_cache(cache_size_in_byte, way, maxthreshold, resetepoch, cache_policy), 
+        host_dram(host_dram_size_in_byte, host_way, maxthreshold, resetepoch, host_policy),
         WritelogQueue(40960), PromotionQueue(409600){
     host_dram_size_pagenum = host_dram_size_in_byte / 4096;
 
@@ -17,24 +20,87 @@ cache_controller::cache_controller(int64_t cache_size_in_byte, int way, int64_t
 }
 
 
-void cache_controller::snapshot(FILE* output_file){
-    the_cache.snapshot(output_file);
+void cache_controller::snapshot(snapshot_writer* w){
+    std::vector<uint64_t> sets;
+    the_cache.snapshot(sets);
+    snapshot_add(w, SNAP_SSD_CACHE, std::move(sets));
     if (promotion_enable || tpp_enable)
     {
-        host_dram.snapshot(output_file);
+        sets.clear();
+        host_dram.snapshot(sets);
+        snapshot_add(w, SNAP_HOST_DRAM, std::move(sets));
     }
 }
 
 
-void cache_controller::replay_snapshot(FILE* input_file){
-    the_cache.replay_snapshot(input_file);
+void cache_controller::replay_snapshot(snapshot_file* s){
+    uint64_t len;
+    const uint64_t *sets = snapshot_section_data(s, SNAP_SSD_CACHE, &len);
+    bytefs_assert_msg(sets, "snapshot has no SSD cache");
+    the_cache.replay_snapshot(sets, len);
     if (promotion_enable || tpp_enable)
     {
-        host_dram.replay_snapshot(input_file);
+        sets = snapshot_section_data(s, SNAP_HOST_DRAM, &len);
+        bytefs_assert_msg(sets, "snapshot has no host DRAM");
+        host_dram.replay_snapshot(sets, len);
     }
 }
 
 
+bool cache_controller::snapshot_from_text(FILE* input_file, snapshot_writer* w){
+    std::vector<uint64_t> sets;
+    if (!sa_cache::snapshot_from_text(input_file, sets))
+        return false;
+    snapshot_add(w, SNAP_SSD_CACHE, std::move(sets));
+    if (promotion_enable || tpp_enable)
+    {
+        sets.clear();
+        if (!sa_cache::snapshot_from_text(input_file, sets))
+            return false;
+        snapshot_add(w, SNAP_HOST_DRAM, std::move(sets));
+    }
+    return true;
+}
+
+
+void cache_controller::checkpoint(snapshot_writer* w){
+    std::vector<uint64_t> sets;
+    the_cache.checkpoint(sets);
+    snapshot_add(w, SNAP_CKPT_SSD_CACHE, std::move(sets));
+    sets.clear();
+    host_dram.checkpoint(sets);
+    snapshot_add(w, SNAP_CKPT_HOST_DRAM, std::move(sets));
+    snapshot_add(w, SNAP_CKPT_TIERS, {(uint64_t)host_dram_size_pagenum, (uint64_t)total_access_num,
+                                      (uint64_t)host_hit, (uint64_t)anywaydram_hit});
+}
+
+
+bool cache_controller::restore_checkpoint(snapshot_file* s){
+    uint64_t cache_len, host_len, tiers_len;
+    const uint64_t *cache = snapshot_section_data(s, SNAP_CKPT_SSD_CACHE, &cache_len);
+    const uint64_t *host = snapshot_section_data(s, SNAP_CKPT_HOST_DRAM, &host_len);
+    const uint64_t *tiers = snapshot_section_data(s, SNAP_CKPT_TIERS, &tiers_len);
+    if (!cache || !host || !tiers || tiers_len != 4 || (int64_t)tiers[0] != host_dram_size_pagenum)
+        return false;
+    if (!the_cache.restore_checkpoint(cache, cache_len) || !host_dram.restore_checkpoint(host, host_len))
+        return false;
+    total_access_num = tiers[1];
+    host_hit = tiers[2];
+    anywaydram_hit = tiers[3];
+    return true;
+}
+
+
+bool cache_controller::checkpoint_valid(snapshot_file* s){
+    uint64_t cache_len, host_len, tiers_len;
+    const uint64_t *cache = snapshot_section_data(s, SNAP_CKPT_SSD_CACHE, &cache_len);
+    const uint64_t *host = snapshot_section_data(s, SNAP_CKPT_HOST_DRAM, &host_len);
+    const uint64_t *tiers = snapshot_section_data(s, SNAP_CKPT_TIERS, &tiers_len);
+    return tiers && tiers_len == 4 &&
+           sa_cache::checkpoint_valid(cache, cache_len) && sa_cache::checkpoint_valid(host, host_len);
+}
+
+
                                                                                                                                                                                                                             
 /*
 void cache_controller::process_a_memrequest(char type, int64_t addr){
@@ -105,6 +171,91 @@ void cache_controller::process_a_memrequest(char type, int64_t addr){
 }
 */
 
+void fill_table::init(int nchs, int max_per_ch){
+    channels.assign(nchs, std::multimap<uint64_t, int64_t>());
+    pages.clear();
+    released.clear();
+    this->max_per_ch = max_per_ch;
+}
+
+
+void fill_table::retire(int ch, uint64_t now){
+    release(ch, now, now);
+    while (!released.empty() && released.begin()->first <= now)
+    {
+        auto it = pages.find(released.begin()->second);
+        if (it != pages.end() && it->second == released.begin()->first)
+            pages.erase(it);
+        released.erase(released.begin());
+    }
+}
+
+
+void fill_table::release(int ch, uint64_t until, uint64_t now){
+    std::multimap<uint64_t, int64_t> &out = channels[ch];
+    while (!out.empty() && out.begin()->first <= until)
+    {
+        auto it = pages.find(out.begin()->second);
+        if (it != pages.end() && it->second == out.begin()->first && it->second > now)
+            released.emplace(out.begin()->first, out.begin()->second);
+        else if (it != pages.end() && it->second == out.begin()->first)
+            pages.erase(it);
+        out.erase(out.begin());
+    }
+}
+
+
+uint64_t fill_table::lookup(int64_t page, uint64_t now){
+    std::lock_guard<std::mutex> guard(mutex);
+    auto it = pages.find(page);
+    if (it == pages.end() || it->second <= now)
+        return 0;
+    return it->second;
+}
+
+
+uint64_t fill_table::reserve(int ch, uint64_t now){
+    std::multimap<uint64_t, int64_t> &out = channels[ch];
+    retire(ch, now);
+    if (max_per_ch == 0 || out.size() < max_per_ch)
+        return now;
+    // wait for the fill of the channel that completes first
+    uint64_t start = out.begin()->first;
+    release(ch, start, now);
+    SSD_STAT_ATOMIC_INC(fill_delayed);
+    SSD_STAT_ATOMIC_ADD(fill_wait_ns, start - now);
+    return start;
+}
+
+
+uint64_t fill_table::record(int64_t page, int ch, uint64_t start, uint64_t lat){
+    // served without a NAND read
+    if (lat == 0)
+        return start;
+    std::multimap<uint64_t, int64_t> &out = channels[ch];
+    uint64_t done = start + lat;
+    out.emplace(done, page);
+    pages[page] = done;
+    SSD_STAT_ATOMIC_INC(fill_issued);
+    SSD_STAT_ATOMIC_ADD(fill_depth_sum, out.size());
+    if (out.size() > stat.fill_depth_max.load())
+        stat.fill_depth_max = out.size();
+    return done;
+}
+
+
+uint64_t fill_table::depth(uint64_t now){
+    std::lock_guard<std::mutex> guard(mutex);
+    uint64_t n = 0;
+    for (size_t ch = 0; ch < channels.size(); ch++)
+    {
+        retire(ch, now);
+        n += channels[ch].size();
+    }
+    return n + released.size();
+}
+
+
 void cache_controller::report_statistics(){
     std::cout<<"-----------------------------------------------------"<<std::endl;
     std::cout<<"Host DRAM hit rate: "<<(double)host_hit/total_access_num<<std::endl;
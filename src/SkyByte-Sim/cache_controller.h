@@ -1,10 +1,14 @@
 #include <boost/lockfree/queue.hpp>
 
 #include <unordered_set>
+#include <unordered_map>
+#include <map>
+#include <vector>
 #include <queue>
 #include <mutex>
 #include <condition_variable>
 #include "cache.h"
+#include "snapshot.h"
 
 
 template <typename T>
@@ -62,6 +66,41 @@ struct page_promotion_migration
 
 
 
+/*
+ * NAND reads filling the SSD cache that have not completed yet, the
+ * device-side MSHRs. A miss to a page whose read is outstanding attaches to
+ * it and completes with it, also when the page was evicted while the read
+ * was in flight. With max_per_ch set, a fill finding that many fills
+ * outstanding on its flash channel starts when the earliest one completes.
+ * Fills retire lazily once the simulated time passed their completion.
+ */
+class fill_table{
+    public:
+    void init(int nchs, int max_per_ch);
+    /* completion time of the read of @page outstanding at @now, 0 if none */
+    uint64_t lookup(int64_t page, uint64_t now);
+    /* @read(start) is the NAND latency of @page from start, returns the completion time */
+    template <typename F>
+    uint64_t fill(int64_t page, int ch, uint64_t now, F read);
+    /* fills outstanding at @now, over all channels */
+    uint64_t depth(uint64_t now);
+
+    private:
+    void retire(int ch, uint64_t now);
+    /* frees the slots of @ch up to @until, the fills stay visible to lookup until they complete */
+    void release(int ch, uint64_t until, uint64_t now);
+    /* start time of a new fill on @ch, called with the mutex held */
+    uint64_t reserve(int ch, uint64_t now);
+    uint64_t record(int64_t page, int ch, uint64_t start, uint64_t lat);
+
+    std::vector<std::multimap<uint64_t, int64_t>> channels;    // completion time -> page
+    std::unordered_map<int64_t, uint64_t> pages;               // page -> completion time
+    std::multimap<uint64_t, int64_t> released;                 // in flight, slot already reused
+    size_t max_per_ch = 0;
+    std::mutex mutex;
+};
+
+
 using boost::lockfree::queue;
 using boost::lockfree::fixed_sized;
 class cache_controller{
@@ -69,6 +108,7 @@ class cache_controller{
     sa_cache the_cache;
     //std::unordered_set<int64_t> promoted_set;
     sa_cache host_dram;
+    fill_table fills;
     int64_t host_dram_size_pagenum;
 
     //Test statistics
@@ -82,13 +122,26 @@ class cache_controller{
     //SafeQueue<page_promotion_migration> PromotionQueue;
 
     cache_controller(int64_t cache_size_in_byte, int way, int64_t maxthreshold, 
-    int64_t resetepoch, int64_t host_dram_size_in_byte, int64_t host_way);
+    int64_t resetepoch, int64_t host_dram_size_in_byte, int64_t host_way,
+    repl_policy_enum cache_policy = REPL_LRU, repl_policy_enum host_policy = REPL_LRU);
     //void process_a_memrequest(char type, int64_t addr);
-    void snapshot(FILE* output_file);
-    void replay_snapshot(FILE* input_file);
+    void snapshot(snapshot_writer* w);
+    void replay_snapshot(snapshot_file* s);
+    /* converts the text dump older versions wrote */
+    static bool snapshot_from_text(FILE* input_file, snapshot_writer* w);
+    /* complete tier state for the post-warmup checkpoint */
+    void checkpoint(snapshot_writer* w);
+    bool restore_checkpoint(snapshot_file* s);
+    /* layout check of the tier sections, before the controller exists */
+    static bool checkpoint_valid(snapshot_file* s);
 
     void report_statistics();
 };
 
 
-
+template <typename F>
+uint64_t fill_table::fill(int64_t page, int ch, uint64_t now, F read){
+    std::lock_guard<std::mutex> guard(mutex);
+    uint64_t start = reserve(ch, now);
+    return record(page, ch, start, read(start));
+}
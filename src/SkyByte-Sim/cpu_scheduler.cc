@@ -5,6 +5,8 @@
 #include "cpu_scheduler.h"
 #include "simulator_clock.h"
 #include "ftl.h"
+#include "cxl_link.h"
+#include "ssd_prefetch.h"
 
 using std::vector;
 using std::queue;
@@ -64,7 +66,7 @@ void *traceReplayThread(void *thread_args) {
     
     const uint64_t ctx_swh_deadtime = args->scheduler->ctx_swh_deadtime;
 
-    volatile trace_sample *sample = nullptr;
+    const volatile trace_sample *sample = nullptr;
     volatile uint64_t *const core_time_diff = &this_core.current_time_diff;
     printf("Logical core (%02d-%16lx): created\n", this_core.core_id, (uint64_t) args->logical_core);
 
@@ -276,6 +278,8 @@ context_switch:
             
 
             byte_issue(is_write, addr, size, &resp);
+            cxl_link_transfer(is_write, &resp);
+            ssd_prefetch_observe(addr, &resp);
             
 
             // if a preemption is signaled, yield this thread immediately
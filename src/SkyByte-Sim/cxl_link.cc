@@ -0,0 +1,153 @@
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <set>
+
+#include "cxl_link.h"
+#include "ssd_stat.h"
+#include "simulator_clock.h"
+
+bool cxl_link_enable = false;
+int cxl_link_gen = 2;
+int cxl_link_lanes = 8;
+int cxl_link_credits = 64;
+
+extern sim_clock* the_clock_pt;
+
+/* the request direction of the link, times in ps */
+struct cxl_dir {
+    uint64_t free_at;                   // the link serialized everything queued on it
+    std::multiset<uint64_t> credits;    // return times of the credits in use
+};
+
+/*
+ * Responses become ready out of order: an SSD cache hit booked after a
+ * flash miss is ready long before it. S2M therefore keeps the busy
+ * intervals of the link, and a response takes the first gap from its
+ * ready time on, ahead of later ones booked earlier.
+ */
+struct cxl_rsp_dir {
+    std::map<uint64_t, uint64_t> busy;          // link busy intervals, start -> end
+    std::multimap<uint64_t, uint64_t> held;     // credits in use, return -> send time
+};
+
+static cxl_dir m2s;
+static cxl_rsp_dir s2m;
+static uint64_t slot_ps, flit_ps;
+static std::mutex link_mutex;
+
+void cxl_link_init(void) {
+    // CXL 1.1/2.0 run over PCIe 5.0 (32 GT/s, 128b/130b), CXL 3.x over PCIe 6.0 (64 GT/s, flit mode)
+    double bytes_per_ns = cxl_link_gen >= 3 ? 64.0 * cxl_link_lanes / 8 : 32.0 * cxl_link_lanes / 8 * 128 / 130;
+    int flit_bytes = cxl_link_gen >= 3 ? CXL_FLIT256_BYTES : CXL_FLIT68_BYTES;
+    int flit_slots = cxl_link_gen >= 3 ? CXL_FLIT256_SLOTS : CXL_FLIT68_SLOTS;
+    flit_ps = (uint64_t) (flit_bytes * 1000 / bytes_per_ns);
+    slot_ps = flit_ps / flit_slots;
+    m2s = cxl_dir();
+    s2m = cxl_rsp_dir();
+    bytefs_log("CXL link: gen %d x%d, %.1f GB/s per direction, %d credits",
+            cxl_link_gen, cxl_link_lanes, bytes_per_ns, cxl_link_credits);
+}
+
+/* earliest time from @t a message holds a credit of @d */
+static uint64_t take_credit(cxl_dir &d, uint64_t t) {
+    while (!d.credits.empty() && *d.credits.begin() <= t)
+        d.credits.erase(d.credits.begin());
+    if ((int) d.credits.size() < cxl_link_credits)
+        return t;
+    uint64_t at = *d.credits.begin();
+    d.credits.erase(d.credits.begin());
+    SSD_STAT_ATOMIC_INC(cxl_credit_stalls);
+    return at;
+}
+
+/* sends @slots on @d from @t, returns when the receiver has the message */
+static uint64_t transmit(cxl_dir &d, uint64_t t, int slots, uint64_t *queued) {
+    uint64_t start = std::max(t, d.free_at);
+    *queued += start - t;
+    d.free_at = start + slots * slot_ps;
+    // alone on the link a message still waits for its whole flit
+    return start + std::max(slots * slot_ps, flit_ps) + CXL_PORT_LATENCY * 1000;
+}
+
+/*
+ * sends a response of @slots on S2M from @t, returns when the host has it;
+ * the credit is held from the send until then
+ */
+static uint64_t transmit_rsp(cxl_rsp_dir &d, uint64_t t, uint64_t now, int slots, uint64_t *queued) {
+    uint64_t dur = slots * slot_ps;
+    uint64_t span = std::max(dur, flit_ps) + CXL_PORT_LATENCY * 1000;
+    // nothing is sent before now any more
+    while (!d.busy.empty() && d.busy.begin()->second <= now)
+        d.busy.erase(d.busy.begin());
+    while (!d.held.empty() && d.held.begin()->first <= now)
+        d.held.erase(d.held.begin());
+
+    uint64_t start = t;
+    bool stalled = false;
+    while (true) {
+        // first gap of the link from start on that fits the message
+        auto it = d.busy.upper_bound(start);
+        if (it != d.busy.begin() && std::prev(it)->second > start)
+            start = std::prev(it)->second;
+        for (; it != d.busy.end() && it->first < start + dur; ++it)
+            start = std::max(start, it->second);
+        // credits held by responses in flight while this one is
+        int in_use = 0;
+        uint64_t first_return = 0;
+        for (auto h = d.held.upper_bound(start); h != d.held.end(); ++h) {
+            if (h->second < start + span) {
+                if (in_use++ == 0)
+                    first_return = h->first;
+            }
+        }
+        if (in_use < cxl_link_credits)
+            break;
+        start = first_return;
+        stalled = true;
+    }
+    if (stalled)
+        SSD_STAT_ATOMIC_INC(cxl_credit_stalls);
+
+    *queued += start - t;
+    d.busy[start] = start + dur;
+    d.held.emplace(start + span, start);
+    return start + span;
+}
+
+static inline int msg_slots(bool data) {
+    return (CXL_MSG_HEADER_BYTES + (data ? 64 : 0) + CXL_SLOT_BYTES - 1) / CXL_SLOT_BYTES;
+}
+
+void cxl_link_transfer(int is_write, issue_response *resp) {
+    // host DRAM hits never leave the host
+    if (!cxl_link_enable || (resp->flag & HOST_DRAM_HIT))
+        return;
+    uint64_t now = (uint64_t) the_clock_pt->get_time_sim() * 1000;
+    uint64_t queued = 0;
+    int req_slots = msg_slots(is_write);        // MemWr carries the line, MemRd is a header
+    int rsp_slots = msg_slots(!is_write);       // read data (DRS), write completion (NDR)
+
+    std::unique_lock<std::mutex> lock(link_mutex);
+    uint64_t t = take_credit(m2s, now);
+    queued += t - now;
+    uint64_t arrive = transmit(m2s, t, req_slots, &queued);
+    // a context switch answers before the flash read, the data follows once it completes
+    uint64_t device_ns = (resp->flag & ONGOING_DELAY) ? resp->estimated_latency : resp->latency;
+    // the device frees the request's buffer entry once it responds
+    uint64_t ready = arrive + device_ns * 1000;
+    m2s.credits.insert(ready);
+    uint64_t done = transmit_rsp(s2m, ready, now, rsp_slots, &queued);
+    lock.unlock();
+
+    uint64_t link_ns = (done - now + 999) / 1000 - device_ns;
+    resp->latency += link_ns;
+    if (resp->flag & ONGOING_DELAY)
+        resp->estimated_latency += link_ns;
+    SSD_STAT_ATOMIC_INC(cxl_msgs);
+    SSD_STAT_ATOMIC_ADD(cxl_m2s_slots, req_slots);
+    SSD_STAT_ATOMIC_ADD(cxl_s2m_slots, rsp_slots);
+    SSD_STAT_ATOMIC_ADD(cxl_link_ns, link_ns);
+    SSD_STAT_ATOMIC_ADD(cxl_queue_ns, queued / 1000);
+    ssd_stat_record_lat(LAT_CXL_LINK, link_ns);
+}
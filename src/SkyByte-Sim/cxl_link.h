@@ -0,0 +1,36 @@
+#ifndef __CXL_LINK_H__
+#define __CXL_LINK_H__
+
+#include <stdint.h>
+
+#include "ftl.h"
+#include "timing_model.h"
+
+/*
+ * CXL.mem link between the host and the device. Each direction (M2S
+ * requests, S2M responses) serializes its messages at the bandwidth of
+ * cxl_link_lanes lanes of generation cxl_link_gen, and a message may only
+ * be sent while the receiver has a credit for it: a request holds its M2S
+ * credit until the device responds, a response its S2M credit from its send
+ * until the host received it. Responses go out in the order they become
+ * ready, not in the order of the requests. Queueing for credits and for the
+ * link makes the latency grow with the offered load.
+ *
+ * byte_issue() answers with the device-side latency; the link time is
+ * added on top of it by cxl_link_transfer().
+ */
+extern bool cxl_link_enable;
+extern int cxl_link_gen;
+extern int cxl_link_lanes;
+extern int cxl_link_credits;
+
+void cxl_link_init(void);
+/* adds the link round trip to @resp of an access reaching the device */
+void cxl_link_transfer(int is_write, issue_response *resp);
+
+/* the CXL round trip byte_issue() includes when the link is not modeled */
+inline long cxl_flat_latency(void) {
+    return cxl_link_enable ? 0 : CXL_FLAT_LATENCY;
+}
+
+#endif
@@ -4,6 +4,8 @@
 #include <mutex>
 #include <deque>
 #include <set>
+#include <vector>
+#include <algorithm>
 
 #include "ftl.h"
 
@@ -13,6 +15,9 @@
 #include "bytefs_gc.h"
 #include "bytefs_utils.h"
 #include "ssd_stat.h"
+#include "interval_stat.h"
+#include "ssd_prefetch.h"
+#include "cxl_link.h"
 #include "cache_controller.h"
 #include "utils.h"
 #include "simulator_clock.h"
@@ -32,9 +37,21 @@ bool print_page_locality = true;
 
 long ssd_cache_size_byte = 512*1024*1024;
 int ssd_cache_way = 16;
+repl_policy_enum ssd_cache_policy = REPL_LRU;
+repl_policy_enum host_dram_policy = REPL_LRU;
+int ssd_fill_per_channel = 0;               /* outstanding SSD cache fills per flash channel, 0 unlimited */
 long host_dram_size_byte =1*1024*1024*1024;
 
 double write_log_ratio = 0.125;
+uint64_t log_writer_threads = 1;
+uint64_t flush_threads = 1;
+bool multi_stream_enable = false;
+bool temperature_classify = false;
+bool nand_timing_detailed = false;
+bool nand_suspend_enable = true;
+bool nand_cache_ops = true;
+nand_sched_policy_enum nand_sched_policy = NSCHED_FIFO;
+uint64_t nand_sched_max_delay = 1000000;    /* ns a background command may be pushed back by reads */
 
 ssd gdev;
 int inited_flag = 0;
@@ -141,30 +158,88 @@ void pgidx2ppa(struct ssd *ssd, ppa *ppa)
     ppa->g.pg = pgidx;
 }
 
+/* with multi-stream off every stream writes through the user one */
+static inline int ssd_stream(int stream)
+{
+    bytefs_assert(stream >= 0 && stream < NR_WRITE_STREAMS);
+    return multi_stream_enable ? stream : WS_USER;
+}
+
+static inline write_pointer *ssd_stream_wp(struct ssd *ssd, int stream)
+{
+    return &ssd->wp[ssd_stream(stream)];
+}
+
+static void ssd_init_write_streams(struct ssd *ssd)
+{
+    if (!temperature_classify)
+        return;
+    if (!ssd->temp_counters)
+        ssd->temp_counters = (uint8_t *) malloc(TEMP_TABLE_SIZE);
+    bytefs_assert(ssd->temp_counters);
+    memset(ssd->temp_counters, 0, TEMP_TABLE_SIZE);
+    ssd->temp_updates = 0;
+}
+
+/**
+ * Pick the stream of a user page write: with the temperature classifier on,
+ * pages updated TEMP_HOT_THRESHOLD times or more within the current decay
+ * window go to the hot stream. Called with maptbl_update_mutex held.
+ */
+int ssd_user_write_stream(struct ssd *ssd, uint64_t lpn)
+{
+    uint64_t i, idx;
+    uint8_t cnt;
+    if (!temperature_classify)
+        return WS_USER;
+    idx = (lpn * 0x9E3779B97F4A7C15UL) >> (64 - TEMP_TABLE_BITS);
+    cnt = ssd->temp_counters[idx];
+    if (cnt < UINT8_MAX)
+        ssd->temp_counters[idx] = ++cnt;
+    if (++ssd->temp_updates % TEMP_DECAY_INTERVAL == 0) {
+        for (i = 0; i < TEMP_TABLE_SIZE; i++)
+            ssd->temp_counters[i] >>= 1;
+    }
+    return cnt >= TEMP_HOT_THRESHOLD ? WS_USER_HOT : WS_USER;
+}
+
 #if ALLOCATION_SECHEM_LINE
-static void ssd_init_write_pointer(struct ssd *ssd)
+static void ssd_open_sb(struct ssd *ssd, write_pointer *wpp)
 {
-    write_pointer *wpp = &ssd->wp;
     ssd_superblock *sb = bytefs_get_next_free_sb(ssd);
     wpp->blk_ptr = NULL; // not used
-    
+
     wpp->ch = 0;
     wpp->lun = 0;
     wpp->blk = sb->blk_idx;
     wpp->pg = 0;
+
+    sb->line_wp = 0;
+    sb->is_open = 1;
+}
+
+static void ssd_init_write_pointer(struct ssd *ssd)
+{
+    int stream;
+    for (stream = 0; stream < (multi_stream_enable ? NR_WRITE_STREAMS : 1); stream++)
+        ssd_open_sb(ssd, &ssd->wp[stream]);
+    ssd_init_write_streams(ssd);
 }
 #else
 static void ssd_init_write_pointer(struct ssd *ssd)
 {
-    write_pointer *wpp = &ssd->wp;
-    wpp->next_ch = 0;
-    wpp->blk_ptr = bytefs_get_next_free_blk(ssd, &wpp->next_ch);
-    wpp->ch = wpp->blk_ptr->ch_idx;
-    wpp->lun = wpp->blk_ptr->way_idx;
-    wpp->blk = wpp->blk_ptr->blk_idx;
-    wpp->pg = 0;
-    wpp->blk_ptr->wp = 0;
-
+    int stream;
+    for (stream = 0; stream < (multi_stream_enable ? NR_WRITE_STREAMS : 1); stream++) {
+        write_pointer *wpp = &ssd->wp[stream];
+        wpp->next_ch = stream % ssd->sp.nchs;
+        wpp->blk_ptr = bytefs_get_next_free_blk(ssd, &wpp->next_ch);
+        wpp->ch = wpp->blk_ptr->ch_idx;
+        wpp->lun = wpp->blk_ptr->way_idx;
+        wpp->blk = wpp->blk_ptr->blk_idx;
+        wpp->pg = 0;
+        wpp->blk_ptr->wp = 0;
+    }
+    ssd_init_write_streams(ssd);
 }
 #endif
 
@@ -174,12 +249,13 @@ static void ssd_init_write_pointer(struct ssd *ssd)
 // }
 
 #if ALLOCATION_SECHEM_LINE
-void ssd_advance_write_pointer(struct ssd *ssd)
+void ssd_advance_write_pointer(struct ssd *ssd, int stream)
 {
     ssdparams *spp = &ssd->sp;
-    write_pointer *wpp = &ssd->wp;
+    write_pointer *wpp = ssd_stream_wp(ssd, stream);
     // line_mgmt *lm = &ssd->lm;
 
+    SSD_STAT_ATOMIC_INC(stream_wr_page[ssd_stream(stream)]);
     wpp->ch++;
     ssd->sb[wpp->blk].wtl[wpp->pg].wp++;
 
@@ -193,13 +269,12 @@ void ssd_advance_write_pointer(struct ssd *ssd)
             ssd->sb[wpp->blk].line_wp++;
 
             if (wpp->pg == spp->pgs_per_blk) {
-                ssd_superblock *sb = bytefs_get_next_free_sb(ssd);
-                wpp->ch = 0;
-                wpp->lun = 0;
-                wpp->blk = sb->blk_idx;
-                wpp->pg = 0;
-
-                sb->line_wp = 0;
+                // with multi-stream on, the full superblock may now be picked by GC
+                ssd_superblock *full_sb = &ssd->sb[wpp->blk];
+                full_sb->is_open = 0;
+                if (multi_stream_enable && full_sb->ipc > 0)
+                    bytefs_try_add_gc_candidate_sb(ssd, full_sb);
+                ssd_open_sb(ssd, wpp);
             }
         }
     }
@@ -210,12 +285,13 @@ void ssd_advance_write_pointer(struct ssd *ssd)
     bytefs_assert(wpp->pg < spp->pgs_per_blk);
 }
 #else
-void ssd_advance_write_pointer(struct ssd *ssd)
+void ssd_advance_write_pointer(struct ssd *ssd, int stream)
 {
     ssdparams *spp = &ssd->sp;
-    write_pointer *wpp = &ssd->wp;
+    write_pointer *wpp = ssd_stream_wp(ssd, stream);
     // line_mgmt *lm = &ssd->lm;
 
+    SSD_STAT_ATOMIC_INC(stream_wr_page[ssd_stream(stream)]);
     // check_addr(wpp->ch, spp->nchs);
     wpp->pg++;
     // check if we reached last page in block
@@ -246,9 +322,9 @@ void ssd_advance_write_pointer(struct ssd *ssd)
 #endif
 
 
-ppa get_new_page(struct ssd *ssd)
+ppa get_new_page(struct ssd *ssd, int stream)
 {
-    write_pointer *wpp = &ssd->wp;
+    write_pointer *wpp = ssd_stream_wp(ssd, stream);
     ppa ppa;
     ppa.realppa = 0;
     ppa.g.ch = wpp->ch;
@@ -281,36 +357,30 @@ static void ssd_init_params(ssdparams *spp)
     spp->tt_wls = spp->wls_per_sb * spp->sb_per_ssd;
     // spp->blk_per_sb = BLOCK_COUNT;
 
-    if (n_type & nand_type::HLL_NAND)
-    {
-        spp->pg_rd_lat = NAND_READ_LATENCY;
-        spp->pg_wr_lat = NAND_PROG_LATENCY;
-        spp->blk_er_lat = NAND_BLOCK_ERASE_LATENCY;
+    static const nand_cell_timing hll_timing = NAND_TIMING_HLL;
+    static const nand_cell_timing slc_timing = NAND_TIMING_SLC;
+    static const nand_cell_timing mlc_timing = NAND_TIMING_MLC;
+    static const nand_cell_timing tlc_timing = NAND_TIMING_TLC;
+    if (n_type & nand_type::HLL_NAND)       spp->cell = hll_timing;
+    else if (n_type & nand_type::SLC_NAND)  spp->cell = slc_timing;
+    else if (n_type & nand_type::MLC_NAND)  spp->cell = mlc_timing;
+    else if (n_type & nand_type::TLC_NAND)  spp->cell = tlc_timing;
+    else                                    assert(0);
+
+    // the simple model uses the averages over page types
+    spp->pg_rd_lat = 0;
+    spp->pg_wr_lat = 0;
+    for (int t = 0; t < spp->cell.bits_per_cell; t++) {
+        spp->pg_rd_lat += spp->cell.rd_lat[t];
+        spp->pg_wr_lat += spp->cell.wr_lat[t];
     }
-    else if (n_type & nand_type::SLC_NAND)
-    {
-        spp->pg_rd_lat = 25000;
-        spp->pg_wr_lat = 200000;
-        spp->blk_er_lat = 1500000;
-    }
-    else if (n_type & nand_type::MLC_NAND)
-    {
-        spp->pg_rd_lat = 50000;
-        spp->pg_wr_lat = 600000;
-        spp->blk_er_lat = 3000000;
-    }
-    else if (n_type & nand_type::TLC_NAND)
-    {
-        spp->pg_rd_lat = 4000;
-        spp->pg_wr_lat = 75000;
-        spp->blk_er_lat = 853000;
-    }
-    else
-    {
-        assert(0);
-    }
-    
-    spp->ch_xfer_lat = CHNL_TRANSFER_LATENCY_NS;
+    spp->pg_rd_lat /= spp->cell.bits_per_cell;
+    spp->pg_wr_lat /= spp->cell.bits_per_cell;
+    spp->blk_er_lat = spp->cell.er_lat;
+
+    // CHNL_TRANSFER_LATENCY_NS is the block interface estimate, the NAND bus is faster
+    spp->ch_xfer_lat = NAND_PAGE_XFER_LATENCY;
+    spp->pls_per_lun = NAND_PLANES_PER_LUN;
 
     spp->pgs_per_lun = spp->pgs_per_blk * spp->blks_per_lun;
     spp->pgs_per_ch = spp->pgs_per_lun * spp->luns_per_ch;
@@ -347,6 +417,7 @@ static void ssd_init_nand_blk(nand_block *blk, ssdparams *spp)
     blk->ipc = 0;
     blk->vpc = 0;
     blk->erase_cnt = 0;
+    blk->last_write_seq = 0;
     blk->wp = 0;
 }
 
@@ -363,6 +434,9 @@ static void ssd_init_nand_lun(nand_lun *lun, ssdparams *spp)
     lun->next_lun_avail_time = 0;
     lun->next_log_flush_lun_avail_time = 0;
     lun->this_lun_avail_time = 0;
+    memset(&lun->die, 0, sizeof(lun->die));
+    lun->sched_len = 0;
+    lun->sched_busy_end = 0;
     lun->busy = false;
 }
 
@@ -416,6 +490,10 @@ static void ssd_init_maptbl(struct ssd *ssd)
     // for (i = 0; i < spp->tt_pgs; i++) {
     //     ssd->maptbl[i].realppa = UNMAPPED_PPA;
     // }
+#if FTL_MAPTBL_DENSE
+    ssd->maptbl.init();
+#endif
+    ssd->indirection_mt.init();
 }
 
 static void ssd_init_rmap(struct ssd *ssd)
@@ -535,6 +613,281 @@ nand_lun *ssd_get_lun(struct ssd *ssd, uint64_t ch_idx, uint64_t lun_idx) {
 
 
 /** key function that calculates latency */
+static inline uint64_t die_avail_time(nand_die_timing *die)
+{
+    uint64_t t = 0;
+    for (int pl = 0; pl < NAND_PLANES_PER_LUN; pl++)
+        t = max(t, die->plane_avail_time[pl]);
+    return t;
+}
+
+/* move the data of one page over the channel bus, returns when it is done */
+static inline uint64_t ssd_channel_xfer(struct ssd *ssd, ssd_channel *ch, uint64_t stime)
+{
+    std::lock_guard<mutex> guard(ch->bus_mutex);
+    uint64_t bus_stime = max(stime, ch->next_ch_avail_time);
+    ch->next_ch_avail_time = bus_stime + ssd->sp.ch_xfer_lat;
+    return ch->next_ch_avail_time;
+}
+
+/**
+ * Detailed NAND timing, called with the LUN timing lock held. The channel bus
+ * and each plane have their own timeline: reads occupy their plane's array
+ * and then the bus, so reads on other planes and data-out overlap. Programs
+ * and erases occupy the whole die; a program whose data-in ends before a
+ * pending program on another plane started joins it as a multi-plane
+ * program. With cache operations on, the array of a read is free once data
+ * moved to the cache register, and the next program's data-in overlaps the
+ * current program. With suspend on, a read arriving during a program/erase
+ * suspends it, reads of one suspension run one after another, and the op
+ * resumes after the last of them. Returns the
+ * completion time of the command, @nand_stime is when the LUN started it.
+ */
+static uint64_t ssd_advance_status_detailed(struct ssd *ssd, ppa *ppa, nand_cmd *ncmd,
+                                            nand_lun *lun, uint64_t cmd_stime, uint64_t *nand_stime)
+{
+    ssdparams *spp = &ssd->sp;
+    nand_die_timing *die = &lun->die;
+    ssd_channel *ch = &ssd->ch[ppa->g.ch];
+    int plane = ppa->g.blk % NAND_PLANES_PER_LUN;
+    int pg_type = ppa->g.pg % spp->cell.bits_per_cell;
+    uint64_t array_stime, array_etime, done_time;
+
+    switch (ncmd->cmd) {
+    case NAND_READ:
+        if (nand_suspend_enable && die->pe_end > cmd_stime && die->pe_start <= cmd_stime &&
+                die->pe_suspends < NAND_MAX_SUSPENDS) {
+            // suspend the program/erase, read, then resume it; a read arriving
+            // while the op is still suspended runs after the reads before it
+            uint64_t susp_stime = max(cmd_stime, die->susp_read_end + spp->cell.resume_lat);
+            array_stime = max(cmd_stime + spp->cell.suspend_lat, die->susp_read_end);
+            array_etime = array_stime + spp->cell.rd_lat[pg_type];
+            die->pe_end += array_etime + spp->cell.resume_lat - susp_stime;
+            die->susp_read_end = array_etime;
+            die->pe_suspends++;
+            for (int pl = 0; pl < NAND_PLANES_PER_LUN; pl++)
+                die->plane_avail_time[pl] = max(die->plane_avail_time[pl], die->pe_end);
+            SSD_STAT_ATOMIC_INC(nand_suspends);
+        } else {
+            array_stime = max(cmd_stime, die->plane_avail_time[plane]);
+            array_etime = array_stime + spp->cell.rd_lat[pg_type];
+        }
+        *nand_stime = array_stime;
+        done_time = ssd_channel_xfer(ssd, ch, array_etime);
+        // without cache read the page register holds the plane until data-out
+        die->plane_avail_time[plane] = max(die->plane_avail_time[plane],
+                                           nand_cache_ops ? array_etime : done_time);
+        break;
+
+    case NAND_WRITE: {
+        // the page register of another plane takes data while a program waits to start
+        bool pending = !die->pe_erase && die->pe_suspends == 0 && !(die->pe_planes & (1u << plane)) &&
+                       cmd_stime < die->pe_start;
+        uint64_t din_stime = pending ? cmd_stime :
+                             nand_cache_ops ? max(cmd_stime, die->cache_reg_avail_time)
+                                            : max(cmd_stime, die_avail_time(die));
+        uint64_t din_etime = ssd_channel_xfer(ssd, ch, din_stime);
+        int wr_lat = spp->cell.wr_lat[pg_type];
+        *nand_stime = din_stime;
+        if (pending && din_etime <= die->pe_start) {
+            // joins the pending program as a multi-plane program
+            die->pe_planes |= 1u << plane;
+            die->pe_end = max(die->pe_end, din_etime + wr_lat);
+            SSD_STAT_ATOMIC_INC(nand_mplane_programs);
+        } else {
+            die->pe_start = max(din_etime, die_avail_time(die));
+            die->pe_end = die->pe_start + wr_lat;
+            die->pe_planes = 1u << plane;
+            die->pe_erase = false;
+            die->pe_suspends = 0;
+        }
+        for (int pl = 0; pl < NAND_PLANES_PER_LUN; pl++)
+            die->plane_avail_time[pl] = die->pe_end;
+        // with cache program the register takes the next page once this one is latched
+        die->cache_reg_avail_time = nand_cache_ops ? max(din_etime, die->pe_start) : die->pe_end;
+        done_time = die->pe_end;
+        break;
+    }
+
+    case NAND_ERASE:
+        die->pe_start = max(cmd_stime, die_avail_time(die));
+        die->pe_end = die->pe_start + spp->cell.er_lat;
+        die->pe_planes = 1u << plane;
+        die->pe_erase = true;
+        die->pe_suspends = 0;
+        for (int pl = 0; pl < NAND_PLANES_PER_LUN; pl++)
+            die->plane_avail_time[pl] = die->pe_end;
+        die->cache_reg_avail_time = die->pe_end;
+        *nand_stime = die->pe_start;
+        done_time = die->pe_end;
+        break;
+
+    default:
+        bytefs_err("Unsupported NAND command: 0x%x\n", ncmd->cmd);
+        *nand_stime = done_time = cmd_stime;
+    }
+
+    lun->this_lun_avail_time = lun->next_lun_avail_time;
+    lun->next_lun_avail_time = die_avail_time(die);
+    return done_time;
+}
+
+bool parse_nand_sched_policy(const std::string &name, nand_sched_policy_enum *policy)
+{
+    if (name == "FIFO")             { *policy = NSCHED_FIFO; }
+    else if (name == "READ_FIRST")  { *policy = NSCHED_READ_FIRST; }
+    else if (name == "DEADLINE")    { *policy = NSCHED_DEADLINE; }
+    else                            { return false; }
+    return true;
+}
+
+const char *nand_sched_policy_name(nand_sched_policy_enum policy)
+{
+    switch (policy) {
+    case NSCHED_FIFO:        return "FIFO";
+    case NSCHED_READ_FIRST:  return "READ_FIRST";
+    case NSCHED_DEADLINE:    return "DEADLINE";
+    }
+    return "UNKNOWN";
+}
+
+const char *nand_req_class_name(int cls)
+{
+    switch (cls) {
+    case REQ_DEMAND_READ:   return "demand read";
+    case REQ_LOG_FLUSH:     return "log flush";
+    case REQ_WRITEBACK:     return "write-back";
+    case REQ_GC:            return "GC";
+    }
+    return "unknown";
+}
+
+static inline int nand_req_class_of(nand_cmd *ncmd)
+{
+    if (ncmd->type == GC_IO)
+        return REQ_GC;
+    if (ncmd->type == INTERNAL_TRANSFER)
+        return REQ_LOG_FLUSH;
+    return ncmd->cmd == NAND_READ ? REQ_DEMAND_READ : REQ_WRITEBACK;
+}
+
+static inline uint64_t nand_req_deadline(int cls)
+{
+    switch (cls) {
+    case REQ_LOG_FLUSH:     return NAND_SCHED_DEADLINE_FLUSH;
+    case REQ_WRITEBACK:     return NAND_SCHED_DEADLINE_WRITEBACK;
+    case REQ_GC:            return NAND_SCHED_DEADLINE_GC;
+    }
+    return UINT64_MAX / 2;
+}
+
+/* earliest start of a command placed at @pos of the LUN queue */
+static inline uint64_t nand_sched_slot(nand_lun *lun, int pos, uint64_t stime)
+{
+    return max(stime, pos > 0 ? lun->sched_q[pos - 1].end : lun->sched_busy_end);
+}
+
+/* whether a read of @dur placed at @pos keeps every command it overtakes in bounds */
+static bool nand_sched_can_overtake(nand_lun *lun, int pos, uint64_t stime, uint64_t dur)
+{
+    uint64_t prev_end = nand_sched_slot(lun, pos, stime) + dur;
+    for (int i = pos; i < lun->sched_len; i++) {
+        nand_sched_op *op = &lun->sched_q[i];
+        uint64_t start = max(op->start, prev_end);
+        uint64_t end = start + (op->end - op->start);
+        if (nand_sched_policy == NSCHED_READ_FIRST && op->delayed + (end - op->end) > nand_sched_max_delay)
+            return false;
+        if (nand_sched_policy == NSCHED_DEADLINE && end > op->deadline)
+            return false;
+        prev_end = end;
+    }
+    return true;
+}
+
+/**
+ * Read-priority LUN scheduler, called with the LUN timing lock held. Commands
+ * that have not started by the arrival time stay in the LUN queue; a demand
+ * read is placed ahead of the background commands (log flush, write-back, GC)
+ * at the tail of the queue, as far forward as the policy bound allows, and
+ * pushes them back by its duration. Reads never overtake each other, so reads
+ * of one LUN keep their order. Returns the completion time of the command,
+ * @nand_stime is when the LUN starts it.
+ */
+static uint64_t ssd_advance_status_sched(struct ssd *ssd, nand_cmd *ncmd, nand_lun *lun, uint64_t cmd_stime,
+                                         uint64_t *nand_stime)
+{
+    ssdparams *spp = &ssd->sp;
+    int cls = nand_req_class_of(ncmd);
+    uint64_t dur;
+
+    switch (ncmd->cmd) {
+    case NAND_READ:     dur = spp->pg_rd_lat; break;
+    case NAND_WRITE:    dur = spp->pg_wr_lat; break;
+    case NAND_ERASE:    dur = spp->blk_er_lat; break;
+    default:
+        bytefs_err("Unsupported NAND command: 0x%x\n", ncmd->cmd);
+        *nand_stime = cmd_stime;
+        return cmd_stime;
+    }
+
+    // commands already started can no longer be overtaken
+    int n = 0;
+    for (int i = 0; i < lun->sched_len; i++) {
+        if (lun->sched_q[i].start <= cmd_stime)
+            lun->sched_busy_end = max(lun->sched_busy_end, lun->sched_q[i].end);
+        else
+            lun->sched_q[n++] = lun->sched_q[i];
+    }
+    lun->sched_len = n;
+    if (lun->sched_len == NAND_SCHED_QUEUE_MAX) {
+        lun->sched_busy_end = max(lun->sched_busy_end, lun->sched_q[0].end);
+        memmove(&lun->sched_q[0], &lun->sched_q[1], (NAND_SCHED_QUEUE_MAX - 1) * sizeof(nand_sched_op));
+        lun->sched_len--;
+    }
+    SSD_STAT_ATOMIC_ADD(sched_queue_depth_sum[cls], lun->sched_len);
+
+    int pos = lun->sched_len;
+    if (cls == REQ_DEMAND_READ) {
+        // an earlier slot pushes the same commands back further, stop at the first miss
+        for (int i = lun->sched_len - 1; i >= 0 && lun->sched_q[i].cls != REQ_DEMAND_READ; i--) {
+            if (!nand_sched_can_overtake(lun, i, cmd_stime, dur))
+                break;
+            pos = i;
+        }
+    }
+
+    uint64_t start = nand_sched_slot(lun, pos, cmd_stime);
+    uint64_t prev_end = start + dur;
+    for (int i = pos; i < lun->sched_len; i++) {
+        nand_sched_op *op = &lun->sched_q[i];
+        uint64_t shift = max(op->start, prev_end) - op->start;
+        op->start += shift;
+        op->end += shift;
+        op->delayed += shift;
+        // the overtaken command now starts later, its wait grows by as much
+        SSD_STAT_ATOMIC_ADD(sched_wait_ns[op->cls], shift);
+        prev_end = op->end;
+    }
+    memmove(&lun->sched_q[pos + 1], &lun->sched_q[pos], (lun->sched_len - pos) * sizeof(nand_sched_op));
+    nand_sched_op *op = &lun->sched_q[pos];
+    op->start = start;
+    op->end = start + dur;
+    op->deadline = cmd_stime + nand_req_deadline(cls);
+    op->delayed = 0;
+    op->cls = cls;
+    lun->sched_len++;
+
+    if (pos < lun->sched_len - 1)
+        SSD_STAT_ATOMIC_INC(sched_preemptions);
+    SSD_STAT_ATOMIC_INC(sched_reqs[cls]);
+    SSD_STAT_ATOMIC_ADD(sched_wait_ns[cls], start - cmd_stime);
+
+    lun->this_lun_avail_time = lun->next_lun_avail_time;
+    lun->next_lun_avail_time = max(lun->sched_busy_end, lun->sched_q[lun->sched_len - 1].end);
+    *nand_stime = start;
+    return start + dur;
+}
+
 uint64_t ssd_advance_status(struct ssd *ssd, ppa *ppa, nand_cmd *ncmd)
 {
     
@@ -563,8 +916,48 @@ uint64_t ssd_advance_status(struct ssd *ssd, ppa *ppa, nand_cmd *ncmd)
     }
     
     
+    if (nand_timing_detailed || nand_sched_policy != NSCHED_FIFO) {
+        uint64_t done_time = nand_timing_detailed ?
+                ssd_advance_status_detailed(ssd, ppa, ncmd, lun, cmd_stime, &nand_stime) :
+                ssd_advance_status_sched(ssd, ncmd, lun, cmd_stime, &nand_stime);
+        ssd_stat_record_nand_queue(lun, nand_stime - cmd_stime);
+        if (nand_timing_detailed) {
+            int cls = nand_req_class_of(ncmd);
+            SSD_STAT_ATOMIC_INC(sched_reqs[cls]);
+            SSD_STAT_ATOMIC_ADD(sched_wait_ns[cls], nand_stime - cmd_stime);
+        }
+        lat = done_time - cmd_stime;
+        ncmd->etime = done_time;
+        if (c == NAND_READ) {
+            if (ncmd->type == USER_IO)                  SSD_STAT_ATOMIC_INC(nand_read_user)
+            else if (ncmd->type == GC_IO)               SSD_STAT_ATOMIC_INC(nand_read_gc)
+            else if (ncmd->type == INTERNAL_TRANSFER)   SSD_STAT_ATOMIC_INC(nand_read_internal)
+            lun->nrd++;
+        } else if (c == NAND_WRITE) {
+            if (ncmd->type == USER_IO)                  SSD_STAT_ATOMIC_INC(nand_write_user)
+            else if (ncmd->type == GC_IO)               SSD_STAT_ATOMIC_INC(nand_write_gc)
+            else if (ncmd->type == INTERNAL_TRANSFER) {
+                SSD_STAT_ATOMIC_INC(nand_write_internal);
+                // log flush programs run in the background of the host access
+                lat = 0;
+            }
+            lun->nwr++;
+        }
+        lun->timing_mutex.unlock();
+        return lat;
+    }
+
     nand_stime = max(lun->next_lun_avail_time, cmd_stime);
     nand_stime_writelog = max(lun->next_log_flush_lun_avail_time, cmd_stime);
+    // log flush programs run on their own timeline
+    uint64_t fifo_wait = (c == NAND_WRITE && ncmd->type == INTERNAL_TRANSFER ?
+                          nand_stime_writelog : nand_stime) - cmd_stime;
+    ssd_stat_record_nand_queue(lun, fifo_wait);
+    if (c == NAND_READ || c == NAND_WRITE || c == NAND_ERASE) {
+        int cls = nand_req_class_of(ncmd);
+        SSD_STAT_ATOMIC_INC(sched_reqs[cls]);
+        SSD_STAT_ATOMIC_ADD(sched_wait_ns[cls], fifo_wait);
+    }
 
     uint8_t op;
     switch (c) {
@@ -647,6 +1040,9 @@ uint64_t ssd_advance_status(struct ssd *ssd, ppa *ppa, nand_cmd *ncmd)
     default:
         bytefs_err("Unsupported NAND command: 0x%x\n", c);
     }
+    // log flush programs report no latency but still end on their own timeline
+    ncmd->etime = (c == NAND_WRITE && ncmd->type == INTERNAL_TRANSFER) ?
+                  lun->next_log_flush_lun_avail_time : cmd_stime + lat;
 
     
     //std::cout<<"Blk idx / ch_idx: "<<lun->blk->blk_idx<<" / "<<lun->blk->ch_idx<<", lat= "<<lat<<", r/w/e: "<<c<<", time: "<<cmd_stime<<std::endl;
@@ -735,6 +1131,10 @@ void mark_page_valid(struct ssd *ssd, ppa *ppa)
     bytefs_assert(sb->vpc >= 0 && sb->vpc < ssd->sp.pgs_per_sb);
     sb->vpc++;
 
+    ssd->gc_write_seq++;
+    blk->last_write_seq = ssd->gc_write_seq;
+    sb->last_write_seq = ssd->gc_write_seq;
+
     // //Added test:
     // int vpc_count = 0;
     // for (int ch_idx = 0; ch_idx < ssd->sp.nchs; ch_idx++) {
@@ -931,16 +1331,59 @@ int is_block_free(struct ssd *ssd, nand_block *blk)
 
 
 
+static inline imt_page *imt_lookup(struct ssd *ssd, uint64_t lpn) {
+    uint64_t ent = ssd->indirection_mt.get(lpn);
+    return ent == MAPTBL_EMPTY_ENT ? nullptr : (imt_page *) ent;
+}
+
 static bool lpa_in_imt(struct ssd *ssd, uint64_t lpa) {
-    ssd->indirection_mt_lock.lock();
-    map<uint64_t, uint64_t>::iterator imte = ssd->indirection_mt.find(lpa);
-    if (imte == ssd->indirection_mt.end()) {
+    imt_page *imtp = imt_lookup(ssd, lpa / PG_SIZE);
+    if (imtp == nullptr) {
         printf("LPA: %ld\n", lpa);
         return false;
     }
-    uint64_t log_pos = imte->second;
-    ssd->indirection_mt_lock.unlock();
-    return log_pos != INVALID_LPA;
+    uint64_t slot = (lpa % PG_SIZE) / BYTEFS_LOG_REGION_GRANDULARITY;
+    return imtp->slot[slot].load(std::memory_order_acquire) != nullptr;
+}
+
+/**
+ * check whether every cacheline of a page is held by the log, in which case
+ * the flush does not need to read the old page from NAND
+ */
+static bool imt_page_fully_logged(struct ssd *ssd, uint64_t lpn) {
+    imt_page *imtp = imt_lookup(ssd, lpn);
+    if (imtp == nullptr)
+        return false;
+    for (uint64_t bit_idx = 0; bit_idx < IMT_SLOTS_PER_PAGE; bit_idx++) {
+        log_entry *coalescing_entry = imtp->slot[bit_idx].load(std::memory_order_acquire);
+        if (coalescing_entry == nullptr || coalescing_entry->lpa == INVALID_LPA)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * detach all pending log entries of a page and coalesce them into @buffer
+ * @return: number of cachelines coalesced
+ */
+static uint64_t imt_coalesce_page(struct ssd *ssd, uint64_t lpn, void *buffer) {
+    uint64_t wr_modified = 0;
+    imt_page *imtp = imt_lookup(ssd, lpn);
+    if (imtp == nullptr)
+        return 0;
+    for (uint64_t bit_idx = 0; bit_idx < IMT_SLOTS_PER_PAGE; bit_idx++) {
+        uint64_t coalescing_offset = bit_idx * BYTEFS_LOG_REGION_GRANDULARITY;
+        log_entry *coalescing_entry = imtp->slot[bit_idx].exchange(nullptr, std::memory_order_acq_rel);
+        if (coalescing_entry == nullptr || coalescing_entry->lpa == INVALID_LPA)
+            continue;
+        assert(coalescing_entry >= ssd->bytefs_log_region_start && coalescing_entry < ssd->bytefs_log_region_end);
+        memcpy((void *) ((uint64_t) buffer + coalescing_offset),
+            (void *) (coalescing_entry->data),
+            BYTEFS_LOG_REGION_GRANDULARITY);
+        coalescing_entry->lpa = INVALID_LPA;
+        wr_modified++;
+    }
+    return wr_modified;
 }
 
 // 2bssd buffer implementation  //
@@ -952,17 +1395,16 @@ static void ssd_init_bytefs_buffer(struct ssd *ssd) {
     ssd->bytefs_log_region_end = ssd->bytefs_log_region_start + ssd->bytefs_log_region_size / sizeof(log_entry);
     ssd->log_flush_hi_threshold = ssd->bytefs_log_region_size * 50 / 100;
     ssd->log_flush_lo_threshold = ssd->bytefs_log_region_size * 0.01 / 100;
-    //ssd->indirection_mt.max_load_factor(0.3);
-    //ssd->indirection_mt.reserve(ssd->bytefs_log_region_size / BYTEFS_LOG_REGION_GRANDULARITY);
     ssd->log_page_buffer = malloc(PG_SIZE);
-    ssd->flush_page_buffer = malloc(PG_SIZE);
+    ssd->flush_page_buffer = malloc(FLUSH_BATCH_WLS * ssd->sp.tt_luns * PG_SIZE);
+    ssd->flush_batch = (flush_batch_ent *) malloc(FLUSH_BATCH_WLS * ssd->sp.tt_luns * sizeof(flush_batch_ent));
 
     for (log_entry *entry = ssd->bytefs_log_region_start; entry < ssd->bytefs_log_region_end; entry++) {
         entry->lpa = INVALID_LPA;
         memset((void *) entry->data, 0, sizeof(entry->data));
     }
     memset(ssd->log_page_buffer, 0, PG_SIZE);
-    memset(ssd->flush_page_buffer, 0, PG_SIZE);
+    memset(ssd->flush_page_buffer, 0, FLUSH_BATCH_WLS * ssd->sp.tt_luns * PG_SIZE);
 
     ssd->log_rp = ssd->bytefs_log_region_start;
     ssd->log_wp = ssd->bytefs_log_region_start;
@@ -996,21 +1438,23 @@ static inline void advance_log_tail_cacheline(struct ssd *ssd, uint64_t lpa, voi
             next_wp = old_wp + 2;
             if (next_wp > ssd->bytefs_log_region_end) bytefs_log("WP goes around");
             ssd->log_wp = next_wp > ssd->bytefs_log_region_end ? ssd->bytefs_log_region_start : new_wp;
-            ssd->log_size += sizeof(log_entry);
-            ssd->log_wp_lock.unlock();
             break;
         }
     } while (true);
 
+    // with several log writers, publish under the tail lock so entries
+    // become visible in slot order; the flush only scans up to log_size,
+    // which grows once the entry is filled
     old_wp->lpa = lpa;
     // data fill ignored
-    ssd->indirection_mt_lock.lock();
-    map<uint64_t, uint64_t>::iterator imte = ssd->indirection_mt.find(lpa);
-    log_entry *entry = (log_entry *) imte->second;
-    imte->second = (uint64_t) old_wp;
-    if ((uint64_t) entry != INVALID_LPA)
+    imt_page *imtp = imt_lookup(ssd, lpa_pg);
+    bytefs_assert_msg(imtp, "LPA: %lx not populated in IMT", lpa);
+    uint64_t slot = (lpa % PG_SIZE) / BYTEFS_LOG_REGION_GRANDULARITY;
+    log_entry *entry = imtp->slot[slot].exchange(old_wp, std::memory_order_acq_rel);
+    if (entry != nullptr)
         entry->lpa = INVALID_LPA;
-    ssd->indirection_mt_lock.unlock();
+    ssd->log_size += sizeof(log_entry);
+    ssd->log_wp_lock.unlock();
 }
 
 static int bytefs_should_start_log_flush(struct ssd *ssd) {
@@ -1027,139 +1471,285 @@ static inline void try_order_log_flush(struct ssd *ssd) {
 }
 
 
-std::pair<uint64_t, uint64_t> flush_log_region_warmup(struct ssd *ssd, uint64_t tmp_array[64]) {
-    uint64_t lat = 0;
-    ppa ppa;
-    nand_cmd cmd;
-    uint64_t wr_modified = 0;
+/* next_job holds the generation in its upper half and the next index in the lower one */
+#define FLUSH_JOB_GEN_SHIFT     (32)
+#define FLUSH_JOB_IDX_MASK      ((1UL << FLUSH_JOB_GEN_SHIFT) - 1)
 
-    uint64_t read_page_num = 0;
-    uint64_t write_page_num = 0;
+/* take the next index of generation @gen, false once it has none left or a newer one started */
+static bool flush_pool_claim(flush_worker_pool *pool, uint64_t gen, uint64_t njobs, uint64_t *idx) {
+    uint64_t tag = gen << FLUSH_JOB_GEN_SHIFT;
+    uint64_t cur = pool->next_job.load();
+    do {
+        if ((cur & ~FLUSH_JOB_IDX_MASK) != tag || (cur & FLUSH_JOB_IDX_MASK) >= njobs)
+            return false;
+    } while (!pool->next_job.compare_exchange_weak(cur, cur + 1));
+    *idx = cur & FLUSH_JOB_IDX_MASK;
+    return true;
+}
 
-    uint64_t flush_current_time = the_clock_pt->get_time_sim(); 
-    while (!bytefs_should_end_log_flush(ssd)) {
-        if (bytefs_should_start_gc(ssd)) {
-            size_t current_log_size = ssd->log_size.load();
-            bytefs_log("Log flush interrupted by GC w/capacity %10ld/%10ld (%6.2f%%)",
-                current_log_size, ssd->bytefs_log_region_size,
-                100.0 * current_log_size / ssd->bytefs_log_region_size);
-            break;
+static void flush_pool_run(struct ssd *ssd, uint64_t njobs, void (*job)(uint64_t, void *), void *arg) {
+    flush_worker_pool *pool = &ssd->flush_pool;
+    if (ssd->flush_worker_thread_id == nullptr || njobs <= 1) {
+        for (uint64_t i = 0; i < njobs; i++)
+            job(i, arg);
+        return;
+    }
+    bytefs_assert_msg(!pool->running.exchange(true), "flush pool job submitted while another one runs");
+    uint64_t gen;
+    {
+        std::lock_guard<mutex> guard(pool->lock);
+        gen = ++pool->generation;
+        pool->job = job;
+        pool->job_arg = arg;
+        pool->njobs = njobs;
+        pool->finished_jobs = 0;
+        pool->next_job = gen << FLUSH_JOB_GEN_SHIFT;
+    }
+    pool->work_cv.notify_all();
+    uint64_t idx;
+    while (flush_pool_claim(pool, gen, njobs, &idx)) {
+        job(idx, arg);
+        pool->finished_jobs++;
+    }
+    std::unique_lock<mutex> guard(pool->lock);
+    pool->done_cv.wait(guard, [pool, njobs] {
+        return pool->finished_jobs.load() >= njobs && pool->active_workers == 0;
+    });
+    pool->running = false;
+}
+
+void *flush_worker_thread(void *thread_args) {
+    ssd *ssd = &gdev;
+    flush_worker_pool *pool = &ssd->flush_pool;
+    uint64_t seen_generation = 0;
+    while (true) {
+        void (*job)(uint64_t, void *);
+        void *arg;
+        uint64_t njobs;
+        {
+            std::unique_lock<mutex> guard(pool->lock);
+            pool->work_cv.wait(guard, [pool, ssd, seen_generation] {
+                return ssd->terminate_flag || pool->generation != seen_generation;
+            });
+            if (ssd->terminate_flag)
+                break;
+            seen_generation = pool->generation;
+            job = pool->job;
+            arg = pool->job_arg;
+            njobs = pool->njobs;
+            pool->active_workers++;
+        }
+        // only indices of seen_generation are claimed, so finished_jobs counts that job alone
+        uint64_t idx;
+        while (flush_pool_claim(pool, seen_generation, njobs, &idx)) {
+            job(idx, arg);
+            pool->finished_jobs++;
+        }
+        {
+            std::lock_guard<mutex> guard(pool->lock);
+            pool->active_workers--;
         }
+        pool->done_cv.notify_all();
+    }
+    return nullptr;
+}
 
-        // flush_current_time = get_time_ns();
-        const uint64_t current_lpa = advance_log_head(ssd);
-        if (current_lpa == INVALID_LPA)
-            continue;
-        
-        const uint64_t current_lpn = current_lpa / PG_SIZE;
-        uint64_t offset_debug = (current_lpn % PG_SIZE) / 64;
-        bool load_page = false;
-
-        if (dram_subsystem->the_cache.is_hit_nb(current_lpn, flush_current_time)!=0) {
-
-            for (uint64_t bit_idx = 0; bit_idx < PG_SIZE / BYTEFS_LOG_REGION_GRANDULARITY; bit_idx++) {
-                uint64_t coalescing_offset = bit_idx * BYTEFS_LOG_REGION_GRANDULARITY;
-                ssd->indirection_mt_lock.lock();
-                map<uint64_t, uint64_t>::iterator imte =
-                        ssd->indirection_mt.find(current_lpn * PG_SIZE + coalescing_offset);
-                if (imte == ssd->indirection_mt.end()) {
-                    ssd->indirection_mt_lock.unlock();
-                    load_page = true;
-                    break;
-                }
-                log_entry *coalescing_entry = (log_entry *) imte->second;
-                if ((uint64_t) coalescing_entry == INVALID_LPA || coalescing_entry->lpa == INVALID_LPA) {
-                    ssd->indirection_mt_lock.unlock();
-                    load_page = true;
-                    break;
-                }
-                ssd->indirection_mt_lock.unlock();
-            }
+void flush_pool_stop(void) {
+    ssd *ssd = &gdev;
+    {
+        std::lock_guard<mutex> guard(ssd->flush_pool.lock);
+    }
+    ssd->flush_pool.work_cv.notify_all();
+}
+
+/**
+ * gather up to @max distinct pages from the log head on, without consuming
+ * entries; the coalescing of a page invalidates all its entries, so the head
+ * skips them afterwards
+ */
+static uint64_t flush_collect_batch(struct ssd *ssd, flush_batch_ent *batch, uint64_t max) {
+    log_entry *entry = ssd->log_rp;
+    uint64_t nentries = ssd->log_size.load() / sizeof(log_entry);
+    uint64_t nbatch = 0;
+    for (uint64_t scanned = 0; scanned < nentries && nbatch < max; scanned++) {
+        uint64_t lpa = entry->lpa;
+        if (lpa != INVALID_LPA) {
+            uint64_t lpn = lpa / PG_SIZE;
+            bool dup = false;
+            for (uint64_t i = 0; i < nbatch && !dup; i++)
+                dup = batch[i].lpn == lpn;
+            if (!dup)
+                batch[nbatch++].lpn = lpn;
         }
+        entry = entry + 2 > ssd->bytefs_log_region_end ? ssd->bytefs_log_region_start : entry + 1;
+    }
+    return nbatch;
+}
 
-        if (load_page) {
-            flush_current_time = max(flush_current_time, (uint64_t)the_clock_pt->get_time_sim()); 
-            ssd->maptbl_update_mutex.lock();
-            ppa = get_maptbl_ent(ssd, current_lpn);
+static void flush_coalesce_job(uint64_t idx, void *arg) {
+    ssd *ssd = &gdev;
+    flush_batch_ent *ent = &((flush_batch_ent *) arg)[idx];
+    void *buffer = (void *) ((uint64_t) ssd->flush_page_buffer + idx * PG_SIZE);
+    memset(buffer, 0, PG_SIZE);
+    ent->wr_modified = imt_coalesce_page(ssd, ent->lpn, buffer);
+}
+
+/* NAND commands of a batch, split into one job per queue */
+struct nand_batch_run {
+    struct ssd *ssd;
+    nand_batch_cmd *cmds;
+    std::vector<nand_batch_cmd *> order;    // by (ch, lun), batch order within a LUN
+    std::vector<uint64_t> start;            // first command of each job in order, then the end
+};
+
+/* the queue a command waits in; with the detailed model the LUNs of a channel share its bus */
+static inline uint64_t nand_batch_queue(struct ssd *ssd, const ppa *ppa) {
+    if (nand_timing_detailed)
+        return ppa->g.ch;
+    return (uint64_t) ppa->g.ch * ssd->sp.luns_per_ch + ppa->g.lun;
+}
+
+static void nand_batch_job(uint64_t idx, void *arg) {
+    nand_batch_run *run = (nand_batch_run *) arg;
+    for (uint64_t i = run->start[idx]; i < run->start[idx + 1]; i++) {
+        nand_batch_cmd *c = run->order[i];
+        c->lat = ssd_advance_status(run->ssd, &c->addr, &c->cmd);
+    }
+}
+
+/**
+ * Issue @cmds on the flush workers, one job per queue so every LUN timeline
+ * advances in parallel. A queue keeps the batch order of its commands, which
+ * makes the timing independent of the number of workers. Called without
+ * maptbl_update_mutex; the mapping of the pages involved is already updated.
+ */
+void nand_batch_issue(struct ssd *ssd, nand_batch_cmd *cmds, uint64_t ncmds) {
+    if (ncmds == 0)
+        return;
+    nand_batch_run run;
+    run.ssd = ssd;
+    run.cmds = cmds;
+    run.order.resize(ncmds);
+    for (uint64_t i = 0; i < ncmds; i++)
+        run.order[i] = &cmds[i];
+    std::stable_sort(run.order.begin(), run.order.end(), [](const nand_batch_cmd *a, const nand_batch_cmd *b) {
+        if (a->addr.g.ch != b->addr.g.ch)
+            return a->addr.g.ch < b->addr.g.ch;
+        return a->addr.g.lun < b->addr.g.lun;
+    });
+    for (uint64_t i = 0; i < ncmds; i++)
+        if (i == 0 || nand_batch_queue(ssd, &run.order[i]->addr) != nand_batch_queue(ssd, &run.order[i - 1]->addr))
+            run.start.push_back(i);
+    run.start.push_back(ncmds);
+    flush_pool_run(ssd, run.start.size() - 1, nand_batch_job, &run);
+}
+
+/**
+ * Flush one batch of pages from the log head. Pages are coalesced on the
+ * flush workers and remapped under one short mapping lock hold. The NAND
+ * reads of the old copies are then issued per LUN at the batch start time
+ * so each LUN timeline runs in parallel, and every page is programmed once
+ * its own read completed.
+ */
+static void flush_log_batch(struct ssd *ssd, uint64_t *flush_current_time, uint64_t *flush_end_time,
+        uint64_t *read_page_num, uint64_t *write_page_num, uint64_t *wr_hist) {
+    const uint64_t batch_max = FLUSH_BATCH_WLS * ssd->sp.tt_luns;
+    flush_batch_ent *batch = ssd->flush_batch;
+    ppa ppa;
+
+    uint64_t nbatch = flush_collect_batch(ssd, batch, batch_max);
+    if (nbatch == 0) {
+        advance_log_head(ssd);
+        return;
+    }
+
+    uint64_t batch_time = max(*flush_current_time, (uint64_t) the_clock_pt->get_time_sim());
+    for (uint64_t i = 0; i < nbatch; i++) {
+        batch[i].load_page = dram_subsystem->the_cache.is_hit_nb(batch[i].lpn, batch_time) != 0 &&
+                             !imt_page_fully_logged(ssd, batch[i].lpn);
+        batch[i].ready_time = batch_time;
+    }
+
+    // bring pages from the log to the coalescing buffers
+    flush_pool_run(ssd, nbatch, flush_coalesce_job, batch);
+    advance_log_head(ssd);
+
+    std::vector<nand_batch_cmd> reads, writes(nbatch);
+    std::vector<flush_batch_ent *> read_ents;
+    reads.reserve(nbatch);
+    read_ents.reserve(nbatch);
+
+    ssd->maptbl_update_mutex.lock();
+    for (uint64_t i = 0; i < nbatch; i++) {
+        flush_batch_ent *ent = &batch[i];
+        if (ent->load_page) {
+            ppa = get_maptbl_ent(ssd, ent->lpn);
             if (mapped_ppa(&ppa)) {
-                // found, read out first
-                cmd.type = INTERNAL_TRANSFER;
-                cmd.cmd = NAND_READ;
-                cmd.stime = flush_current_time;
-                lat = ssd_advance_status(ssd, &ppa, &cmd);
-                read_page_num++;
-                flush_current_time += lat;
-                // backend_rw(ssd->bd, ppa.realppa, ssd->flush_page_buffer, 0);
                 // update old page information
                 mark_page_invalid(ssd, &ppa);
                 bytefs_try_add_gc_candidate_ppa(ssd, &ppa);
                 set_rmap_ent(ssd, INVALID_LPN, &ppa);
-                SSD_STAT_ADD(log_coalescing_rd_page, 1);
-            } else {
-                memset(ssd->flush_page_buffer, 0, PG_SIZE); 
+                reads.push_back({ppa, {INTERNAL_TRANSFER, NAND_READ, batch_time}, 0});
+                read_ents.push_back(ent);
             }
-            ssd->maptbl_update_mutex.unlock();
-        } else {
-            memset(ssd->flush_page_buffer, 0, PG_SIZE);
         }
+        // the page is written back to a new location
+        int stream = ssd_user_write_stream(ssd, ent->lpn);
+        ppa = get_new_page(ssd, stream);
+        set_maptbl_ent(ssd, ent->lpn, &ppa);
+        set_rmap_ent(ssd, ent->lpn, &ppa);
+        mark_page_valid(ssd, &ppa);
+        ssd_advance_write_pointer(ssd, stream);
+        writes[i].addr = ppa;
+    }
+    ssd->maptbl_update_mutex.unlock();
 
-        // bring page from nand flash to coalescing buffer
-        // try to coalesce all the entries that can be found in current cmt entry
-        wr_modified = 0;
-        
-        ssd->indirection_mt_lock.lock();
-        for (uint64_t bit_idx = 0; bit_idx < PG_SIZE / BYTEFS_LOG_REGION_GRANDULARITY; bit_idx++) {
-            uint64_t coalescing_offset = bit_idx * BYTEFS_LOG_REGION_GRANDULARITY;
-            
-            map<uint64_t, uint64_t>::iterator imte =
-                    ssd->indirection_mt.find(current_lpn * PG_SIZE + coalescing_offset);
-            if (imte == ssd->indirection_mt.end()) {
+    nand_batch_issue(ssd, reads.data(), reads.size());
+    for (uint64_t i = 0; i < reads.size(); i++) {
+        read_ents[i]->ready_time = batch_time + reads[i].lat;
+        (*read_page_num)++;
+        SSD_STAT_ADD(log_coalescing_rd_page, 1);
+    }
 
-                //assert(bit_idx!= offset_debug);
-                continue;
-            }
-            log_entry *coalescing_entry = (log_entry *) imte->second;
-            imte->second = INVALID_LPA;
-            
-            if ((uint64_t) coalescing_entry == INVALID_LPA || coalescing_entry->lpa == INVALID_LPA)
-                continue;
-            assert(coalescing_entry >= ssd->bytefs_log_region_start && coalescing_entry < ssd->bytefs_log_region_end);
-            memcpy((void *) ((uint64_t) ssd->flush_page_buffer + coalescing_offset), 
-                (void *) (coalescing_entry->data), 
-                BYTEFS_LOG_REGION_GRANDULARITY);
-            coalescing_entry->lpa = INVALID_LPA;
-            wr_modified++;
+    uint64_t batch_end_time = batch_time;
+    for (uint64_t i = 0; i < nbatch; i++) {
+        flush_batch_ent *ent = &batch[i];
+        if (ent->wr_modified > 0) {
+            SSD_STAT_ADD(byte_issue_nand_wr_modified_distribution[ent->wr_modified - 1], 1);
+            if (wr_hist)
+                wr_hist[ent->wr_modified - 1]++;
         }
-        ssd->log_rp->lpa = INVALID_LPA;
-        advance_log_head(ssd);
-        ssd->indirection_mt_lock.unlock();
-
-        SSD_STAT_ADD(byte_issue_nand_wr_modified_distribution[wr_modified - 1], 1);
-
-        tmp_array[wr_modified - 1]++;
+        writes[i].cmd.type = INTERNAL_TRANSFER;
+        writes[i].cmd.cmd = NAND_WRITE;
+        writes[i].cmd.stime = ent->ready_time;
+        backend_rw(ssd->bd, writes[i].addr.realppa, (void *) ((uint64_t) ssd->flush_page_buffer + i * PG_SIZE), 1);
+        batch_end_time = max(batch_end_time, ent->ready_time);
+    }
+    nand_batch_issue(ssd, writes.data(), nbatch);
+    *write_page_num += nbatch;
+    SSD_STAT_ADD(log_wr_page, nbatch);
+
+    // the next batch starts once its reads are in, the flush ends with the last program
+    *flush_current_time = batch_end_time;
+    for (uint64_t i = 0; i < nbatch; i++)
+        *flush_end_time = max(*flush_end_time, writes[i].cmd.etime);
+}
 
-        // write the page back
-        flush_current_time = max(flush_current_time, (uint64_t)the_clock_pt->get_time_sim()); 
-        ssd->maptbl_update_mutex.lock();
-        ppa = get_new_page(ssd);
-        set_maptbl_ent(ssd, current_lpn, &ppa);
-        set_rmap_ent(ssd, current_lpn, &ppa);
-        mark_page_valid(ssd, &ppa);
-        ssd_advance_write_pointer(ssd);
+std::pair<uint64_t, uint64_t> flush_log_region_warmup(struct ssd *ssd, uint64_t tmp_array[64]) {
+    uint64_t read_page_num = 0;
+    uint64_t write_page_num = 0;
 
-        // nand_page *pg = &ssd->ch[ppa.g.ch].lun[ppa.g.lun].blk[ppa.g.blk].pg[ppa.g.pg];
-        // std::cout<<"2New page: channel: "<<ppa.g.ch<<", lun: "<<ppa.g.lun<<", blk: "<<ppa.g.blk<<", page: "<<ppa.g.pg<<", status: "<<pg->status<<std::endl;
-        
-        // perform data write
-        cmd.type = INTERNAL_TRANSFER;
-        cmd.cmd = NAND_WRITE;
-        cmd.stime = flush_current_time;
-        ssd_advance_status(ssd, &ppa, &cmd);
-        write_page_num++;
-        ssd->maptbl_update_mutex.unlock();
-        backend_rw(ssd->bd, ppa.realppa, ssd->flush_page_buffer, 1);
-        // operate on remaining part of the log if any
-        SSD_STAT_ADD(log_wr_page, 1);
+    uint64_t flush_current_time = the_clock_pt->get_time_sim(); 
+    uint64_t flush_end_time = flush_current_time;
+    while (!bytefs_should_end_log_flush(ssd)) {
+        if (bytefs_should_start_gc(ssd)) {
+            size_t current_log_size = ssd->log_size.load();
+            bytefs_log("Log flush interrupted by GC w/capacity %10ld/%10ld (%6.2f%%)",
+                current_log_size, ssd->bytefs_log_region_size,
+                100.0 * current_log_size / ssd->bytefs_log_region_size);
+            break;
+        }
+        flush_log_batch(ssd, &flush_current_time, &flush_end_time, &read_page_num, &write_page_num, tmp_array);
     }
     ssd->log_flush_required = 0;
 
@@ -1169,12 +1759,12 @@ std::pair<uint64_t, uint64_t> flush_log_region_warmup(struct ssd *ssd, uint64_t
 
 
 static uint64_t flush_log_region(struct ssd *ssd) {
-    uint64_t lat = 0;
-    ppa ppa;
-    nand_cmd cmd;
-    uint64_t wr_modified = 0;
+    uint64_t read_page_num = 0;
+    uint64_t write_page_num = 0;
 
-    uint64_t flush_current_time = the_clock_pt->get_time_sim(); 
+    uint64_t flush_start_time = the_clock_pt->get_time_sim(); 
+    uint64_t flush_current_time = flush_start_time;
+    uint64_t flush_end_time = flush_start_time;
     while (!bytefs_should_end_log_flush(ssd)) {
         if (bytefs_should_start_gc(ssd)) {
             size_t current_log_size = ssd->log_size.load();
@@ -1183,119 +1773,12 @@ static uint64_t flush_log_region(struct ssd *ssd) {
                 100.0 * current_log_size / ssd->bytefs_log_region_size);
             break;
         }
-
-        // flush_current_time = get_time_ns();
-        const uint64_t current_lpa = advance_log_head(ssd);
-        if (current_lpa == INVALID_LPA)
-            continue;
-        
-        const uint64_t current_lpn = current_lpa / PG_SIZE;
-        uint64_t offset_debug = (current_lpn % PG_SIZE) / 64;
-        bool load_page = false;
-
-        if (dram_subsystem->the_cache.is_hit_nb(current_lpn, flush_current_time)!=0) {
-
-            for (uint64_t bit_idx = 0; bit_idx < PG_SIZE / BYTEFS_LOG_REGION_GRANDULARITY; bit_idx++) {
-                uint64_t coalescing_offset = bit_idx * BYTEFS_LOG_REGION_GRANDULARITY;
-                ssd->indirection_mt_lock.lock();
-                map<uint64_t, uint64_t>::iterator imte =
-                        ssd->indirection_mt.find(current_lpn * PG_SIZE + coalescing_offset);
-                if (imte == ssd->indirection_mt.end()) {
-                    ssd->indirection_mt_lock.unlock();
-                    load_page = true;
-                    break;
-                }
-                log_entry *coalescing_entry = (log_entry *) imte->second;
-                if ((uint64_t) coalescing_entry == INVALID_LPA || coalescing_entry->lpa == INVALID_LPA) {
-                    ssd->indirection_mt_lock.unlock();
-                    load_page = true;
-                    break;
-                }
-                ssd->indirection_mt_lock.unlock();
-            }
-        }
-
-        if (load_page) {
-            flush_current_time = max(flush_current_time, (uint64_t)the_clock_pt->get_time_sim()); 
-            ssd->maptbl_update_mutex.lock();
-            ppa = get_maptbl_ent(ssd, current_lpn);
-            if (mapped_ppa(&ppa)) {
-                // found, read out first
-                cmd.type = INTERNAL_TRANSFER;
-                cmd.cmd = NAND_READ;
-                cmd.stime = flush_current_time;
-                lat = ssd_advance_status(ssd, &ppa, &cmd);
-                flush_current_time += lat;
-                // backend_rw(ssd->bd, ppa.realppa, ssd->flush_page_buffer, 0);
-                // update old page information
-                mark_page_invalid(ssd, &ppa);
-                bytefs_try_add_gc_candidate_ppa(ssd, &ppa);
-                set_rmap_ent(ssd, INVALID_LPN, &ppa);
-                SSD_STAT_ADD(log_coalescing_rd_page, 1);
-            } else {
-                memset(ssd->flush_page_buffer, 0, PG_SIZE); 
-            }
-            ssd->maptbl_update_mutex.unlock();
-        } else {
-            memset(ssd->flush_page_buffer, 0, PG_SIZE);
-        }
-
-        // bring page from nand flash to coalescing buffer
-        // try to coalesce all the entries that can be found in current cmt entry
-        wr_modified = 0;
-        
-        ssd->indirection_mt_lock.lock();
-        for (uint64_t bit_idx = 0; bit_idx < PG_SIZE / BYTEFS_LOG_REGION_GRANDULARITY; bit_idx++) {
-            uint64_t coalescing_offset = bit_idx * BYTEFS_LOG_REGION_GRANDULARITY;
-            
-            map<uint64_t, uint64_t>::iterator imte =
-                    ssd->indirection_mt.find(current_lpn * PG_SIZE + coalescing_offset);
-            if (imte == ssd->indirection_mt.end()) {
-
-                //assert(bit_idx!= offset_debug);
-                continue;
-            }
-            log_entry *coalescing_entry = (log_entry *) imte->second;
-            imte->second = INVALID_LPA;
-            
-            if ((uint64_t) coalescing_entry == INVALID_LPA || coalescing_entry->lpa == INVALID_LPA)
-                continue;
-            assert(coalescing_entry >= ssd->bytefs_log_region_start && coalescing_entry < ssd->bytefs_log_region_end);
-            memcpy((void *) ((uint64_t) ssd->flush_page_buffer + coalescing_offset), 
-                (void *) (coalescing_entry->data), 
-                BYTEFS_LOG_REGION_GRANDULARITY);
-            coalescing_entry->lpa = INVALID_LPA;
-            wr_modified++;
-        }
-        ssd->log_rp->lpa = INVALID_LPA;
-        advance_log_head(ssd);
-        ssd->indirection_mt_lock.unlock();
-
-        SSD_STAT_ADD(byte_issue_nand_wr_modified_distribution[wr_modified - 1], 1);
-        // write the page back
-        flush_current_time = max(flush_current_time, (uint64_t)the_clock_pt->get_time_sim()); 
-        ssd->maptbl_update_mutex.lock();
-        ppa = get_new_page(ssd);
-        set_maptbl_ent(ssd, current_lpn, &ppa);
-        set_rmap_ent(ssd, current_lpn, &ppa);
-        mark_page_valid(ssd, &ppa);
-        ssd_advance_write_pointer(ssd);
-
-        // nand_page *pg = &ssd->ch[ppa.g.ch].lun[ppa.g.lun].blk[ppa.g.blk].pg[ppa.g.pg];
-        // std::cout<<"2New page: channel: "<<ppa.g.ch<<", lun: "<<ppa.g.lun<<", blk: "<<ppa.g.blk<<", page: "<<ppa.g.pg<<", status: "<<pg->status<<std::endl;
-        
-        // perform data write
-        cmd.type = INTERNAL_TRANSFER;
-        cmd.cmd = NAND_WRITE;
-        cmd.stime = flush_current_time;
-        ssd_advance_status(ssd, &ppa, &cmd);
-        ssd->maptbl_update_mutex.unlock();
-        backend_rw(ssd->bd, ppa.realppa, ssd->flush_page_buffer, 1);
-        // operate on remaining part of the log if any
-        SSD_STAT_ADD(log_wr_page, 1);
+        flush_log_batch(ssd, &flush_current_time, &flush_end_time, &read_page_num, &write_page_num, nullptr);
     }
     ssd->log_flush_required = 0;
-    return lat;
+    flush_end_time = max(flush_end_time, flush_current_time);
+    ssd_stat_record_lat(LAT_LOG_FLUSH, flush_end_time - flush_start_time);
+    return flush_end_time - flush_start_time;
 }
 
 
@@ -1406,7 +1889,8 @@ static inline uint64_t write_data(struct ssd *ssd, uint64_t lpa, uint64_t size,
 //     return maxlat;
 // }
 
-static inline uint64_t single_block_write(struct ssd *ssd, uint64_t lpn, void *buf, uint64_t stime) {
+/* @stream: WS_USER (classified by temperature) or WS_DEMOTION */
+static inline uint64_t single_block_write(struct ssd *ssd, uint64_t lpn, void *buf, uint64_t stime, int stream) {
     uint64_t curlat = 0, maxlat = 0;
     ppa ppa;
     nand_cmd swr;
@@ -1420,7 +1904,9 @@ static inline uint64_t single_block_write(struct ssd *ssd, uint64_t lpn, void *b
     }
 
     /* new write */
-    ppa = get_new_page(ssd);
+    if (stream == WS_USER)
+        stream = ssd_user_write_stream(ssd, lpn);
+    ppa = get_new_page(ssd, stream);
 
     // bytefs_log("write request: lpn=%lu, ppa=%lu ", lpn, ppa.realppa);
     /* update maptbl */
@@ -1433,7 +1919,7 @@ static inline uint64_t single_block_write(struct ssd *ssd, uint64_t lpn, void *b
     mark_page_valid(ssd, &ppa);
 
     /* need to advance the write pointer here */
-    ssd_advance_write_pointer(ssd);
+    ssd_advance_write_pointer(ssd, stream);
 
     // nand_page *pg = &ssd->ch[ppa.g.ch].lun[ppa.g.lun].blk[ppa.g.blk].pg[ppa.g.pg];
     // std::cout<<"1New page: channel: "<<ppa.g.ch<<", lun: "<<ppa.g.lun<<", blk: "<<ppa.g.blk<<", page: "<<ppa.g.pg<<", status: "<<pg->status<<std::endl;
@@ -1540,6 +2026,7 @@ void *ftl_thread(void* arg) {
     the_clock_pt->wait_without_events(ThreadType::Ftl_thread, 0);
 
     while (*terminate_flag == 0) {
+        interval_stat_tick(the_clock_pt->get_time_sim());
         // if flush is ordered, do the flush immediately
         if (ssd->log_flush_required) {
             num_log_flush++;
@@ -1587,6 +2074,9 @@ void *ftl_thread(void* arg) {
                 100.0 * ssd->total_free_blks / ssd->sp.blks_per_ch * ssd->sp.nchs,
                 (gc_end_time - gc_start_time / 1e6));
 #endif
+        } else if (!ssd->log_flush_required && bytefs_should_start_bg_gc(ssd, the_clock_pt->get_time_sim())) {
+            // reclaim one victim while the flash is idle, ahead of foreground GC
+            bytefs_gc_background(ssd);
         }
         // sched_yield();
     }
@@ -1705,8 +2195,7 @@ int ssd_init() {
     bytefs_log("Init para");
     
     /* initialize ssd internal layout architecture */
-    ssd->ch = (ssd_channel *) malloc(sizeof(ssd_channel) * spp->nchs);
-    memset(ssd->ch, 0, sizeof(ssd_channel) * spp->nchs);
+    ssd->ch = new ssd_channel[spp->nchs]();
     /* 512 KB to emulate SSD storage hierarchy will be allocated besides the 6GB emulation */
     for (i = 0; i < spp->nchs; i++) {
         ssd_init_ch(&ssd->ch[i], spp);
@@ -1749,12 +2238,18 @@ int ssd_init() {
     ssd->polling_thread_id = nullptr;
     ssd->log_writer_thread_id = nullptr;
     ssd->promotion_thread_id = nullptr;
+    ssd->flush_worker_thread_id = nullptr;
+    ssd->n_log_writer_threads = log_writer_threads;
+    ssd->n_flush_threads = flush_threads;
     ssd->log_flush_required = 0;
 
     /*initialize DRAM subsystem*/
     long cache_size = write_log_enable ? (long)(ssd_cache_size_byte*(1-write_log_ratio)) : ssd_cache_size_byte;
     int64_t host_way = astriflash_enable ? 8 : (host_dram_size_byte / 4096) / 8;
-    dram_subsystem = new cache_controller(cache_size, ssd_cache_way, 7, 10000, host_dram_size_byte, host_way);
+    dram_subsystem = new cache_controller(cache_size, ssd_cache_way, 7, 10000, host_dram_size_byte, host_way,
+                                          ssd_cache_policy, host_dram_policy);
+    dram_subsystem->fills.init(ssd->sp.nchs, ssd_fill_per_channel);
+    cxl_link_init();
 
     ssd->terminate_flag = 0;
     error = bytefs_start_threads();
@@ -1772,7 +2267,7 @@ int ssd_reset_skybyte(){
 
 
     bytefs_assert(ssd);
-    free(ssd->ch);
+    delete[] ssd->ch;
     free(ssd->sb);
     free(dummy_buffer);
     delete dram_subsystem;
@@ -1783,8 +2278,7 @@ int ssd_reset_skybyte(){
     bytefs_log("Init para");
     
     /* initialize ssd internal layout architecture */
-    ssd->ch = (ssd_channel *) malloc(sizeof(ssd_channel) * spp->nchs);
-    memset(ssd->ch, 0, sizeof(ssd_channel) * spp->nchs);
+    ssd->ch = new ssd_channel[spp->nchs]();
     /* 512 KB to emulate SSD storage hierarchy will be allocated besides the 6GB emulation */
     for (i = 0; i < spp->nchs; i++) {
         ssd_init_ch(&ssd->ch[i], spp);
@@ -1827,12 +2321,18 @@ int ssd_reset_skybyte(){
     ssd->polling_thread_id = nullptr;
     ssd->log_writer_thread_id = nullptr;
     ssd->promotion_thread_id = nullptr;
+    ssd->flush_worker_thread_id = nullptr;
+    ssd->n_log_writer_threads = log_writer_threads;
+    ssd->n_flush_threads = flush_threads;
     ssd->log_flush_required = 0;
 
     /*initialize DRAM subsystem*/
     long cache_size = write_log_enable ? (long)(ssd_cache_size_byte*(1-write_log_ratio)) : ssd_cache_size_byte;
     int64_t host_way = astriflash_enable ? 8 : (host_dram_size_byte / 4096) / 8;
-    dram_subsystem = new cache_controller(cache_size, ssd_cache_way, 7, 10000, host_dram_size_byte, host_way);
+    dram_subsystem = new cache_controller(cache_size, ssd_cache_way, 7, 10000, host_dram_size_byte, host_way,
+                                          ssd_cache_policy, host_dram_policy);
+    dram_subsystem->fills.init(ssd->sp.nchs, ssd_fill_per_channel);
+    cxl_link_init();
 
     ssd->terminate_flag = 0;
     error = bytefs_start_threads();
@@ -1869,6 +2369,9 @@ int ssd_reset(void) {
                 ssd->ch[i].lun[j].next_lun_avail_time = 0;
                 ssd->ch[i].lun[j].next_log_flush_lun_avail_time = 0;
                 ssd->ch[i].lun[j].this_lun_avail_time = 0;
+                memset(&ssd->ch[i].lun[j].die, 0, sizeof(ssd->ch[i].lun[j].die));
+                ssd->ch[i].lun[j].sched_len = 0;
+                ssd->ch[i].lun[j].sched_busy_end = 0;
                 ssd->ch[i].lun[j].busy = false;
         }
         ssd->ch[i].next_ch_avail_time = 0;
@@ -1879,6 +2382,7 @@ int ssd_reset(void) {
     // for (i = 0; i < spp->tt_pgs; i++) {
     //     ssd->maptbl[i].realppa = UNMAPPED_PPA;
     // }
+    ssd->maptbl.clear();
     for (i = 0; i < spp->tt_pgs; i++) {
         ssd->rmap[i] = INVALID_LPN;
     }
@@ -2002,7 +2506,7 @@ void *promotion_thread(void *thread_args) {
                 if (!write_log_enable)
                 {
                     //uint64_t start_time = get_time_ns();
-                    single_block_write(ssd, mig.pm_index, dummy_buffer, the_clock_pt->get_time_sim());  
+                    single_block_write(ssd, mig.pm_index, dummy_buffer, the_clock_pt->get_time_sim(), WS_DEMOTION);  
                     //int64_t diff_time = get_time_ns() - start_time;
                     //printf("%ld\n", diff_time);
                 }
@@ -2021,7 +2525,7 @@ void *promotion_thread(void *thread_args) {
                 }
             }
             
-            dram_subsystem->host_dram.insert(mig.pm_index);
+            dram_subsystem->host_dram.insert(mig.pm_index, false);
             //printf("@@@Promoted page addr: %lx to host DRAM!\n", mig.pm_index * 4096);
             //dram_subsystem->host_dram.cache_evict_mutex.unlock();
 
@@ -2189,7 +2693,7 @@ int byte_issue(int is_write, uint64_t lpa, uint64_t size, issue_response *resp)
         
         if (is_simulator_not_emulator)
         {
-            latency = 46;
+            latency = HOST_DRAM_ACCESS_LATENCY;
         }
         else
         {
@@ -2220,7 +2724,7 @@ int byte_issue(int is_write, uint64_t lpa, uint64_t size, issue_response *resp)
             //endtime = get_time_ns();  
             if (is_simulator_not_emulator)
             {
-                latency = 46 + 40; //DRAM + CXL
+                latency = SSD_DRAM_ACCESS_LATENCY + cxl_flat_latency();
             }else
             {
                 latency = (endtime - stime); 
@@ -2236,7 +2740,9 @@ int byte_issue(int is_write, uint64_t lpa, uint64_t size, issue_response *resp)
             //Access SSD cache
             //std::cout<<"2"<<std::endl;
             dram_subsystem->the_cache.hold_keep_lock(page_index);
-            if (dram_subsystem->the_cache.is_hit_nb(page_index, stime)==0)
+            // 0 hit, -1 miss, else the ns until the page's fill completes
+            int64_t cache_state = dram_subsystem->the_cache.is_hit_nb(page_index, stime);
+            if (cache_state == 0)
             { 
                 
                 SSD_STAT_ATOMIC_INC(hostandssdDram_hit_num);
@@ -2314,7 +2820,7 @@ int byte_issue(int is_write, uint64_t lpa, uint64_t size, issue_response *resp)
 
                 if (is_simulator_not_emulator)
                 {
-                    latency = 46 + 40 + 72; // DRAM + CXL + Indexing
+                    latency = SSD_DRAM_ACCESS_LATENCY + cxl_flat_latency() + SSD_CACHE_INDEX_LATENCY;
                 }
                 else
                 {
@@ -2348,7 +2854,7 @@ int byte_issue(int is_write, uint64_t lpa, uint64_t size, issue_response *resp)
                 //endtime = get_time_ns(); 
                 if (is_simulator_not_emulator)
                 {
-                    latency = 46 + 40 + 72; // DRAM + CXL + Indexing
+                    latency = SSD_DRAM_ACCESS_LATENCY + cxl_flat_latency() + SSD_CACHE_INDEX_LATENCY;
                 }
                 else
                 {
@@ -2359,12 +2865,13 @@ int byte_issue(int is_write, uint64_t lpa, uint64_t size, issue_response *resp)
                 resp->flag = WRITE_LOG_R;
 
             }
-            else if (dram_subsystem->the_cache.is_hit_nb(page_index, stime)>0)
+            else if (cache_state > 0)
             {
                 //Hit in the MSHR
                 bool context_siwtch = false;
 
-                flash_latency = dram_subsystem->the_cache.is_hit_nb(page_index, stime);
+                flash_latency = cache_state;
+                SSD_STAT_ATOMIC_INC(fill_merged);
 
 
                 //std::cout<<"Byte_Issue Time: "<<flash_latency<<std::endl;
@@ -2392,7 +2899,7 @@ int byte_issue(int is_write, uint64_t lpa, uint64_t size, issue_response *resp)
                 //endtime = get_time_ns(); 
                 if (is_simulator_not_emulator)
                 {
-                    latency = context_siwtch ? 46 + 40 + 72 : flash_latency + 46 + 40 + 72;
+                    latency = (context_siwtch ? 0 : flash_latency) + SSD_DRAM_ACCESS_LATENCY + cxl_flat_latency() + SSD_CACHE_INDEX_LATENCY;
                 }
                 else
                 {
@@ -2410,6 +2917,8 @@ int byte_issue(int is_write, uint64_t lpa, uint64_t size, issue_response *resp)
                 //print_flag = true;
 
                 eviction evi = dram_subsystem->the_cache.miss_evict(page_index);
+                if (evi.condition != 0)
+                    ssd_prefetch_evicted(evi.index);
 
                 // if (print_page_locality && (evi.condition!=0))  //baseline only
                 // {
@@ -2418,12 +2927,25 @@ int byte_issue(int is_write, uint64_t lpa, uint64_t size, issue_response *resp)
                 //     m_screen.unlock();
                 // }
 
-                flash_latency = read_data(ssd, lpa, size, dummy_buffer, stime);
+                // the page may have been evicted while its NAND read is still outstanding
+                uint64_t fill_done = dram_subsystem->fills.lookup(page_index, stime);
+                if (fill_done != 0)
+                {
+                    flash_latency = fill_done - stime;
+                    SSD_STAT_ATOMIC_INC(fill_merged);
+                }
+                else
+                {
+                    ppa fill_ppa = get_maptbl_ent(ssd, page_index);
+                    fill_done = dram_subsystem->fills.fill(page_index, fill_ppa.g.ch, stime,
+                            [&](uint64_t start) { return read_data(ssd, lpa, size, dummy_buffer, start); });
+                    flash_latency = fill_done - stime;
+                }
 
                 if (!write_log_enable && (evi.condition!=0))
                 {
                    //uint64_t start_time = get_time_ns();
-                   single_block_write(ssd, evi.index, dummy_buffer, stime);
+                   single_block_write(ssd, evi.index, dummy_buffer, stime, WS_USER);
                    //uint64_t diff_time = get_time_ns() - start_time;
                    //printf("%ld\n", diff_time);
                 }
@@ -2524,7 +3046,7 @@ int byte_issue(int is_write, uint64_t lpa, uint64_t size, issue_response *resp)
                 //endtime = get_time_ns(); 
                 if (is_simulator_not_emulator)
                 {
-                    latency = context_siwtch ? 46 + 40 + 72 : flash_latency + 46 + 40 + 72;
+                    latency = (context_siwtch ? 0 : flash_latency) + SSD_DRAM_ACCESS_LATENCY + cxl_flat_latency() + SSD_CACHE_INDEX_LATENCY;
                 }
                 else
                 {
@@ -2548,16 +3070,58 @@ int byte_issue(int is_write, uint64_t lpa, uint64_t size, issue_response *resp)
     
     // latency -= (endtime - stime);
     resp->latency = latency;
+    ssd_stat_record_issue(resp);
     return 0;
 }
 
+/* the SSD cache miss path of byte_issue() without a demand access */
+bool ssd_prefetch_page(int64_t page_index, uint64_t stime) {
+    ssd *ssd = &gdev;
+
+    ppa ppa = get_maptbl_ent(ssd, page_index);
+    if (!mapped_ppa(&ppa))
+        return false;
+    if (promotion_enable || tpp_enable) {
+        dram_subsystem->host_dram.hold_keep_lock(page_index);
+        bool in_host = dram_subsystem->host_dram.is_hit(page_index);
+        dram_subsystem->host_dram.free_keep_lock(page_index);
+        if (in_host)
+            return false;
+    }
+
+    dram_subsystem->the_cache.hold_keep_lock(page_index);
+    if (dram_subsystem->the_cache.is_hit_nb(page_index, stime) != -1) {
+        dram_subsystem->the_cache.free_keep_lock(page_index);
+        return false;
+    }
+    eviction evi = dram_subsystem->the_cache.miss_evict(page_index);
+    if (evi.condition != 0)
+        ssd_prefetch_evicted(evi.index);
+    uint64_t fill_done = dram_subsystem->fills.lookup(page_index, stime);
+    if (fill_done == 0)
+        fill_done = dram_subsystem->fills.fill(page_index, ppa.g.ch, stime,
+                [&](uint64_t start) { return read_data(ssd, page_index * PG_SIZE, PG_SIZE, dummy_buffer, start); });
+    if (!write_log_enable && evi.condition != 0)
+        single_block_write(ssd, evi.index, dummy_buffer, stime, WS_USER);
+    dram_subsystem->the_cache.insert_nb(page_index, fill_done, false, false);
+    dram_subsystem->the_cache.free_keep_lock(page_index);
+    return true;
+}
+
 void bytefs_fill_data(uint64_t addr) {
     ssd *ssd = &gdev;
     ppa ppa;
     uint64_t current_lpn = addr / PG_SIZE;
 
-    for (uint64_t offset = 0; offset < PG_SIZE; offset += BYTEFS_LOG_REGION_GRANDULARITY) {
-        ssd->indirection_mt[current_lpn * PG_SIZE + offset] = INVALID_LPA;
+    imt_page *imtp = imt_lookup(ssd, current_lpn);
+    if (imtp == nullptr) {
+        imtp = (imt_page *) malloc(sizeof(imt_page));
+        bytefs_assert(imtp);
+        ssd->indirection_mt.set(current_lpn, (uint64_t) imtp);
+        ssd->imt_npages++;
+    }
+    for (uint64_t bit_idx = 0; bit_idx < IMT_SLOTS_PER_PAGE; bit_idx++) {
+        imtp->slot[bit_idx].store(nullptr, std::memory_order_relaxed);
     }
 
     if (tpp_enable)
@@ -2576,11 +3140,11 @@ void bytefs_fill_data(uint64_t addr) {
     ppa = get_maptbl_ent(ssd, current_lpn);
     if (mapped_ppa(&ppa))
         return;
-    ppa = get_new_page(ssd);
+    ppa = get_new_page(ssd, WS_USER);
     set_maptbl_ent(ssd, current_lpn, &ppa);
     set_rmap_ent(ssd, current_lpn, &ppa);
     mark_page_valid(ssd, &ppa);
-    ssd_advance_write_pointer(ssd);
+    ssd_advance_write_pointer(ssd, WS_USER);
 
     // nand_page *pg = &ssd->ch[ppa.g.ch].lun[ppa.g.lun].blk[ppa.g.blk].pg[ppa.g.pg];
     // std::cout<<"3New page: channel: "<<ppa.g.ch<<", lun: "<<ppa.g.lun<<", blk: "<<ppa.g.blk<<", page: "<<ppa.g.pg<<", status: "<<pg->status<<std::endl;
@@ -2598,7 +3162,7 @@ bool backend_prefill_data(uint64_t addr) {
     {
         void *dummy_buffer;
         dummy_buffer = malloc(PG_SIZE);
-        single_block_write(ssd, current_lpn, dummy_buffer, 0);
+        single_block_write(ssd, current_lpn, dummy_buffer, 0, WS_USER);
         free(dummy_buffer);
         return false;
     }
@@ -2644,62 +3208,668 @@ int64_t get_hostdram_accessed_marked_page_num(){
 }
 
 
-void copy_dram_system(FILE* output_file){
-    dram_subsystem->snapshot(output_file);
+void copy_dram_system(snapshot_writer* w){
+    dram_subsystem->snapshot(w);
+}
+
+void replay_dram_system(snapshot_file* s){
+    dram_subsystem->replay_snapshot(s);
 }
 
-void replay_dram_system(FILE* input_file){
-    dram_subsystem->replay_snapshot(input_file);
+bool dram_system_from_text(FILE* input_file, snapshot_writer* w){
+    return cache_controller::snapshot_from_text(input_file, w);
 }
 
 
-void copy_tpp_system(FILE* output_file){
-    fprintf(output_file, "%ld\n", LRU_inactive_list.size());
-    for (const auto &element : LRU_inactive_list) {
-        fprintf(output_file, "%ld\n", static_cast<long>(element));  // %llu for printing uint64_t
+void copy_tpp_system(snapshot_writer* w){
+    snapshot_add(w, SNAP_TPP_INACTIVE, std::vector<uint64_t>(LRU_inactive_list.begin(), LRU_inactive_list.end()));
+    // tail first, replay pushes to the front
+    snapshot_add(w, SNAP_TPP_ACTIVE, std::vector<uint64_t>(LRU_active_list.rbegin(), LRU_active_list.rend()));
+    snapshot_add(w, SNAP_TPP_NUMA_SCAN, std::vector<uint64_t>(NUMA_scan_set.begin(), NUMA_scan_set.end()));
+}
+
+void replay_tpp_system(snapshot_file* s){
+    uint64_t inactive_size, active_size, numa_size;
+    const uint64_t *inactive = snapshot_section_data(s, SNAP_TPP_INACTIVE, &inactive_size);
+    const uint64_t *active = snapshot_section_data(s, SNAP_TPP_ACTIVE, &active_size);
+    const uint64_t *numa = snapshot_section_data(s, SNAP_TPP_NUMA_SCAN, &numa_size);
+    bytefs_assert_msg(inactive && active && numa, "snapshot has no TPP lists");
+
+    // sorted on write, so every insert lands at the end
+    LRU_inactive_list.clear();
+    LRU_inactive_list.insert(inactive, inactive + inactive_size);
+    LRU_active_list.assign(std::reverse_iterator<const uint64_t *>(active + active_size),
+                           std::reverse_iterator<const uint64_t *>(active));
+    NUMA_scan_set.clear();
+    NUMA_scan_set.insert(numa, numa + numa_size);
+    NUMA_scan_threshold_ns = 2000000000;
+}
+
+// converts the text dump older versions wrote: each list is its size followed by the entries
+bool tpp_system_from_text(FILE* input_file, snapshot_writer* w){
+    const uint32_t ids[] = {SNAP_TPP_INACTIVE, SNAP_TPP_ACTIVE, SNAP_TPP_NUMA_SCAN};
+    for (uint32_t id : ids) {
+        std::vector<uint64_t> size, list;
+        if (!snapshot_read_text(input_file, size, 1) || !snapshot_read_text(input_file, list, size[0]))
+            return false;
+        snapshot_add(w, id, std::move(list));
     }
-    int64_t active_size = LRU_active_list.size();
-    fprintf(output_file, "%ld\n", active_size);
-    for (int64_t i = 0; i < active_size; i++)
-    {
-        fprintf(output_file, "%ld\n", LRU_active_list.back());
-        LRU_active_list.pop_back();
+    return true;
+}
+
+
+/*
+ * Post-warmup checkpoint: everything the measured run starts from after the
+ * prefill, the DRAM subsystem replay and the write log warmup, so runs of one
+ * workload whose configs agree on warmup_checkpoint_key() fork from a single
+ * warmup. NAND state is written sparsely, only what differs from a freshly
+ * initialized SSD, and restored into one.
+ */
+#define WARMUP_CHECKPOINT_VERSION   (3)
+
+/* bounds checked reader over a checkpoint section */
+struct ckpt_cursor {
+    const uint64_t *data;
+    uint64_t len;
+    uint64_t pos;
+    bool ok;
+
+    ckpt_cursor(const uint64_t *d, uint64_t l) : data(d), len(l), pos(0), ok(d != nullptr) {}
+
+    uint64_t get() {
+        if (!ok || pos >= len) {
+            ok = false;
+            return 0;
+        }
+        return data[pos++];
+    }
+
+    void raw(void *p, size_t bytes) {
+        uint64_t words = (bytes + 7) / 8;
+        if (!ok || len - pos < words) {
+            ok = false;
+            return;
+        }
+        memcpy(p, data + pos, bytes);
+        pos += words;
+    }
+
+    void skip(uint64_t words) {
+        if (!ok || len - pos < words) {
+            ok = false;
+            return;
+        }
+        pos += words;
     }
-    fprintf(output_file, "%ld\n", NUMA_scan_set.size());
-    for (const auto &element : NUMA_scan_set) {
-        fprintf(output_file, "%ld\n", static_cast<long>(element));  // %llu for printing uint64_t
+
+    bool done() const {
+        return ok && pos == len;
     }
+};
+
+static inline uint64_t ckpt_pack(int hi, int lo) {
+    return ((uint64_t)(uint32_t) hi << 32) | (uint32_t) lo;
 }
 
-void replay_tpp_system(FILE* input_file){
-    LRU_active_list.clear();
-    LRU_inactive_list.clear();
-    NUMA_scan_set.clear();
-    int64_t inactive_size;
-    assert(fscanf(input_file, "%ld\n", &inactive_size));
-    for (int64_t i = 0; i < inactive_size; i++)
-    {
-        int64_t element;
-        assert(fscanf(input_file, "%ld\n", &element));
-        LRU_inactive_list.insert(element);
+static inline int ckpt_hi(uint64_t w) {
+    return (int)(w >> 32);
+}
+
+static inline int ckpt_lo(uint64_t w) {
+    return (int)(uint32_t) w;
+}
+
+static void ckpt_put_raw(std::vector<uint64_t> &out, const void *p, size_t bytes) {
+    size_t at = out.size();
+    out.resize(at + (bytes + 7) / 8, 0);
+    memcpy(&out[at], p, bytes);
+}
+
+uint64_t warmup_checkpoint_key(void) {
+    uint64_t ratio_bits;
+    memcpy(&ratio_bits, &write_log_ratio, sizeof(ratio_bits));
+    const uint64_t cfg[] = {
+        WARMUP_CHECKPOINT_VERSION, CH_COUNT, WAY_COUNT, BLOCK_COUNT, PG_COUNT, PG_SIZE,
+        NAND_PLANES_PER_LUN, (uint64_t) n_type,
+        (uint64_t) ssd_cache_size_byte, (uint64_t) ssd_cache_way, ssd_cache_policy, (uint64_t) ssd_fill_per_channel,
+        (uint64_t) host_dram_size_byte, host_dram_policy,
+        write_log_enable, ratio_bits, promotion_enable, tpp_enable, astriflash_enable,
+        multi_stream_enable, temperature_classify,
+        nand_timing_detailed, nand_suspend_enable, nand_cache_ops, nand_sched_policy, nand_sched_max_delay,
+        gc_policy, (uint64_t) gc_fg_threshold, (uint64_t) gc_bg_threshold,
+        // layouts stored raw or counted by the restore
+        sizeof(ssdparams), sizeof(ssd_stat), sizeof(nand_die_timing), sizeof(nand_sched_op),
+        NAND_SCHED_QUEUE_MAX, sizeof(log_entry), IMT_SLOTS_PER_PAGE, NR_WRITE_STREAMS, TEMP_TABLE_SIZE,
+        NR_LAT_CLASSES, LAT_HIST_BUCKETS,
+    };
+    // FNV-1a
+    uint64_t key = 0xcbf29ce484222325UL;
+    const uint8_t *p = (const uint8_t *) cfg;
+    for (size_t i = 0; i < sizeof(cfg); i++)
+        key = (key ^ p[i]) * 0x100000001b3UL;
+    return key;
+}
+
+static void checkpoint_nand(ssd *ssd, std::vector<uint64_t> &out) {
+    ssdparams *spp = &ssd->sp;
+    size_t at;
+
+    // non-free pages and the reverse map: realppa << 2 | status, lpn
+    at = out.size();
+    out.push_back(0);
+    uint64_t p = 0;     // realppa, ch major as in ppa2pgidx
+    for (int ch = 0; ch < spp->nchs; ch++) {
+        for (int lun = 0; lun < spp->luns_per_ch; lun++) {
+            for (int b = 0; b < spp->blks_per_lun; b++) {
+                nand_block *blk = &ssd->ch[ch].lun[lun].blk[b];
+                for (int pg = 0; pg < spp->pgs_per_blk; pg++, p++) {
+                    if (blk->pg[pg].status == PG_FREE && ssd->rmap[p] == INVALID_LPN)
+                        continue;
+                    out.push_back(p << 2 | blk->pg[pg].status);
+                    out.push_back(ssd->rmap[p]);
+                    out[at]++;
+                }
+            }
+        }
     }
-    int64_t active_size;
-    assert(fscanf(input_file, "%ld\n", &active_size));
-    for (int64_t i = 0; i < active_size; i++)
-    {
-        int64_t element;
-        assert(fscanf(input_file, "%ld\n", &element));
-        LRU_active_list.push_front(element);
+
+    // blocks that left their initial state
+    at = out.size();
+    out.push_back(0);
+    for (int ch = 0; ch < spp->nchs; ch++) {
+        for (int lun = 0; lun < spp->luns_per_ch; lun++) {
+            for (int b = 0; b < spp->blks_per_lun; b++) {
+                nand_block *blk = &ssd->ch[ch].lun[lun].blk[b];
+                if (!blk->wp && !blk->ipc && !blk->vpc && !blk->erase_cnt &&
+                    !blk->last_write_seq && !blk->is_candidate)
+                    continue;
+                out.push_back(((uint64_t) ch * spp->luns_per_ch + lun) * spp->blks_per_lun + b);
+                out.push_back(ckpt_pack(blk->wp, blk->ipc));
+                out.push_back(ckpt_pack(blk->vpc, blk->erase_cnt));
+                out.push_back(blk->last_write_seq);
+                out.push_back(blk->is_candidate);
+                out[at]++;
+            }
+        }
     }
-    int64_t numa_size;
-    assert(fscanf(input_file, "%ld\n", &numa_size));
-    for (int64_t i = 0; i < numa_size; i++)
-    {
-        int64_t element;
-        assert(fscanf(input_file, "%ld\n", &element));
-        NUMA_scan_set.insert(element);
+
+    // every superblock, then its write lines that left their initial state
+    for (int s = 0; s < spp->sb_per_ssd; s++) {
+        ssd_superblock *sb = &ssd->sb[s];
+        out.push_back(ckpt_pack(sb->line_wp, sb->ipc));
+        out.push_back(ckpt_pack(sb->vpc, sb->erase_cnt));
+        out.push_back(sb->last_write_seq);
+        out.push_back(ckpt_pack(sb->is_open, sb->is_candidate));
+        at = out.size();
+        out.push_back(0);
+        for (int w = 0; w < sb->nwls; w++) {
+            writeline *wl = &sb->wtl[w];
+            if (!wl->wp && !wl->ipc && !wl->vpc && !wl->erase_cnt)
+                continue;
+            out.push_back(w);
+            out.push_back(ckpt_pack(wl->wp, wl->erase_cnt));
+            out.push_back(ckpt_pack(wl->ipc, wl->vpc));
+            out[at]++;
+        }
     }
-    NUMA_scan_threshold_ns = 2000000000;
+
+    // LUN and channel timelines
+    for (int ch = 0; ch < spp->nchs; ch++) {
+        for (int l = 0; l < spp->luns_per_ch; l++) {
+            nand_lun *lun = &ssd->ch[ch].lun[l];
+            out.push_back(lun->next_lun_avail_time);
+            out.push_back(lun->next_log_flush_lun_avail_time);
+            out.push_back(lun->this_lun_avail_time);
+            ckpt_put_raw(out, &lun->die, sizeof(lun->die));
+            ckpt_put_raw(out, lun->sched_q, sizeof(lun->sched_q));
+            out.push_back(lun->sched_len);
+            out.push_back(lun->sched_busy_end);
+            out.push_back(lun->busy);
+            out.push_back(lun->nrd);
+            out.push_back(lun->nwr);
+            out.push_back(lun->total_channel_latency);
+        }
+        out.push_back(ssd->ch[ch].next_ch_avail_time);
+        out.push_back(ssd->ch[ch].busy);
+    }
+}
+
+static bool restore_nand(ssd *ssd, ckpt_cursor &c) {
+    ssdparams *spp = &ssd->sp;
+
+    uint64_t npages = c.get();
+    for (uint64_t i = 0; i < npages && c.ok; i++) {
+        uint64_t ent = c.get();
+        uint64_t lpn = c.get();
+        ppa ppa;
+        ppa.realppa = ent >> 2;
+        if (ppa.realppa >= (uint64_t) spp->tt_pgs)
+            return false;
+        pgidx2ppa(ssd, &ppa);
+        ssd->ch[ppa.g.ch].lun[ppa.g.lun].blk[ppa.g.blk].pg[ppa.g.pg].status = ent & 3;
+        ssd->rmap[ppa.realppa] = lpn;
+    }
+
+    uint64_t nblks = c.get();
+    for (uint64_t i = 0; i < nblks && c.ok; i++) {
+        uint64_t idx = c.get();
+        if (idx >= (uint64_t) spp->tt_blks)
+            return false;
+        nand_block *blk = &ssd->ch[idx / spp->blks_per_ch].lun[idx / spp->blks_per_lun % spp->luns_per_ch]
+                               .blk[idx % spp->blks_per_lun];
+        uint64_t w = c.get();
+        blk->wp = ckpt_hi(w);
+        blk->ipc = ckpt_lo(w);
+        w = c.get();
+        blk->vpc = ckpt_hi(w);
+        blk->erase_cnt = ckpt_lo(w);
+        blk->last_write_seq = c.get();
+        blk->is_candidate = c.get();
+    }
+
+    for (int s = 0; s < spp->sb_per_ssd && c.ok; s++) {
+        ssd_superblock *sb = &ssd->sb[s];
+        uint64_t w = c.get();
+        sb->line_wp = ckpt_hi(w);
+        sb->ipc = ckpt_lo(w);
+        w = c.get();
+        sb->vpc = ckpt_hi(w);
+        sb->erase_cnt = ckpt_lo(w);
+        sb->last_write_seq = c.get();
+        w = c.get();
+        sb->is_open = ckpt_hi(w);
+        sb->is_candidate = ckpt_lo(w);
+        uint64_t nwls = c.get();
+        for (uint64_t i = 0; i < nwls && c.ok; i++) {
+            uint64_t idx = c.get();
+            if (idx >= (uint64_t) sb->nwls)
+                return false;
+            writeline *wl = &sb->wtl[idx];
+            w = c.get();
+            wl->wp = ckpt_hi(w);
+            wl->erase_cnt = ckpt_lo(w);
+            w = c.get();
+            wl->ipc = ckpt_hi(w);
+            wl->vpc = ckpt_lo(w);
+        }
+    }
+
+    for (int ch = 0; ch < spp->nchs && c.ok; ch++) {
+        for (int l = 0; l < spp->luns_per_ch; l++) {
+            nand_lun *lun = &ssd->ch[ch].lun[l];
+            lun->next_lun_avail_time = c.get();
+            lun->next_log_flush_lun_avail_time = c.get();
+            lun->this_lun_avail_time = c.get();
+            c.raw(&lun->die, sizeof(lun->die));
+            c.raw(lun->sched_q, sizeof(lun->sched_q));
+            lun->sched_len = c.get();
+            lun->sched_busy_end = c.get();
+            lun->busy = c.get();
+            lun->nrd = c.get();
+            lun->nwr = c.get();
+            lun->total_channel_latency = c.get();
+        }
+        ssd->ch[ch].next_ch_avail_time = c.get();
+        ssd->ch[ch].busy = c.get();
+    }
+    return c.done();
+}
+
+/* same walk as restore_nand over an SSD of @spp, nothing is restored */
+static bool check_nand(const ssdparams *spp, ckpt_cursor &c) {
+    uint64_t npages = c.get();
+    for (uint64_t i = 0; i < npages && c.ok; i++) {
+        if (c.get() >> 2 >= (uint64_t) spp->tt_pgs)
+            return false;
+        c.skip(1);
+    }
+
+    uint64_t nblks = c.get();
+    for (uint64_t i = 0; i < nblks && c.ok; i++) {
+        if (c.get() >= (uint64_t) spp->tt_blks)
+            return false;
+        c.skip(4);
+    }
+
+    for (int s = 0; s < spp->sb_per_ssd && c.ok; s++) {
+        c.skip(4);
+        uint64_t nwls = c.get();
+        for (uint64_t i = 0; i < nwls && c.ok; i++) {
+            if (c.get() >= (uint64_t) spp->wls_per_sb)
+                return false;
+            c.skip(2);
+        }
+    }
+
+    uint64_t lun_words = 3 + (sizeof(nand_die_timing) + 7) / 8 +
+                         (NAND_SCHED_QUEUE_MAX * sizeof(nand_sched_op) + 7) / 8 + 6;
+    c.skip((uint64_t) spp->nchs * (spp->luns_per_ch * lun_words + 2));
+    return c.done();
+}
+
+static void checkpoint_wlog(ssd *ssd, std::vector<uint64_t> &out) {
+    log_entry *start = ssd->bytefs_log_region_start;
+    uint64_t nentries = ssd->log_size.load() / sizeof(log_entry);
+
+    out.push_back(ssd->bytefs_log_region_size);
+    out.push_back(ssd->log_rp - start);
+    out.push_back(ssd->log_wp - start);
+    out.push_back(ssd->log_size.load());
+    out.push_back(ssd->log_flush_required);
+    out.push_back(ckpt_pack(ssd->log_read_cnt, ssd->log_write_cnt));
+    // live entries from the head, the cacheline data is not modeled
+    log_entry *e = ssd->log_rp;
+    for (uint64_t i = 0; i < nentries; i++) {
+        out.push_back(e->lpa);
+        e = e + 2 > ssd->bytefs_log_region_end ? start : e + 1;
+    }
+
+    // IMT pages: lpn, number of set slots, then slot << 32 | log entry index
+    out.push_back(ssd->imt_npages.load());
+    ssd->indirection_mt.for_each([&](uint64_t lpn, uint64_t ent) {
+        imt_page *imtp = (imt_page *) ent;
+        out.push_back(lpn);
+        size_t at = out.size();
+        out.push_back(0);
+        for (uint64_t s = 0; s < IMT_SLOTS_PER_PAGE; s++) {
+            log_entry *slot = imtp->slot[s].load(std::memory_order_acquire);
+            if (slot == nullptr)
+                continue;
+            out.push_back(s << 32 | (uint64_t)(slot - start));
+            out[at]++;
+        }
+    });
+}
+
+static bool restore_wlog(ssd *ssd, ckpt_cursor &c) {
+    log_entry *start = ssd->bytefs_log_region_start;
+    uint64_t region_entries = ssd->bytefs_log_region_end - start;
+
+    if (c.get() != ssd->bytefs_log_region_size)
+        return false;
+    uint64_t rp = c.get();
+    uint64_t wp = c.get();
+    uint64_t size = c.get();
+    if (rp >= region_entries || wp >= region_entries || size > ssd->bytefs_log_region_size)
+        return false;
+    ssd->log_rp = start + rp;
+    ssd->log_wp = start + wp;
+    ssd->log_size = size;
+    ssd->log_flush_required = c.get();
+    uint64_t w = c.get();
+    ssd->log_read_cnt = ckpt_hi(w);
+    ssd->log_write_cnt = ckpt_lo(w);
+    log_entry *e = ssd->log_rp;
+    for (uint64_t i = 0; i < size / sizeof(log_entry); i++) {
+        e->lpa = c.get();
+        e = e + 2 > ssd->bytefs_log_region_end ? start : e + 1;
+    }
+
+    uint64_t npages = c.get();
+    for (uint64_t i = 0; i < npages && c.ok; i++) {
+        uint64_t lpn = c.get();
+        uint64_t nslots = c.get();
+        imt_page *imtp = (imt_page *) malloc(sizeof(imt_page));
+        bytefs_assert(imtp);
+        for (uint64_t s = 0; s < IMT_SLOTS_PER_PAGE; s++)
+            imtp->slot[s].store(nullptr, std::memory_order_relaxed);
+        for (uint64_t j = 0; j < nslots && c.ok; j++) {
+            uint64_t slot = c.get();
+            if ((slot >> 32) >= IMT_SLOTS_PER_PAGE || (uint32_t) slot >= region_entries) {
+                free(imtp);
+                return false;
+            }
+            imtp->slot[slot >> 32].store(start + (uint32_t) slot, std::memory_order_relaxed);
+        }
+        ssd->indirection_mt.set(lpn, (uint64_t) imtp);
+    }
+    ssd->imt_npages = npages;
+    return c.done();
+}
+
+/* same walk as restore_wlog, nothing is restored */
+static bool check_wlog(ckpt_cursor &c) {
+    uint64_t region_size = c.get();
+    uint64_t region_entries = region_size / sizeof(log_entry);
+    uint64_t rp = c.get();
+    uint64_t wp = c.get();
+    uint64_t size = c.get();
+    if (rp >= region_entries || wp >= region_entries || size > region_size)
+        return false;
+    c.skip(2 + size / sizeof(log_entry));
+
+    uint64_t npages = c.get();
+    for (uint64_t i = 0; i < npages && c.ok; i++) {
+        c.skip(1);
+        uint64_t nslots = c.get();
+        for (uint64_t j = 0; j < nslots && c.ok; j++) {
+            uint64_t slot = c.get();
+            if ((slot >> 32) >= IMT_SLOTS_PER_PAGE || (uint32_t) slot >= region_entries)
+                return false;
+        }
+    }
+    return c.done();
+}
+
+/*
+ * Walks every section of a checkpoint without touching any state, so a stale
+ * or truncated one is dropped before the run starts restoring it. The sizes
+ * come from the ssdparams stored in the checkpoint, which the key ties to
+ * this config.
+ */
+bool warmup_checkpoint_valid(snapshot_file* s){
+    uint64_t len;
+    const uint64_t *data;
+
+    data = snapshot_section_data(s, SNAP_CKPT_CONFIG, &len);
+    ckpt_cursor cfg(data, len);
+    ssdparams sp;
+    if (cfg.get() != warmup_checkpoint_key())
+        return false;
+    cfg.raw(&sp, sizeof(sp));
+    if (!cfg.done())
+        return false;
+
+    data = snapshot_section_data(s, SNAP_CKPT_NAND, &len);
+    ckpt_cursor nand(data, len);
+    if (!check_nand(&sp, nand))
+        return false;
+
+    data = snapshot_section_data(s, SNAP_CKPT_GC, &len);
+    if (!bytefs_gc_checkpoint_valid(&sp, data, len))
+        return false;
+
+    data = snapshot_section_data(s, SNAP_CKPT_MAPTBL, &len);
+    if (!data || len % 2)
+        return false;
+
+    data = snapshot_section_data(s, SNAP_CKPT_STREAMS, &len);
+    ckpt_cursor streams(data, len);
+    streams.skip(3 * NR_WRITE_STREAMS + 1);
+    if (temperature_classify)
+        streams.skip((TEMP_TABLE_SIZE + 7) / 8);
+    if (!streams.done())
+        return false;
+
+    data = snapshot_section_data(s, SNAP_CKPT_WLOG, &len);
+    ckpt_cursor wlog(data, len);
+    if (!check_wlog(wlog))
+        return false;
+
+    if (!cache_controller::checkpoint_valid(s))
+        return false;
+    if (!snapshot_section_data(s, SNAP_TPP_INACTIVE, &len) || !snapshot_section_data(s, SNAP_TPP_ACTIVE, &len) ||
+        !snapshot_section_data(s, SNAP_TPP_NUMA_SCAN, &len))
+        return false;
+    data = snapshot_section_data(s, SNAP_CKPT_HOST_SPACE, &len);
+    if (!data || len < 3)
+        return false;
+
+    data = snapshot_section_data(s, SNAP_CKPT_STAT, &len);
+    if (!data || len != sizeof(ssd_stat) / sizeof(atomic_uint64_t) + 1)
+        return false;
+
+    data = snapshot_section_data(s, SNAP_CKPT_LAT_HIST, &len);
+    if (!ssd_stat_lat_checkpoint_valid(data, len, (uint64_t) sp.nchs * sp.luns_per_ch))
+        return false;
+
+    data = snapshot_section_data(s, SNAP_CKPT_CLOCK, &len);
+    return data && len == 2;
+}
+
+void save_warmup_checkpoint(snapshot_writer* w){
+    ssd *ssd = &gdev;
+    std::vector<uint64_t> data;
+
+    data = {warmup_checkpoint_key()};
+    ckpt_put_raw(data, &ssd->sp, sizeof(ssd->sp));
+    snapshot_add(w, SNAP_CKPT_CONFIG, std::move(data));
+
+    data.clear();
+    checkpoint_nand(ssd, data);
+    snapshot_add(w, SNAP_CKPT_NAND, std::move(data));
+
+    data.clear();
+    bytefs_gc_checkpoint(ssd, data);
+    snapshot_add(w, SNAP_CKPT_GC, std::move(data));
+
+    data.clear();
+    ssd->maptbl.for_each([&](uint64_t lpn, uint64_t ent) {
+        data.push_back(lpn);
+        data.push_back(ent);
+    });
+    snapshot_add(w, SNAP_CKPT_MAPTBL, std::move(data));
+
+    data.clear();
+    for (int s = 0; s < NR_WRITE_STREAMS; s++) {
+        write_pointer *wpp = &ssd->wp[s];
+        data.push_back(ckpt_pack(wpp->ch, wpp->next_ch));
+        data.push_back(ckpt_pack(wpp->lun, wpp->blk));
+        data.push_back(wpp->pg);
+    }
+    data.push_back(ssd->temp_updates);
+    if (ssd->temp_counters)
+        ckpt_put_raw(data, ssd->temp_counters, TEMP_TABLE_SIZE);
+    snapshot_add(w, SNAP_CKPT_STREAMS, std::move(data));
+
+    data.clear();
+    checkpoint_wlog(ssd, data);
+    snapshot_add(w, SNAP_CKPT_WLOG, std::move(data));
+
+    dram_subsystem->checkpoint(w);
+    copy_tpp_system(w);
+    data = {NUMA_scan_pointer, NUMA_scan_threshold_ns, (uint64_t) NUMA_scan_count};
+    data.insert(data.end(), ordered_memory_space.begin(), ordered_memory_space.end());
+    snapshot_add(w, SNAP_CKPT_HOST_SPACE, std::move(data));
+
+    data.clear();
+    const atomic_uint64_t *counters = (const atomic_uint64_t *) &stat;
+    for (size_t i = 0; i < sizeof(ssd_stat) / sizeof(atomic_uint64_t); i++)
+        data.push_back(counters[i].load());
+    data.push_back(stat_flag);
+    snapshot_add(w, SNAP_CKPT_STAT, std::move(data));
+
+    data.clear();
+    ssd_stat_lat_checkpoint(data);
+    snapshot_add(w, SNAP_CKPT_LAT_HIST, std::move(data));
+
+    // the measured run draws from a seed both the saving and the restoring run share
+    unsigned int seed = rand();
+    srand(seed);
+    snapshot_add(w, SNAP_CKPT_CLOCK, {(uint64_t) the_clock_pt->get_time_sim(), seed});
+}
+
+/* false if the checkpoint belongs to another config or is malformed, check warmup_checkpoint_valid first */
+bool restore_warmup_checkpoint(snapshot_file* s){
+    ssd *ssd = &gdev;
+    uint64_t len;
+    const uint64_t *data;
+
+    static_assert(sizeof(ssd_stat) % sizeof(atomic_uint64_t) == 0, "ssd_stat holds counters only");
+    bytefs_assert_msg(ssd->maptbl.size() == 0 && ssd->imt_npages.load() == 0,
+                      "checkpoints restore into a freshly initialized SSD");
+
+    data = snapshot_section_data(s, SNAP_CKPT_CONFIG, &len);
+    ckpt_cursor cfg(data, len);
+    ssdparams sp;
+    if (cfg.get() != warmup_checkpoint_key())
+        return false;
+    cfg.raw(&sp, sizeof(sp));
+    if (!cfg.done() || memcmp(&sp, &ssd->sp, sizeof(sp)) != 0)
+        return false;
+
+    data = snapshot_section_data(s, SNAP_CKPT_NAND, &len);
+    ckpt_cursor nand(data, len);
+    if (!restore_nand(ssd, nand))
+        return false;
+
+    data = snapshot_section_data(s, SNAP_CKPT_GC, &len);
+    if (!data || !bytefs_gc_restore(ssd, data, len))
+        return false;
+
+    data = snapshot_section_data(s, SNAP_CKPT_MAPTBL, &len);
+    if (!data || len % 2)
+        return false;
+    for (uint64_t i = 0; i < len; i += 2)
+        ssd->maptbl.set(data[i], data[i + 1]);
+
+    data = snapshot_section_data(s, SNAP_CKPT_STREAMS, &len);
+    ckpt_cursor streams(data, len);
+    for (int i = 0; i < NR_WRITE_STREAMS; i++) {
+        write_pointer *wpp = &ssd->wp[i];
+        uint64_t w = streams.get();
+        wpp->ch = ckpt_hi(w);
+        wpp->next_ch = ckpt_lo(w);
+        w = streams.get();
+        wpp->lun = ckpt_hi(w);
+        wpp->blk = ckpt_lo(w);
+        wpp->pg = streams.get();
+#if ALLOCATION_SECHEM_LINE
+        wpp->blk_ptr = NULL;
+#else
+        wpp->blk_ptr = &ssd->ch[wpp->ch].lun[wpp->lun].blk[wpp->blk];
+#endif
+    }
+    ssd->temp_updates = streams.get();
+    if (ssd->temp_counters)
+        streams.raw(ssd->temp_counters, TEMP_TABLE_SIZE);
+    if (!streams.done())
+        return false;
+
+    data = snapshot_section_data(s, SNAP_CKPT_WLOG, &len);
+    ckpt_cursor wlog(data, len);
+    if (!restore_wlog(ssd, wlog))
+        return false;
+
+    if (!dram_subsystem->restore_checkpoint(s))
+        return false;
+    replay_tpp_system(s);
+    data = snapshot_section_data(s, SNAP_CKPT_HOST_SPACE, &len);
+    if (!data || len < 3)
+        return false;
+    NUMA_scan_pointer = data[0];
+    NUMA_scan_threshold_ns = data[1];
+    NUMA_scan_count = data[2];
+    ordered_memory_space.assign(data + 3, data + len);
+
+    data = snapshot_section_data(s, SNAP_CKPT_STAT, &len);
+    if (!data || len != sizeof(ssd_stat) / sizeof(atomic_uint64_t) + 1)
+        return false;
+    atomic_uint64_t *counters = (atomic_uint64_t *) &stat;
+    for (uint64_t i = 0; i + 1 < len; i++)
+        counters[i] = data[i];
+    stat_flag = data[len - 1];
+
+    data = snapshot_section_data(s, SNAP_CKPT_LAT_HIST, &len);
+    if (!ssd_stat_lat_restore(data, len))
+        return false;
+
+    data = snapshot_section_data(s, SNAP_CKPT_CLOCK, &len);
+    if (!data || len != 2)
+        return false;
+    the_clock_pt->set_time_sim(data[0]);
+    srand(data[1]);
+    return true;
 }
 
 
@@ -2888,11 +4058,11 @@ double cache_overall_cover_rate, double host_overall_cover_rate, double cache_un
             nand_cmd cmd;
             ppa ppa;
             ssd->maptbl_update_mutex.lock();
-            ppa = get_new_page(ssd);
+            ppa = get_new_page(ssd, WS_USER);
             set_maptbl_ent(ssd, warmup_lpns[i], &ppa);
             set_rmap_ent(ssd, warmup_lpns[i], &ppa);
             mark_page_valid(ssd, &ppa);
-            ssd_advance_write_pointer(ssd);
+            ssd_advance_write_pointer(ssd, WS_USER);
 
             // perform data write
             cmd.type = INTERNAL_TRANSFER;
@@ -2952,11 +4122,11 @@ void warmup_write_log(uint64_t read_pgnum, uint64_t write_pgnum){
             nand_cmd cmd;
             ppa ppa;
             ssd->maptbl_update_mutex.lock();
-            ppa = get_new_page(ssd);
+            ppa = get_new_page(ssd, WS_USER);
             set_maptbl_ent(ssd, warmup_lpns[i], &ppa);
             set_rmap_ent(ssd, warmup_lpns[i], &ppa);
             mark_page_valid(ssd, &ppa);
-            ssd_advance_write_pointer(ssd);
+            ssd_advance_write_pointer(ssd, WS_USER);
 
             // perform data write
             cmd.type = INTERNAL_TRANSFER;
@@ -2983,6 +4153,9 @@ void ssd_backend_reset_timestamp(){
                 ssd->ch[i].lun[j].next_lun_avail_time = 0;
                 ssd->ch[i].lun[j].next_log_flush_lun_avail_time = 0;
                 ssd->ch[i].lun[j].this_lun_avail_time = 0;
+                memset(&ssd->ch[i].lun[j].die, 0, sizeof(ssd->ch[i].lun[j].die));
+                ssd->ch[i].lun[j].sched_len = 0;
+                ssd->ch[i].lun[j].sched_busy_end = 0;
                 ssd->ch[i].lun[j].busy = false;
         }
         ssd->ch[i].next_ch_avail_time = 0;
@@ -2991,6 +4164,15 @@ void ssd_backend_reset_timestamp(){
 }
 
 
+uint64_t ssd_maptbl_mem_usage(void) {
+    ssd *ssd = &gdev;
+#if FTL_MAPTBL_DENSE
+    return ssd->maptbl.mem_usage();
+#else
+    return hash_maptbl_mem_estimate(ssd->maptbl.size(), sizeof(ppa));
+#endif
+}
+
 void ssd_parameter_dump(void) {
     ssd *ssd = &gdev;
     bytefs_log("Log region");
@@ -3001,6 +4183,9 @@ void ssd_parameter_dump(void) {
     bytefs_log("  Log size     : %lX", (uint64_t) ssd->log_size);
     bytefs_log("  Pending Flush: %s", ssd->log_flush_required ? "o" : "x");
     bytefs_log("Mapping table");
-    bytefs_log("  IMT size     : %ld", (uint64_t) ssd->indirection_mt.size());
-    //bytefs_log("  IMT ld factor: %f", ssd->indirection_mt.load_factor());
+    bytefs_log("  Mapped LPNs  : %ld", (uint64_t) ssd->maptbl.size());
+    bytefs_log("  Maptbl bytes : %ld", ssd_maptbl_mem_usage());
+    bytefs_log("  Hash est.    : %ld", hash_maptbl_mem_estimate(ssd->maptbl.size(), sizeof(ppa)));
+    bytefs_log("  IMT pages    : %ld", (uint64_t) ssd->imt_npages.load());
+    bytefs_log("  IMT bytes    : %ld", ssd->indirection_mt.mem_usage() + ssd->imt_npages.load() * sizeof(imt_page));
 }
\ No newline at end of file
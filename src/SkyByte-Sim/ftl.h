@@ -7,6 +7,7 @@
 #include <pthread.h>
 #include <time.h>
 #include <mutex>
+#include <condition_variable>
 
 #include "timing_model.h"
 #include "ftl_mapping.h"
@@ -15,6 +16,9 @@
 #include "bytefs_gc.h"
 #include "ring.h"
 #include "utils.h"
+#include "ftl_maptbl.h"
+#include "snapshot.h"
+#include "lat_hist.h"
 
 using std::unordered_map;
 using std::map;
@@ -136,6 +140,9 @@ struct SsdDramBackend {
 
 #define ALLOCATION_SECHEM_LINE (1)  // 0 for block 1 for writeline
 
+/* 1 for the dense radix mapping table, 0 for the unordered_map one */
+#define FTL_MAPTBL_DENSE    (1)
+
 // struct gc_free_list;
 // struct gc_candidate_list;
 // struct bytefs_heap;
@@ -184,6 +191,7 @@ struct nand_block {
     int ipc; /* invalid page count */
     int vpc; /* valid page count */
     int erase_cnt;
+    uint64_t last_write_seq; /* gc_write_seq of the latest page programmed */
     
     // GC specific
     int ch_idx;
@@ -218,6 +226,7 @@ struct writeline {
  * @iwc: invalid write line count
  * @vwc: valid write line count
  * @erase_cnt: times of the superblock being erased
+ * @last_write_seq: gc_write_seq of the latest page programmed, the GC age
  * @wp: write pointer
  */
 struct ssd_superblock {
@@ -228,6 +237,8 @@ struct ssd_superblock {
     int ipc; /* invalid page count */
     int vpc;   /* valid page count */
     int erase_cnt;
+    uint64_t last_write_seq;
+    int is_open;    /* a write stream still allocates from it */
 
 
     // GC specific
@@ -244,11 +255,74 @@ struct ssd_superblock {
  * @valid_wl_cnt: valid write line count
  */
 
+/**
+ * struct nand_die_timing - die state of the detailed NAND timing model
+ * @plane_avail_time: time each plane's array is free
+ * @cache_reg_avail_time: time the cache register takes the next program's data
+ * @pe_start: array start of the program/erase in flight
+ * @pe_end: its end, pushed back by every suspend
+ * @pe_planes: planes the program in flight covers (multi-plane)
+ * @pe_erase: the op in flight is an erase
+ * @pe_suspends: suspends the op in flight took so far
+ * @susp_read_end: array end of the last read done while the op was suspended
+ */
+struct nand_die_timing {
+    uint64_t plane_avail_time[NAND_PLANES_PER_LUN];
+    uint64_t cache_reg_avail_time;
+    uint64_t pe_start;
+    uint64_t pe_end;
+    uint32_t pe_planes;
+    bool pe_erase;
+    int pe_suspends;
+    uint64_t susp_read_end;
+};
+
+/* NAND request classes the LUN scheduler tells apart */
+enum nand_req_class {
+    REQ_DEMAND_READ,    /* USER_IO reads, a host access waits on them */
+    REQ_LOG_FLUSH,      /* INTERNAL_TRANSFER, log coalescing */
+    REQ_WRITEBACK,      /* USER_IO writes, cache and host DRAM write-backs */
+    REQ_GC,             /* GC_IO */
+    NR_REQ_CLASSES,
+};
+
+enum nand_sched_policy_enum {
+    NSCHED_FIFO,         /* reserve the LUN timeline in call order */
+    NSCHED_READ_FIRST,   /* demand reads overtake queued background commands */
+    NSCHED_DEADLINE,     /* as READ_FIRST, as long as the overtaken commands meet their deadline */
+};
+
+/* commands reserved on a LUN but not started yet, the ones a read may overtake */
+#define NAND_SCHED_QUEUE_MAX    (64)
+/* deadlines of the background classes, relative to their arrival (ns) */
+#define NAND_SCHED_DEADLINE_FLUSH       (2000000)
+#define NAND_SCHED_DEADLINE_WRITEBACK   (2000000)
+#define NAND_SCHED_DEADLINE_GC          (10000000)
+
+/**
+ * struct nand_sched_op - a command reserved on the LUN timeline
+ * @start/@end: reserved interval
+ * @deadline: latest acceptable end, NSCHED_DEADLINE only
+ * @delayed: time it has been pushed back by overtaking reads
+ * @cls: request class
+ */
+struct nand_sched_op {
+    uint64_t start;
+    uint64_t end;
+    uint64_t deadline;
+    uint64_t delayed;
+    int cls;
+};
+
 /**
  * struct lun - lun structure
  * @blk: blocks in this lun
  * @nblks: block count of the lun
  * @next_lun_avail_time: time for all request in this lun finishes
+ * @die: plane/suspend state, detailed timing model only
+ * @sched_q: commands not started yet in start order, non-FIFO schedulers only
+ * @sched_busy_end: end of the last command that left @sched_q by starting
+ * @queue_lat: time commands waited before the LUN started them, under @timing_mutex
  * @busy: is lun working now? (not really used)
  */
 struct nand_lun {
@@ -257,6 +331,11 @@ struct nand_lun {
     uint64_t next_lun_avail_time;
     uint64_t next_log_flush_lun_avail_time;
     uint64_t this_lun_avail_time;
+    struct nand_die_timing die;
+    struct nand_sched_op sched_q[NAND_SCHED_QUEUE_MAX];
+    int sched_len;
+    uint64_t sched_busy_end;
+    struct lat_hist queue_lat;
     std::mutex timing_mutex;
     bool busy;
     uint64_t nrd = 0;
@@ -270,13 +349,15 @@ struct nand_lun {
  * struct channel - channel structure
  * @lun: luns in this channel
  * @nluns: lun count of the channel
- * @next_ch_avail_time: time for all request in this channel finishes
+ * @next_ch_avail_time: time for all request in this channel finishes,
+ *                      the shared bus timeline of the detailed timing model
  * @busy: is channel working now? (not really used)
  */
 struct ssd_channel {
     nand_lun *lun;
     int nluns;
     uint64_t next_ch_avail_time;
+    std::mutex bus_mutex;
     bool busy;
     // uint64_t gc_endtime;
 };
@@ -287,7 +368,7 @@ struct ssdparams {
 
     int pgs_per_blk;  /* # of NAND pages per block */
     int blks_per_lun;  /* # of blocks per plane */
-    // int pls_per_lun;  /* # of planes per LUN (Die) */
+    int pls_per_lun;  /* # of planes per LUN (Die) */
     int luns_per_ch;  /* # of LUNs per channel */
     int nchs;         /* # of channels in the SSD */
 
@@ -305,6 +386,7 @@ struct ssdparams {
     int ch_xfer_lat;  /* channel transfer latency for one page in nanoseconds
                        * this defines the channel bandwith
                        */
+    struct nand_cell_timing cell;   /* per page type latencies */
 
     // double gc_thres_pcent;
     // double gc_thres_pcent_high;
@@ -326,6 +408,26 @@ struct ssdparams {
 };
 
 
+/**
+ * Write streams, each with its own write pointer and open superblock so data
+ * of different lifetimes does not share erase units. With multi-stream off
+ * every stream resolves to WS_USER, the single pointer of the old allocator.
+ */
+enum write_stream_enum {
+    WS_USER = 0,    /* log flush and direct page writes */
+    WS_USER_HOT,    /* user writes the temperature classifier deems hot */
+    WS_GC,          /* GC relocations */
+    WS_DEMOTION,    /* host DRAM write-backs */
+    NR_WRITE_STREAMS,
+};
+
+/* temperature classifier: saturating per-LPN update counters, hashed */
+#define TEMP_TABLE_BITS         (20)
+#define TEMP_TABLE_SIZE         (1UL << TEMP_TABLE_BITS)
+#define TEMP_HOT_THRESHOLD      (4)
+/* all counters are halved once this many updates went through */
+#define TEMP_DECAY_INTERVAL     (TEMP_TABLE_SIZE * 4)
+
 /* wp: record next write page */
 struct write_pointer {
     int ch;
@@ -341,6 +443,7 @@ struct nand_cmd {
     int type;
     int cmd;
     uint64_t stime; /* Coperd: request arrival time */
+    uint64_t etime; /* completion time, set by ssd_advance_status */
 };
 
 #define BYTEFS_LOG_VALID (1 << 0)
@@ -357,6 +460,59 @@ struct log_entry {
     uint8_t data[64];
 };
 
+#define IMT_SLOTS_PER_PAGE  (PG_SIZE / BYTEFS_LOG_REGION_GRANDULARITY)
+
+/**
+ * Per-page entry of the indirection mapping table, one slot per cacheline.
+ * A slot points to the log entry holding the latest copy of that cacheline,
+ * or is nullptr if the cacheline has nothing pending in the log. Slots are
+ * swapped atomically, so the log writer and the flusher never need a lock
+ * once they hold the page entry.
+ */
+struct imt_page {
+    std::atomic<log_entry *> slot[IMT_SLOTS_PER_PAGE];
+};
+
+/* log flush batching: pages gathered from the log head per batch, in write lines */
+#define FLUSH_BATCH_WLS     (8)
+
+/**
+ * Helper threads the log flusher hands per-page host work to. The caller
+ * publishes a job over [0, njobs) and takes part in it; workers pick indices
+ * with next_job and the caller returns once every index is done and every
+ * worker has left the generation. next_job carries the generation in its
+ * upper half so a worker still holding an older job cannot claim indices of
+ * a newer one.
+ */
+struct flush_worker_pool {
+    mutex lock;
+    std::condition_variable work_cv;
+    std::condition_variable done_cv;
+    uint64_t generation = 0;
+    void (*job)(uint64_t idx, void *arg) = nullptr;
+    void *job_arg = nullptr;
+    uint64_t njobs = 0;
+    std::atomic<uint64_t> next_job{0};
+    std::atomic<uint64_t> finished_jobs{0};
+    uint64_t active_workers = 0;
+    std::atomic<bool> running{false};    /* one job at a time, jobs must not submit jobs */
+};
+
+/* one page of a log flush batch */
+struct flush_batch_ent {
+    uint64_t lpn;
+    bool load_page;
+    uint64_t wr_modified;
+    uint64_t ready_time;    /* when the old copy is in the coalescing buffer */
+};
+
+/* a NAND command of a log flush or GC batch, @lat is set once it is issued */
+struct nand_batch_cmd {
+    struct ppa addr;
+    struct nand_cmd cmd;
+    uint64_t lat;
+};
+
 struct ssd {
     char *ssdname;
     struct ssdparams sp;
@@ -369,9 +525,15 @@ struct ssd {
     // now lpa can exceed physical space size
     // ppa *maptbl; /* page level mapping table */
     mutex maptbl_update_mutex;
+#if FTL_MAPTBL_DENSE
+    radix_maptbl maptbl;
+#else
     unordered_map<uint64_t, ppa> maptbl;
+#endif
     uint64_t *rmap;     /* reverse mapptbl, assume it's stored in OOB */
-    struct write_pointer wp;
+    struct write_pointer wp[NR_WRITE_STREAMS];
+    uint8_t *temp_counters;     /* TEMP_TABLE_SIZE update counters */
+    uint64_t temp_updates;
     // line_mgmt lm;
 
     /* lockless ring for communication with NVMe IO thread */
@@ -383,13 +545,16 @@ struct ssd {
     struct SsdDramBackend* bd;
 
     // thread
-    const uint64_t n_log_writer_threads = 1;
+    uint64_t n_log_writer_threads = 1;
     const uint64_t n_promotion_threads = 1;
+    uint64_t n_flush_threads = 1;   /* flusher included, extra ones join flush_pool */
     struct ftl_thread_info *thread_args;
     pthread_t *ftl_thread_id;
     pthread_t *polling_thread_id;
     pthread_t *log_writer_thread_id;
     pthread_t *promotion_thread_id;
+    pthread_t *flush_worker_thread_id;
+    struct flush_worker_pool flush_pool;
     pthread_t *simulator_timer_id;
     volatile uint8_t terminate_flag = 0;
 
@@ -401,10 +566,11 @@ struct ssd {
     struct log_entry *log_rp;
     struct log_entry *log_wp;
     volatile atomic_uint64_t log_size;
-    mutex indirection_mt_lock;
-    map<uint64_t, uint64_t> indirection_mt; // must be populated first
+    radix_maptbl indirection_mt; // LPN -> imt_page *, must be populated first
+    atomic_uint64_t imt_npages;
     void *log_page_buffer;
-    void *flush_page_buffer;
+    void *flush_page_buffer;    /* one page per flush batch entry */
+    struct flush_batch_ent *flush_batch;
     size_t log_flush_lo_threshold;
     size_t log_flush_hi_threshold;
     volatile int log_flush_required;
@@ -426,6 +592,9 @@ struct ssd {
     void *gc_buffer;
     int free_blk_lo_threshold;
     int free_blk_hi_threshold;
+    int free_blk_bg_threshold;
+    uint64_t gc_write_seq;  /* pages programmed so far, the clock of GC ages */
+    uint64_t gc_heaps_seq;  /* gc_write_seq the background GC heaps were built at */
     volatile uint8_t undergoing_gc = 0;
     
     volatile uint8_t run_flag = 0;
@@ -504,12 +673,28 @@ inline ppa get_maptbl_ent(ssd *ssd, uint64_t lpn)
     // LPA range can exceed physical space now
     // bytefs_assert_msg(lpn < ssd->sp.tt_pgs,
     //         "LPN: %ld exceeds #tt_pgs: %d", lpn, ssd->sp.tt_pgs);
+#if FTL_MAPTBL_DENSE
+    ppa ret;
+    uint64_t ent = ssd->maptbl.get(lpn);
+    if (ent == MAPTBL_EMPTY_ENT) {
+        ret.realppa = UNMAPPED_PPA;
+        return ret;
+    }
+    ret.g.blk = ent & ((1UL << BLK_BITS) - 1);
+    ret.g.pg = (ent >> BLK_BITS) & ((1UL << PG_BITS) - 1);
+    ret.g.lun = (ent >> (BLK_BITS + PG_BITS)) & ((1UL << LUN_BITS) - 1);
+    ret.g.ch = (ent >> (BLK_BITS + PG_BITS + LUN_BITS)) & ((1UL << CH_BITS) - 1);
+    ret.g.rsv = 0;
+    ppa2pgidx(ssd, &ret);
+    return ret;
+#else
     if (ssd->maptbl.find(lpn) == ssd->maptbl.end()) {
         ppa ret;
         ret.realppa = UNMAPPED_PPA;
         return ret;
     }
     return ssd->maptbl[lpn];
+#endif
 }
 
 /**
@@ -520,7 +705,18 @@ inline void set_maptbl_ent(ssd *ssd, uint64_t lpn, ppa *ppa)
     // LPA range can exceed physical space now
     // bytefs_assert_msg(lpn < ssd->sp.tt_pgs,
     //         "LPN: %ld exceeds #tt_pgs: %d", lpn, ssd->sp.tt_pgs);
+#if FTL_MAPTBL_DENSE
+    uint64_t ent = MAPTBL_EMPTY_ENT;
+    if (ppa->realppa != UNMAPPED_PPA) {
+        ent = (uint64_t) ppa->g.blk |
+              ((uint64_t) ppa->g.pg << BLK_BITS) |
+              ((uint64_t) ppa->g.lun << (BLK_BITS + PG_BITS)) |
+              ((uint64_t) ppa->g.ch << (BLK_BITS + PG_BITS + LUN_BITS));
+    }
+    ssd->maptbl.set(lpn, ent);
+#else
     ssd->maptbl[lpn] = *ppa;
+#endif
 }
 
 inline uint64_t get_rmap_ent(ssd *ssd, ppa *ppa)
@@ -537,7 +733,8 @@ inline void set_rmap_ent(ssd *ssd, uint64_t lpn, ppa *ppa)
 }
 
 
-ppa get_new_page(struct ssd *ssd);
+ppa get_new_page(struct ssd *ssd, int stream);
+int ssd_user_write_stream(struct ssd *ssd, uint64_t lpn);
 void mark_page_invalid(struct ssd *ssd, struct ppa *ppa);
 void mark_page_valid(struct ssd *ssd, struct ppa *ppa);
 void mark_block_free(struct ssd *ssd, struct ppa *ppa);
@@ -547,11 +744,17 @@ int is_block_free(struct ssd *ssd, struct nand_block *nand_block);
 bool backend_prefill_data(uint64_t addr);
 void ssd_backend_reset_timestamp();
 
-void ssd_advance_write_pointer(struct ssd *ssd);
+void ssd_advance_write_pointer(struct ssd *ssd, int stream);
 uint64_t ssd_advance_status(struct ssd *ssd, struct ppa *ppa, struct nand_cmd *ncmd);
+bool parse_nand_sched_policy(const std::string &name, nand_sched_policy_enum *policy);
+const char *nand_sched_policy_name(nand_sched_policy_enum policy);
+const char *nand_req_class_name(int cls);
 
 void *log_writer_thread(void *thread_args);
 void *promotion_thread(void *thread_args);
+void *flush_worker_thread(void *thread_args);
+void flush_pool_stop(void);
+void nand_batch_issue(struct ssd *ssd, nand_batch_cmd *cmds, uint64_t ncmds);
 void *simulator_timer_thread(void *thread_args);
 
 void force_flush_log(void);
@@ -567,11 +770,21 @@ int64_t get_hostdram_dirty_marked_page_num();
 int64_t get_thecache_accessed_marked_page_num();
 int64_t get_hostdram_accessed_marked_page_num();
 
-void copy_dram_system(FILE* output_file);
-void replay_dram_system(FILE* input_file);
+/* warmup snapshots, see snapshot.h; the *_from_text ones convert the old text dumps */
+void copy_dram_system(snapshot_writer* w);
+void replay_dram_system(snapshot_file* s);
+bool dram_system_from_text(FILE* input_file, snapshot_writer* w);
+
+void copy_tpp_system(snapshot_writer* w);
+void replay_tpp_system(snapshot_file* s);
+bool tpp_system_from_text(FILE* input_file, snapshot_writer* w);
 
-void copy_tpp_system(FILE* output_file);
-void replay_tpp_system(FILE* input_file);
+/* post-warmup checkpoint, a config may restore it when the keys match */
+uint64_t warmup_checkpoint_key(void);
+void save_warmup_checkpoint(snapshot_writer* w);
+bool restore_warmup_checkpoint(snapshot_file* s);
+/* layout check of every checkpoint section, callable before ssd_init */
+bool warmup_checkpoint_valid(snapshot_file* s);
 
 void warmup_write_log(uint64_t read_pgnum, uint64_t write_pgnum);
 
@@ -587,6 +800,7 @@ static inline bool lba_is_legal(uint64_t lba) {
 
 void *ftl_thread(void *arg);
 void *request_poller_thread(void *arg);
+uint64_t ssd_maptbl_mem_usage(void);
 void ssd_parameter_dump(void);
 
 void bytefs_fill_data(uint64_t current_lpn);
@@ -0,0 +1,170 @@
+#ifndef __FTL_MAPTBL_H__
+#define __FTL_MAPTBL_H__
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+
+#include "bytefs_utils.h"
+
+/* radix geometry: 3 levels x 12 bits cover LPNs below 2^36 (256 TB of LPA) */
+#define MAPTBL_LEVEL_BITS       (12)
+#define MAPTBL_LEVEL_FANOUT     (1UL << MAPTBL_LEVEL_BITS)
+#define MAPTBL_LEVEL_MASK       (MAPTBL_LEVEL_FANOUT - 1)
+#define MAPTBL_LPN_BITS         (3 * MAPTBL_LEVEL_BITS)
+
+#define MAPTBL_EMPTY_ENT        (0xFFFFFFFFFFFFFFFFUL)
+
+/**
+ * struct radix_maptbl - dense LPN-indexed page mapping table
+ * @root: top level node, allocated at init
+ * @nnodes: number of interior nodes allocated (root included)
+ * @nleaves: number of leaves allocated
+ * @nmapped: number of LPNs currently holding a mapping
+ *
+ * Interior nodes and leaves are allocated the first time an LPN in their
+ * range is set, so the footprint follows the logical range actually touched
+ * instead of the whole 36-bit space. Leaf entries are 64-bit atomics (a packed
+ * ppa for the page mapping table, an imt_page pointer for the IMT), with
+ * MAPTBL_EMPTY_ENT when unset; new nodes are published with a CAS, so neither
+ * lookups nor updates need a table-wide lock.
+ */
+struct radix_maptbl {
+    struct node {
+        std::atomic<void *> child[MAPTBL_LEVEL_FANOUT];
+    };
+    struct leaf {
+        std::atomic<uint64_t> ent[MAPTBL_LEVEL_FANOUT];
+    };
+
+    node *root = nullptr;
+    std::atomic<uint64_t> nnodes{0};
+    std::atomic<uint64_t> nleaves{0};
+    std::atomic<uint64_t> nmapped{0};
+
+    void init() {
+        if (root)
+            return;
+        root = alloc_node();
+    }
+
+    void clear() {
+        if (!root)
+            return;
+        for (uint64_t i = 0; i < MAPTBL_LEVEL_FANOUT; i++) {
+            node *mid = (node *) root->child[i].load(std::memory_order_relaxed);
+            if (!mid)
+                continue;
+            for (uint64_t j = 0; j < MAPTBL_LEVEL_FANOUT; j++)
+                free(mid->child[j].load(std::memory_order_relaxed));
+            free(mid);
+        }
+        free(root);
+        root = nullptr;
+        nnodes = 0;
+        nleaves = 0;
+        nmapped = 0;
+        init();
+    }
+
+    inline uint64_t get(uint64_t lpn) const {
+        bytefs_assert_msg((lpn >> MAPTBL_LPN_BITS) == 0, "LPN: %lx out of maptbl range", lpn);
+        node *mid = (node *) root->child[idx(lpn, 2)].load(std::memory_order_acquire);
+        if (!mid)
+            return MAPTBL_EMPTY_ENT;
+        leaf *lf = (leaf *) mid->child[idx(lpn, 1)].load(std::memory_order_acquire);
+        if (!lf)
+            return MAPTBL_EMPTY_ENT;
+        return lf->ent[idx(lpn, 0)].load(std::memory_order_acquire);
+    }
+
+    inline void set(uint64_t lpn, uint64_t val) {
+        bytefs_assert_msg((lpn >> MAPTBL_LPN_BITS) == 0, "LPN: %lx out of maptbl range", lpn);
+        node *mid = (node *) get_or_alloc(&root->child[idx(lpn, 2)], false);
+        leaf *lf = (leaf *) get_or_alloc(&mid->child[idx(lpn, 1)], true);
+        uint64_t old = lf->ent[idx(lpn, 0)].exchange(val, std::memory_order_acq_rel);
+        if (old == MAPTBL_EMPTY_ENT && val != MAPTBL_EMPTY_ENT)
+            nmapped++;
+        else if (old != MAPTBL_EMPTY_ENT && val == MAPTBL_EMPTY_ENT)
+            nmapped--;
+    }
+
+    uint64_t size() const {
+        return nmapped.load();
+    }
+
+    /* calls f(lpn, ent) for every set entry in LPN order, writers must be quiescent */
+    template <typename F>
+    void for_each(F f) const {
+        for (uint64_t i = 0; i < MAPTBL_LEVEL_FANOUT; i++) {
+            node *mid = (node *) root->child[i].load(std::memory_order_acquire);
+            if (!mid)
+                continue;
+            for (uint64_t j = 0; j < MAPTBL_LEVEL_FANOUT; j++) {
+                leaf *lf = (leaf *) mid->child[j].load(std::memory_order_acquire);
+                if (!lf)
+                    continue;
+                for (uint64_t k = 0; k < MAPTBL_LEVEL_FANOUT; k++) {
+                    uint64_t ent = lf->ent[k].load(std::memory_order_relaxed);
+                    if (ent != MAPTBL_EMPTY_ENT)
+                        f((((i << MAPTBL_LEVEL_BITS) | j) << MAPTBL_LEVEL_BITS) | k, ent);
+                }
+            }
+        }
+    }
+
+    /* bytes held by the radix nodes and leaves */
+    uint64_t mem_usage() const {
+        return nnodes.load() * sizeof(node) + nleaves.load() * sizeof(leaf);
+    }
+
+private:
+    static inline uint64_t idx(uint64_t lpn, int level) {
+        return (lpn >> (level * MAPTBL_LEVEL_BITS)) & MAPTBL_LEVEL_MASK;
+    }
+
+    node *alloc_node() {
+        node *n = (node *) malloc(sizeof(node));
+        bytefs_assert(n);
+        for (uint64_t i = 0; i < MAPTBL_LEVEL_FANOUT; i++)
+            n->child[i].store(nullptr, std::memory_order_relaxed);
+        nnodes++;
+        return n;
+    }
+
+    leaf *alloc_leaf() {
+        leaf *l = (leaf *) malloc(sizeof(leaf));
+        bytefs_assert(l);
+        for (uint64_t i = 0; i < MAPTBL_LEVEL_FANOUT; i++)
+            l->ent[i].store(MAPTBL_EMPTY_ENT, std::memory_order_relaxed);
+        nleaves++;
+        return l;
+    }
+
+    void *get_or_alloc(std::atomic<void *> *slot, bool is_leaf) {
+        void *cur = slot->load(std::memory_order_acquire);
+        if (cur)
+            return cur;
+        void *fresh = is_leaf ? (void *) alloc_leaf() : (void *) alloc_node();
+        if (slot->compare_exchange_strong(cur, fresh, std::memory_order_acq_rel))
+            return fresh;
+        // lost the race, another thread published this node first
+        free(fresh);
+        if (is_leaf) nleaves--; else nnodes--;
+        return cur;
+    }
+};
+
+/**
+ * Estimated footprint of an unordered_map<uint64_t, ppa> holding @nent entries:
+ * one heap node per entry (next pointer + key/value pair, rounded up to the
+ * 16B malloc granularity plus its 8B header) and one bucket pointer per entry
+ * at the default max load factor of 1.0.
+ */
+static inline uint64_t hash_maptbl_mem_estimate(uint64_t nent, uint64_t value_size) {
+    uint64_t node_size = sizeof(void *) + sizeof(uint64_t) + value_size + 8;
+    node_size = (node_size + 15) / 16 * 16;
+    return nent * (node_size + sizeof(void *));
+}
+
+#endif
@@ -0,0 +1,192 @@
+#include <condition_variable>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "interval_stat.h"
+#include "ssd_stat.h"
+#include "cache_controller.h"
+
+/* rows collected before they are handed to the writer thread */
+#define INTERVAL_FLUSH_BYTES    (64 * 1024)
+
+uint64_t stat_interval_us = 0;      /* 0 disables the time series */
+std::atomic<uint64_t> interval_next_sample(UINT64_MAX);
+
+extern cache_controller* dram_subsystem;
+
+struct interval_field {
+    const char *name;
+    bool counter;                   // written as the increase over the interval
+    uint64_t (*read)(uint64_t now);
+};
+
+static uint64_t busy_luns(uint64_t now) {
+    uint64_t n = 0;
+    for (int ch = 0; ch < gdev.sp.nchs; ch++)
+        for (int lun = 0; lun < gdev.sp.luns_per_ch; lun++)
+            n += gdev.ch[ch].lun[lun].next_lun_avail_time > now;
+    return n;
+}
+
+/* work queued on the LUNs past now, summed over all LUNs */
+static uint64_t nand_backlog(uint64_t now) {
+    uint64_t ns = 0;
+    for (int ch = 0; ch < gdev.sp.nchs; ch++)
+        for (int lun = 0; lun < gdev.sp.luns_per_ch; lun++) {
+            uint64_t avail = gdev.ch[ch].lun[lun].next_lun_avail_time;
+            ns += avail > now ? avail - now : 0;
+        }
+    return ns;
+}
+
+static const interval_field interval_fields[] = {
+    {"accesses",            true,   [](uint64_t) -> uint64_t { return stat.total_access_num.load(); }},
+    {"host_dram_hits",      true,   [](uint64_t) -> uint64_t { return stat.host_dram_hit_num.load(); }},
+    {"dram_hits",           true,   [](uint64_t) -> uint64_t { return stat.hostandssdDram_hit_num.load(); }},
+    {"flash_reads",         true,   [](uint64_t) -> uint64_t { return stat.total_flash_miss_num.load(); }},
+    {"flash_read_ns",       true,   [](uint64_t) -> uint64_t { return stat.total_miss_latency.load(); }},
+    {"ssd_cache_hits",      true,   [](uint64_t) -> uint64_t { return dram_subsystem->the_cache.give_hits(); }},
+    {"ssd_cache_misses",    true,   [](uint64_t) -> uint64_t { return dram_subsystem->the_cache.give_misses(); }},
+    {"log_writes",          true,   [](uint64_t) -> uint64_t { return stat.log_wr_op.load(); }},
+    {"log_size",            false,  [](uint64_t) -> uint64_t { return gdev.log_size.load(); }},
+    {"nand_user_reads",     true,   [](uint64_t) -> uint64_t { return stat.nand_read_user.load(); }},
+    {"nand_user_writes",    true,   [](uint64_t) -> uint64_t { return stat.nand_write_user.load(); }},
+    {"nand_flush_writes",   true,   [](uint64_t) -> uint64_t { return stat.nand_write_internal.load(); }},
+    {"nand_gc_writes",      true,   [](uint64_t) -> uint64_t { return stat.nand_write_gc.load(); }},
+    {"gc_victims",          true,   [](uint64_t) -> uint64_t { return stat.gc_fg_victims.load() + stat.gc_bg_victims.load(); }},
+    {"prefetches",          true,   [](uint64_t) -> uint64_t { return stat.pf_issued.load(); }},
+    {"prefetch_hits",       true,   [](uint64_t) -> uint64_t { return stat.pf_useful.load(); }},
+    {"merged_misses",       true,   [](uint64_t) -> uint64_t { return stat.fill_merged.load(); }},
+    {"cxl_queue_ns",        true,   [](uint64_t) -> uint64_t { return stat.cxl_queue_ns.load(); }},
+#if ALLOCATION_SECHEM_LINE
+    {"free_sbs",            false,  [](uint64_t) -> uint64_t { return gdev.total_free_sbs; }},
+#else
+    {"free_blks",           false,  [](uint64_t) -> uint64_t { return gdev.total_free_blks; }},
+#endif
+    {"fill_queue_depth",    false,  [](uint64_t now) -> uint64_t { return dram_subsystem->fills.depth(now); }},
+    {"busy_luns",           false,  busy_luns},
+    {"nand_backlog_ns",     false,  nand_backlog},
+};
+#define NR_INTERVAL_FIELDS  (sizeof(interval_fields) / sizeof(interval_fields[0]))
+
+static std::vector<const interval_field *> selected;
+static std::vector<uint64_t> last_value;
+static uint64_t interval_ns;
+
+// rows of the sampling thread, and full batches waiting for the writer
+static std::string rows;
+static std::string ready_rows;
+static bool writer_done;
+static std::mutex writer_mutex;
+static std::condition_variable writer_cv;
+static std::thread writer;
+static FILE *interval_file;
+
+bool parse_interval_fields(const std::string &list) {
+    std::stringstream ss(list);
+    std::string name;
+    selected.clear();
+    while (std::getline(ss, name, ',')) {
+        size_t i = 0;
+        while (i < NR_INTERVAL_FIELDS && name != interval_fields[i].name)
+            i++;
+        if (i == NR_INTERVAL_FIELDS)
+            return false;
+        selected.push_back(&interval_fields[i]);
+    }
+    return true;
+}
+
+static void interval_writer(void) {
+    std::string batch;
+    std::unique_lock<std::mutex> lk(writer_mutex);
+    while (true) {
+        writer_cv.wait(lk, []{ return writer_done || !ready_rows.empty(); });
+        batch.swap(ready_rows);
+        bool done = writer_done;
+        lk.unlock();
+        fwrite(batch.data(), 1, batch.size(), interval_file);
+        batch.clear();
+        lk.lock();
+        if (done && ready_rows.empty())
+            return;
+    }
+}
+
+static void hand_off_rows(void) {
+    {
+        std::lock_guard<std::mutex> guard(writer_mutex);
+        ready_rows.append(rows);
+    }
+    rows.clear();
+    writer_cv.notify_one();
+}
+
+void interval_stat_start(const std::string &path, uint64_t now) {
+    if (stat_interval_us == 0)
+        return;
+    interval_file = fopen(path.c_str(), "w");
+    if (interval_file == NULL) {
+        bytefs_err("Cannot open interval stat file %s", path.c_str());
+        return;
+    }
+    if (selected.empty())
+        for (size_t i = 0; i < NR_INTERVAL_FIELDS; i++)
+            selected.push_back(&interval_fields[i]);
+
+    rows = "time_ns";
+    last_value.resize(selected.size());
+    for (size_t i = 0; i < selected.size(); i++) {
+        rows += ',';
+        rows += selected[i]->name;
+        last_value[i] = selected[i]->read(now);
+    }
+    rows += '\n';
+    writer_done = false;
+    writer = std::thread(interval_writer);
+    bytefs_log("Interval stats every %lu us to %s", stat_interval_us, path.c_str());
+
+    interval_ns = stat_interval_us * 1000;
+    interval_next_sample = now - now % interval_ns + interval_ns;
+}
+
+/* one row at @now, the clock may have skipped over several intervals */
+void interval_stat_sample(uint64_t now) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%lu", now);
+    rows += buf;
+    for (size_t i = 0; i < selected.size(); i++) {
+        uint64_t v = selected[i]->read(now);
+        uint64_t out = v;
+        if (selected[i]->counter) {
+            // a stat reset restarts the counters
+            out = v >= last_value[i] ? v - last_value[i] : v;
+            last_value[i] = v;
+        }
+        snprintf(buf, sizeof(buf), ",%lu", out);
+        rows += buf;
+    }
+    rows += '\n';
+    if (rows.size() >= INTERVAL_FLUSH_BYTES)
+        hand_off_rows();
+    interval_next_sample = now - now % interval_ns + interval_ns;
+}
+
+/* called once the FTL thread stopped, with a last row for the partial interval */
+void interval_stat_stop(uint64_t now) {
+    if (interval_file == NULL)
+        return;
+    interval_stat_sample(now);
+    interval_next_sample = UINT64_MAX;
+    hand_off_rows();
+    {
+        std::lock_guard<std::mutex> guard(writer_mutex);
+        writer_done = true;
+    }
+    writer_cv.notify_one();
+    writer.join();
+    fclose(interval_file);
+    interval_file = NULL;
+}
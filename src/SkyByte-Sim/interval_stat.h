@@ -0,0 +1,31 @@
+#ifndef __INTERVAL_STAT_H__
+#define __INTERVAL_STAT_H__
+
+#include <atomic>
+#include <string>
+
+#include <stdint.h>
+
+/*
+ * Time series of the SSD model. While running, the FTL thread samples the
+ * selected fields whenever the simulated clock passed another
+ * stat_interval_us, and a writer thread appends the rows to a CSV file.
+ * Counters are written as their increase over the interval, levels (log
+ * occupancy, free superblocks, NAND backlog) as sampled.
+ */
+extern uint64_t stat_interval_us;
+extern std::atomic<uint64_t> interval_next_sample;
+
+/* select fields by comma separated names, false on an unknown name */
+bool parse_interval_fields(const std::string &list);
+void interval_stat_start(const std::string &path, uint64_t now);
+void interval_stat_sample(uint64_t now);
+void interval_stat_stop(uint64_t now);
+
+/* called from the FTL thread loop, a single compare unless an interval ended */
+inline void interval_stat_tick(uint64_t now) {
+    if (now >= interval_next_sample.load(std::memory_order_relaxed))
+        interval_stat_sample(now);
+}
+
+#endif
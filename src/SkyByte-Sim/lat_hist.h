@@ -0,0 +1,98 @@
+#ifndef __LAT_HIST_H__
+#define __LAT_HIST_H__
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Log-linear latency histogram in the style of HdrHistogram. Values below
+ * LAT_HIST_SUB_COUNT ns get a bucket each, every power of two above is split
+ * into LAT_HIST_SUB_COUNT linear buckets, so a bucket is within 1/32 of the
+ * values it holds. Values of 2^(LAT_HIST_MAX_MSB + 1) ns or more land in the
+ * last bucket, the exact maximum is kept aside.
+ *
+ * A histogram is written by one thread at a time (its owner, or under a lock)
+ * and read once the writers are quiescent, so it takes no atomics. It belongs
+ * to the stat epoch it was last written in; one of an older epoch counts as
+ * empty and clears itself on the next record, so resetting the stats only
+ * bumps the epoch.
+ */
+#define LAT_HIST_SUB_BITS       (5)
+#define LAT_HIST_SUB_COUNT      (1 << LAT_HIST_SUB_BITS)
+#define LAT_HIST_MAX_MSB        (47)
+#define LAT_HIST_BUCKETS        (LAT_HIST_SUB_COUNT * (LAT_HIST_MAX_MSB - LAT_HIST_SUB_BITS + 2))
+
+struct lat_hist {
+    uint64_t epoch;
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+    uint64_t bucket[LAT_HIST_BUCKETS];
+};
+
+inline int lat_hist_index(uint64_t v) {
+    if (v < LAT_HIST_SUB_COUNT)
+        return (int) v;
+    int msb = 63 - __builtin_clzll(v);
+    if (msb > LAT_HIST_MAX_MSB)
+        return LAT_HIST_BUCKETS - 1;
+    int shift = msb - LAT_HIST_SUB_BITS;
+    return LAT_HIST_SUB_COUNT * (shift + 1) + (int) ((v >> shift) - LAT_HIST_SUB_COUNT);
+}
+
+/* largest value that falls into bucket @idx */
+inline uint64_t lat_hist_bucket_high(int idx) {
+    if (idx < LAT_HIST_SUB_COUNT)
+        return idx;
+    int shift = idx / LAT_HIST_SUB_COUNT - 1;
+    uint64_t low = (uint64_t) (LAT_HIST_SUB_COUNT + idx % LAT_HIST_SUB_COUNT) << shift;
+    return low + (1ULL << shift) - 1;
+}
+
+inline void lat_hist_clear(lat_hist *h, uint64_t epoch) {
+    memset(h, 0, sizeof(*h));
+    h->epoch = epoch;
+}
+
+inline void lat_hist_record(lat_hist *h, uint64_t epoch, uint64_t v) {
+    if (h->epoch != epoch)
+        lat_hist_clear(h, epoch);
+    h->bucket[lat_hist_index(v)]++;
+    h->count++;
+    h->sum += v;
+    if (v > h->max)
+        h->max = v;
+}
+
+/* add @src to @dst, both taken as of @epoch */
+inline void lat_hist_merge(lat_hist *dst, const lat_hist *src, uint64_t epoch) {
+    if (dst->epoch != epoch)
+        lat_hist_clear(dst, epoch);
+    if (src->epoch != epoch || src->count == 0)
+        return;
+    for (int i = 0; i < LAT_HIST_BUCKETS; i++)
+        dst->bucket[i] += src->bucket[i];
+    dst->count += src->count;
+    dst->sum += src->sum;
+    if (src->max > dst->max)
+        dst->max = src->max;
+}
+
+/* upper bound of the bucket holding the @pct percentile, at most the maximum */
+inline uint64_t lat_hist_percentile(const lat_hist *h, double pct) {
+    if (h->count == 0)
+        return 0;
+    uint64_t rank = (uint64_t) ceil(pct / 100.0 * h->count);
+    if (rank == 0)
+        rank = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < LAT_HIST_BUCKETS; i++) {
+        seen += h->bucket[i];
+        if (seen >= rank)
+            return lat_hist_bucket_high(i) < h->max ? lat_hist_bucket_high(i) : h->max;
+    }
+    return h->max;
+}
+
+#endif
@@ -1,6 +1,19 @@
+#include <thread>
+
 #include "simulator_clock.h"
 #define SIM_DEBUG false
 
+/* slot of the agent running on this thread, set when it enqueues an event */
+static thread_local int sim_clock_my_slot = -1;
+
+static inline void sim_clock_relax(){
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#else
+    std::this_thread::yield();
+#endif
+}
+
 sim_clock::sim_clock(int64_t init_time, int worker_num){
     time_tick = init_time;
     total_worker_num = worker_num;
@@ -10,343 +23,261 @@ sim_clock::sim_clock(int64_t init_time, int worker_num){
     terminate_flag = false;
     next_time_door = 0;
     next_time_exist = false;
-    event_queue = std::priority_queue<T_event_time, std::vector<T_event_time>, Customcompare>();
+    for (int i = 0; i < SIM_CLOCK_NR_SLOTS; i++)
+        slots[i].f_time = SIM_CLOCK_NO_EVENT;
+    slot_hi = SIM_CLOCK_PROMOTION_SLOT + 1;
+    parked_waiters = 0;
+    driver_parked = false;
 }
 
 int64_t sim_clock::get_time_sim(){
-    int64_t ans;
-    //clock_mutex.lock();
-    ans = time_tick;
-    //clock_mutex.unlock();
-    return ans;
+    return time_tick.load(std::memory_order_acquire);
 }
 
-void sim_clock::enqueue_future_time(int64_t f_time, ThreadType thre_t, int core_id){
+void sim_clock::set_time_sim(int64_t t){
+    time_tick.store(t, std::memory_order_release);
+}
+
+int sim_clock::slot_of(ThreadType thre_t, int core_id){
+    if (thre_t == Ftl_thread)
+        return SIM_CLOCK_FTL_SLOT;
+    if (thre_t == Page_promotion_thread)
+        return SIM_CLOCK_PROMOTION_SLOT;
+    assert(core_id >= 0 && core_id < SIM_CLOCK_MAX_WORKERS);
+    int slot = SIM_CLOCK_PROMOTION_SLOT + 1 + core_id;
+    int hi = slot_hi.load();
+    while (hi <= slot && !slot_hi.compare_exchange_weak(hi, slot + 1))
+        ;
+    return slot;
+}
+
+void sim_clock::set_waiting(ThreadType thre_t, bool waiting){
     if (thre_t == Traceworker)
-    {
-        waiting_worker_m.lock();
-        waiting_worker_num++;
-        queue_mutex.lock();
-        T_event_time next_e = {thre_t, f_time};
-#if SIM_DEBUG
-        std::cout<<"New event is enqueued: time: "<<f_time<<", threadType=Traceworker, "<<"core_id = "<<core_id<<"."<<std::endl;
-        std::cout<<"Current waiting worker number = "<<waiting_worker_num<<std::endl;
-#endif
-        event_queue.push(next_e);
-        queue_mutex.unlock();
-        waiting_worker_m.unlock();
-    }
+        waiting_worker_num += waiting ? 1 : -1;
     else if (thre_t == Ftl_thread)
-    {
-        waiting_worker_m.lock();
-        assert(ftl_thread_waiting == false);
-        ftl_thread_waiting = true;
-        queue_mutex.lock();
-        T_event_time next_e = {thre_t, f_time};
+        ftl_thread_waiting = waiting;
+    else
+        promotion_thread_waiting = waiting;
+}
+
+bool sim_clock::all_waiting(){
+    return waiting_worker_num.load() == total_worker_num && ftl_thread_waiting.load() &&
+           promotion_thread_waiting.load();
+}
+
+// wake the driver if it parked waiting for the agents, the counters are already updated
+void sim_clock::wake_driver(){
+    if (driver_parked.load()) {
+        std::lock_guard<std::mutex> guard(workers_mutex);
+        workers_cv.notify_one();
+    }
+}
+
+// wake the agents parked in wait_for_futuretime, the slots and clock are already updated
+void sim_clock::wake_waiters(){
+    if (parked_waiters.load() > 0) {
+        std::lock_guard<std::mutex> guard(clock_mutex);
+        clock_cv.notify_all();
+    }
+}
+
+/* block until every agent waits, returns false once the clock is terminated */
+bool sim_clock::wait_for_all_workers(){
+    for (int i = 0; i < SIM_CLOCK_SPIN_ITERS; i++) {
+        if (all_waiting() || terminate_flag.load())
+            return !terminate_flag.load();
+        sim_clock_relax();
+    }
+    std::unique_lock<std::mutex> lk(workers_mutex);
+    driver_parked = true;
+    workers_cv.wait(lk, [this]{return all_waiting() || terminate_flag.load();});
+    driver_parked = false;
+    return !terminate_flag.load();
+}
+
+int64_t sim_clock::min_event_time(){
+    int64_t next_time = SIM_CLOCK_NO_EVENT;
+    int hi = slot_hi.load();
+    for (int i = 0; i < hi; i++)
+        next_time = std::min(next_time, slots[i].f_time.load(std::memory_order_acquire));
+    return next_time;
+}
+
+/* release every agent whose event is at next_time */
+void sim_clock::pop_events(int64_t next_time){
+    int hi = slot_hi.load();
+    for (int i = 0; i < hi; i++) {
+        int64_t t = next_time;
+        if (!slots[i].f_time.compare_exchange_strong(t, SIM_CLOCK_NO_EVENT))
+            continue;
+        ThreadType th_t = i == SIM_CLOCK_FTL_SLOT ? Ftl_thread :
+                          i == SIM_CLOCK_PROMOTION_SLOT ? Page_promotion_thread : Traceworker;
+        set_waiting(th_t, false);
 #if SIM_DEBUG
-        std::cout<<"New event is enqueued: time: "<<f_time<<", threadType=Ftl."<<std::endl;
-        std::cout<<"Now the ftl_thread is waiting."<<std::endl;
+        std::cout<<"The event of slot "<<i<<" at "<<next_time<<" is dequeued, now the waiting worker num is "<<waiting_worker_num<<std::endl;
 #endif
-        event_queue.push(next_e);
-        queue_mutex.unlock();
-        waiting_worker_m.unlock();
     }
-    else
-    {
-        waiting_worker_m.lock();
+}
+
+void sim_clock::enqueue_future_time(int64_t f_time, ThreadType thre_t, int core_id){
+    if (thre_t == Ftl_thread)
+        assert(ftl_thread_waiting == false);
+    else if (thre_t == Page_promotion_thread)
         assert(promotion_thread_waiting == false);
-        promotion_thread_waiting = true;
-        queue_mutex.lock();
-        T_event_time next_e = {thre_t, f_time};
+
+    int slot = slot_of(thre_t, core_id);
+    int64_t prev = slots[slot].f_time.exchange(f_time);
+    assert(prev == SIM_CLOCK_NO_EVENT);
+    (void) prev;
+    sim_clock_my_slot = slot;
 #if SIM_DEBUG
-        std::cout<<"New event is enqueued: time: "<<f_time<<", threadType=Page_promotion."<<std::endl;
-        std::cout<<"Now the promotion_thread is waiting."<<std::endl;
+    std::cout<<"New event is enqueued: time: "<<f_time<<", slot = "<<slot<<", core_id = "<<core_id<<"."<<std::endl;
 #endif
-        event_queue.push(next_e);
-        queue_mutex.unlock();
-        waiting_worker_m.unlock();
-    } 
-    workers_cv.notify_one();
+    // the slot is published before the agent counts as waiting
+    set_waiting(thre_t, true);
+    wake_driver();
 }
 
 
 void sim_clock::check_pop_and_incre_time(){
 
-    //First hold the wait locks
-    std::unique_lock lk(waiting_worker_m);
-    workers_cv.wait(lk, [this]{return ((waiting_worker_num == total_worker_num && ftl_thread_waiting && promotion_thread_waiting) || terminate_flag);});
-
-    if (!terminate_flag)
-    {
-
-        //Then check
-        assert (waiting_worker_num == total_worker_num && ftl_thread_waiting && promotion_thread_waiting);
-        // {
-        int64_t next_time;
-        ThreadType th_t;
-        queue_mutex.lock();
-        next_time = event_queue.top().f_time;
-        assert(next_time > time_tick);
+    if (!wait_for_all_workers())
+        return;
 
-        while (!event_queue.empty() && event_queue.top().f_time == next_time)
-        {
-            th_t = event_queue.top().t_type;
-            event_queue.pop();
-            if (th_t == Traceworker)
-            {
-                waiting_worker_num--;
-    #if SIM_DEBUG
-                std::cout<<"The event from a trace worker is dequeued, now the waiting worker num is "<<waiting_worker_num<<std::endl;
-    #endif
-            }
-            else if (th_t == Ftl_thread)
-            {
-                ftl_thread_waiting = false;
-    #if SIM_DEBUG
-                std::cout<<"The event from ftl_thread is dequeued, now the ftl_thread is not waiting."<<std::endl;
-    #endif
-            }
-            else
-            {
-                promotion_thread_waiting = false;
-    #if SIM_DEBUG
-                std::cout<<"The event from promotion thread is dequeued, now the promotion thread is not waiting."<<std::endl;
-    #endif
-            }
-        }
-        
-        clock_mutex.lock();
-        assert(next_time > time_tick);
-        time_tick = next_time;
-    #if SIM_DEBUG
-        std::cout<<"The time is changed to "<<next_time<<std::endl;
-    #endif
-        clock_mutex.unlock();
-        queue_mutex.unlock();
-
-        //Release the locks
-        lk.unlock();
-        clock_cv.notify_all();
+    int64_t next_time = min_event_time();
+    assert(next_time != SIM_CLOCK_NO_EVENT && next_time > time_tick);
 
-    }
+    // agents are released before the clock moves, so none re-enqueues into an occupied slot
+    pop_events(next_time);
+    time_tick.store(next_time);
+#if SIM_DEBUG
+    std::cout<<"The time is changed to "<<next_time<<std::endl;
+#endif
+    wake_waiters();
 }
 
 
 void sim_clock::wait_for_futuretime(int64_t f_time, int core_id){
-    std::unique_lock lk(clock_mutex);
-    clock_cv.wait(lk, [this, f_time]{ return this->time_tick >= f_time; });
-    lk.unlock();
+    int slot = sim_clock_my_slot;
+    assert(slot >= 0);
+    // done once the driver popped the event and the clock reached it
+    auto released = [this, slot, f_time]{
+        return slots[slot].f_time.load() == SIM_CLOCK_NO_EVENT && time_tick.load() >= f_time;
+    };
+
+    for (int i = 0; i < SIM_CLOCK_SPIN_ITERS; i++) {
+        if (released())
+            break;
+        sim_clock_relax();
+    }
+    if (!released()) {
+        std::unique_lock<std::mutex> lk(clock_mutex);
+        parked_waiters++;
+        clock_cv.wait(lk, released);
+        parked_waiters--;
+    }
 #if SIM_DEBUG
     print_mutex.lock();
     std::cout<<"Core_id: "<<core_id<<", Now the waiting for time: "<<f_time<<" is released!"<<std::endl;
     print_mutex.unlock();
 #endif
-    //clock_cv.notify_all();
 }
 
 
+/**
+ * Called by the macsim main loop once per cycle, where macsim itself advances
+ * the clock. Once every agent waits, releases the ones whose event is due.
+ * Returns the time all agents sleep until when each of them is blocked on a
+ * future event (SIM_CLOCK_NO_EVENT if none has one), so the caller may skip
+ * ahead to it, 0 otherwise.
+ */
+int64_t sim_clock::check_pop_and_incre_time_macsim(int64_t cur_time){
 
-void sim_clock::check_pop_and_incre_time_macsim(int64_t cur_time){
-
-    //First hold the wait locks
     if (next_time_exist)
     {
         if (cur_time < next_time_door)
         {
-            return;
+            return next_time_door;
         }
         else
         {
             next_time_exist = false;
         }
     }
-    
-    std::unique_lock lk(waiting_worker_m);
-    workers_cv.wait(lk, [this]{return ((waiting_worker_num == total_worker_num && ftl_thread_waiting && promotion_thread_waiting) || terminate_flag);});
 
-    if (!terminate_flag)
-    {
-
-        //Then check
-        assert (waiting_worker_num == total_worker_num && ftl_thread_waiting && promotion_thread_waiting);
-        // {
-        int64_t next_time;
-        ThreadType th_t;
-        queue_mutex.lock();
-        next_time = event_queue.top().f_time;
-        if (time_tick < next_time)
-        {
-            queue_mutex.unlock();
-            lk.unlock();
-            next_time_door = next_time;
-            next_time_exist = true;
-            return;
-        }
-        else
-        {
-             while (!event_queue.empty() && event_queue.top().f_time == next_time)
-            {
-                th_t = event_queue.top().t_type;
-                event_queue.pop();
-                if (th_t == Traceworker)
-                {
-                    waiting_worker_num--;
-        #if SIM_DEBUG
-                    std::cout<<"The event from a trace worker is dequeued, now the waiting worker num is "<<waiting_worker_num<<std::endl;
-        #endif
-                }
-                else if (th_t == Ftl_thread)
-                {
-                    ftl_thread_waiting = false;
-        #if SIM_DEBUG
-                    std::cout<<"The event from ftl_thread is dequeued, now the ftl_thread is not waiting."<<std::endl;
-        #endif
-                }
-                else
-                {
-                    promotion_thread_waiting = false;
-        #if SIM_DEBUG
-                    std::cout<<"The event from promotion thread is dequeued, now the promotion thread is not waiting."<<std::endl;
-        #endif
-                }
-            }
-        //     clock_mutex.lock();
-        //     assert(next_time > time_tick);
-        //     time_tick = next_time;
-        // #if SIM_DEBUG
-        //     std::cout<<"The time is changed to "<<next_time<<std::endl;
-        // #endif
-        //     clock_mutex.unlock();
-            queue_mutex.unlock();
-            next_time_exist = false;
-
-            //Release the locks
-            lk.unlock();
-            clock_cv.notify_all();
-        }
+    if (!wait_for_all_workers())
+        return 0;
 
+    int64_t next_time = min_event_time();
+    if (next_time == SIM_CLOCK_NO_EVENT)
+        return SIM_CLOCK_NO_EVENT;
+    if (time_tick < next_time)
+    {
+        next_time_door = next_time;
+        next_time_exist = true;
+        return next_time;
     }
+
+    pop_events(next_time);
+    next_time_exist = false;
+    wake_waiters();
+    return 0;
 }
 
 
 
 
 int sim_clock::give_queue_size(){
-    int size;
-    queue_mutex.lock();
-    size = (int)(event_queue.size());
-    queue_mutex.unlock();
+    int size = 0;
+    int hi = slot_hi.load();
+    for (int i = 0; i < hi; i++)
+        size += slots[i].f_time.load() != SIM_CLOCK_NO_EVENT;
     return size;
 }
 
 
 void sim_clock::wait_without_events(ThreadType thre_t, int core_id){
-    if (thre_t == Traceworker)
-    {
-        waiting_worker_m.lock();
-        waiting_worker_num++;
-#if SIM_DEBUG
-        print_mutex.lock();
-        std::cout<<"Core_id: "<<core_id<<", A trace worker is waiting without events now! Now the waiting worker number is "<<waiting_worker_num<<std::endl;
-        print_mutex.unlock();
-#endif
-        waiting_worker_m.unlock();
-    }
-    else if (thre_t == Ftl_thread)
-    {
-        waiting_worker_m.lock();
-        ftl_thread_waiting = true;
-#if SIM_DEBUG
-        print_mutex.lock();
-        std::cout<<"The ftl_thread is waiting without events now!"<<std::endl;
-        print_mutex.unlock();
-#endif
-        waiting_worker_m.unlock();
-    }
-    else
-    {
-        waiting_worker_m.lock();
-        promotion_thread_waiting = true;
+    set_waiting(thre_t, true);
 #if SIM_DEBUG
-        print_mutex.lock();
-        std::cout<<"The page promotion thread is waiting without events now!"<<std::endl;
-        print_mutex.unlock();
+    print_mutex.lock();
+    std::cout<<"Core_id: "<<core_id<<", thread type "<<thre_t<<" is waiting without events now! Now the waiting worker number is "<<waiting_worker_num<<std::endl;
+    print_mutex.unlock();
 #endif
-        waiting_worker_m.unlock();
-    }
-    workers_cv.notify_one();
+    wake_driver();
 }
 
 
 void sim_clock::release_without_events(ThreadType thre_t, int core_id){
-    if (thre_t == Traceworker)
-    {
-        waiting_worker_m.lock();
-        waiting_worker_num--;
+    set_waiting(thre_t, false);
 #if SIM_DEBUG
-        print_mutex.lock();
-        std::cout<<"Core_id: "<<core_id<<", A trace worker is released without events now! Now the waiting worker number is "<<waiting_worker_num<<std::endl;
-        print_mutex.unlock();
-#endif
-        waiting_worker_m.unlock();
-    }
-    else if (thre_t == Ftl_thread)
-    {
-        waiting_worker_m.lock();
-        ftl_thread_waiting = false;
-#if SIM_DEBUG
-        print_mutex.lock();
-        std::cout<<"The ftl_thread is released without events now!"<<std::endl;
-        print_mutex.unlock();
-#endif
-        waiting_worker_m.unlock();
-    }
-    else
-    {
-        waiting_worker_m.lock();
-        promotion_thread_waiting = false;
-#if SIM_DEBUG
-        print_mutex.lock();
-        std::cout<<"The promotion thread is released without events now!"<<std::endl;
-        print_mutex.unlock();
+    print_mutex.lock();
+    std::cout<<"Core_id: "<<core_id<<", thread type "<<thre_t<<" is released without events now! Now the waiting worker number is "<<waiting_worker_num<<std::endl;
+    print_mutex.unlock();
 #endif
-        waiting_worker_m.unlock();
-    }
-    workers_cv.notify_one();
 }
 
 void sim_clock::force_finish(){
+    // the clock ends at the latest pending event
     int64_t next_time = time_tick;
-     while (!event_queue.empty())
-            {
-                ThreadType th_t = event_queue.top().t_type;
-                next_time = event_queue.top().f_time;
-                event_queue.pop();
-                if (th_t == Traceworker)
-                {
-                    waiting_worker_num--;
-        #if SIM_DEBUG
-                    std::cout<<"The event from a trace worker is dequeued, now the waiting worker num is "<<waiting_worker_num<<std::endl;
-        #endif
-                }
-                else if (th_t == Ftl_thread)
-                {
-                    ftl_thread_waiting = false;
-        #if SIM_DEBUG
-                    std::cout<<"The event from ftl_thread is dequeued, now the ftl_thread is not waiting."<<std::endl;
-        #endif
-                }
-                else
-                {
-                    promotion_thread_waiting = false;
-        #if SIM_DEBUG
-                    std::cout<<"The event from promotion thread is dequeued, now the promotion thread is not waiting."<<std::endl;
-        #endif
-                }
-            }
-
-    clock_mutex.lock();
+    bool has_event = false;
+    int hi = slot_hi.load();
+    for (int i = 0; i < hi; i++) {
+        int64_t t = slots[i].f_time.load();
+        if (t != SIM_CLOCK_NO_EVENT) {
+            next_time = has_event ? std::max(next_time, t) : t;
+            has_event = true;
+        }
+    }
+    // release every pending event in time order, as popping them one by one would
+    for (int64_t t = min_event_time(); t != SIM_CLOCK_NO_EVENT; t = min_event_time())
+        pop_events(t);
+
     time_tick = next_time;
-    clock_mutex.unlock();
-    clock_cv.notify_all();
-}
\ No newline at end of file
+    wake_waiters();
+}
+
+void sim_clock::terminate(){
+    terminate_flag = true;
+    std::lock_guard<std::mutex> guard(workers_mutex);
+    workers_cv.notify_all();
+}
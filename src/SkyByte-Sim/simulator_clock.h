@@ -7,8 +7,9 @@
 #include <pthread.h>
 #include <time.h>
 #include <mutex>
-#include <queue>
+#include <atomic>
 #include <condition_variable>
+#include <cstdint>
 
 #include "timing_model.h"
 #include "ftl_mapping.h"
@@ -24,52 +25,75 @@ enum ThreadType{
     Traceworker, Ftl_thread, Page_promotion_thread
 };
 
-struct T_event_time{
-    ThreadType t_type;
-    int64_t f_time;
+/* agent slots: the FTL and promotion threads, then one per trace worker core id */
+#define SIM_CLOCK_FTL_SLOT          (0)
+#define SIM_CLOCK_PROMOTION_SLOT    (1)
+#define SIM_CLOCK_MAX_WORKERS       (256)
+#define SIM_CLOCK_NR_SLOTS          (SIM_CLOCK_MAX_WORKERS + 2)
+/* slot holding no pending event */
+#define SIM_CLOCK_NO_EVENT          INT64_MAX
+/* polls before a waiter parks on its condition variable */
+#define SIM_CLOCK_SPIN_ITERS        (4096)
+
+/* next-event time of one agent, on its own cache line */
+struct alignas(64) sim_clock_slot {
+    std::atomic<int64_t> f_time;
 };
 
-struct Customcompare
-{
-    bool operator()(const T_event_time l, const T_event_time r) const { return l.f_time > r.f_time; }
-};
-
-
+/**
+ * Barrier-style global clock. Each agent (trace worker, FTL thread, promotion
+ * thread) publishes the time it sleeps until in its own slot and counts itself
+ * waiting; once every agent waits, the driver takes the minimum over the slots,
+ * releases the agents at that time and advances the clock. Agents and the
+ * driver spin on the atomics for a while before parking, so the common short
+ * waits never touch a mutex.
+ */
 class sim_clock{
 
     public:
-    int64_t time_tick;
+    std::atomic<int64_t> time_tick;
 
     int64_t next_time_door;
     bool next_time_exist;
 
     int total_worker_num;
-    int waiting_worker_num;
-    std::mutex waiting_worker_m;
-
-    bool ftl_thread_waiting;
-    std::mutex ftl_thread_m;
-    bool promotion_thread_waiting;
-    std::mutex promotion_thrad_m;
-    bool terminate_flag;
+    std::atomic<int> waiting_worker_num;
+    std::atomic<bool> ftl_thread_waiting;
+    std::atomic<bool> promotion_thread_waiting;
+    std::atomic<bool> terminate_flag;
 
     sim_clock(int64_t init_time, int worker_num);
     std::mutex clock_mutex;
     std::condition_variable clock_cv;
     std::mutex workers_mutex;
     std::condition_variable workers_cv;
-    std::priority_queue<T_event_time, std::vector<T_event_time>, Customcompare> event_queue; 
-    std::mutex queue_mutex;
     std::mutex print_mutex;
     int64_t get_time_sim();
+    void set_time_sim(int64_t t);
     void enqueue_future_time(int64_t f_time, ThreadType thre_t, int core_id);
     void check_pop_and_incre_time();
-    void check_pop_and_incre_time_macsim(int64_t cur_time);
+    int64_t check_pop_and_incre_time_macsim(int64_t cur_time);
     void wait_for_futuretime(int64_t f_time, int core_id);
     int give_queue_size();
     void wait_without_events(ThreadType thre_t, int core_id);
     void release_without_events(ThreadType thre_t, int core_id);
     void force_finish();
+    void terminate();
+
+    private:
+    sim_clock_slot slots[SIM_CLOCK_NR_SLOTS];
+    std::atomic<int> slot_hi;               /* one past the highest slot ever used */
+    std::atomic<int> parked_waiters;        /* agents sleeping on clock_cv */
+    std::atomic<bool> driver_parked;        /* driver sleeping on workers_cv */
+
+    int slot_of(ThreadType thre_t, int core_id);
+    void set_waiting(ThreadType thre_t, bool waiting);
+    bool all_waiting();
+    bool wait_for_all_workers();
+    int64_t min_event_time();
+    void pop_events(int64_t next_time);
+    void wake_driver();
+    void wake_waiters();
 };
 
 
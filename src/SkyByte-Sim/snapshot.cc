@@ -0,0 +1,142 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "bytefs_utils.h"
+#include "snapshot.h"
+
+// zlib takes 32-bit lengths
+static uint32_t snapshot_crc(const void *buf, uint64_t bytes) {
+    uLong crc = crc32(0L, Z_NULL, 0);
+    const Bytef *p = (const Bytef *) buf;
+    while (bytes > 0) {
+        uInt chunk = bytes > (1U << 30) ? (1U << 30) : (uInt) bytes;
+        crc = crc32(crc, p, chunk);
+        p += chunk;
+        bytes -= chunk;
+    }
+    return (uint32_t) crc;
+}
+
+void snapshot_add(snapshot_writer *w, uint32_t id, std::vector<uint64_t> &&data) {
+    w->sections.emplace_back(id, std::move(data));
+}
+
+bool snapshot_save(snapshot_writer *w, const std::string &path) {
+    std::vector<snapshot_section> table(w->sections.size());
+    uint64_t offset = sizeof(snapshot_header) + table.size() * sizeof(snapshot_section);
+    for (size_t i = 0; i < table.size(); i++) {
+        const std::vector<uint64_t> &data = w->sections[i].second;
+        table[i].id = w->sections[i].first;
+        table[i].crc = snapshot_crc(data.data(), data.size() * sizeof(uint64_t));
+        table[i].offset = offset;
+        table[i].len = data.size();
+        offset += data.size() * sizeof(uint64_t);
+    }
+
+    snapshot_header hdr;
+    hdr.magic = SNAPSHOT_MAGIC;
+    hdr.version = SNAPSHOT_VERSION;
+    hdr.nr_sections = table.size();
+    hdr.table_crc = snapshot_crc(table.data(), table.size() * sizeof(snapshot_section));
+    hdr.reserved = 0;
+
+    // per process, runs of a batch may save the same snapshot at once
+    std::string tmp_path = path + ".tmp." + std::to_string(getpid());
+    FILE *out = fopen(tmp_path.c_str(), "wb");
+    if (out == NULL) {
+        bytefs_err("Cannot create snapshot %s", tmp_path.c_str());
+        return false;
+    }
+    bool ok = fwrite(&hdr, sizeof(hdr), 1, out) == 1 &&
+              fwrite(table.data(), sizeof(snapshot_section), table.size(), out) == table.size();
+    for (size_t i = 0; ok && i < w->sections.size(); i++) {
+        const std::vector<uint64_t> &data = w->sections[i].second;
+        ok = fwrite(data.data(), sizeof(uint64_t), data.size(), out) == data.size();
+    }
+    ok = fclose(out) == 0 && ok;
+    if (!ok || rename(tmp_path.c_str(), path.c_str()) != 0) {
+        bytefs_err("Writing snapshot %s failed", path.c_str());
+        unlink(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool snapshot_load(snapshot_file *s, const std::string &path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (uint64_t) st.st_size < sizeof(snapshot_header)) {
+        close(fd);
+        return false;
+    }
+    void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return false;
+    madvise(map, st.st_size, MADV_WILLNEED);
+
+    s->map = map;
+    s->map_len = st.st_size;
+    s->hdr = (const snapshot_header *) map;
+    s->table = (const snapshot_section *) (s->hdr + 1);
+
+    const char *why = nullptr;
+    uint64_t table_end = sizeof(snapshot_header) + (uint64_t) s->hdr->nr_sections * sizeof(snapshot_section);
+    if (s->hdr->magic != SNAPSHOT_MAGIC)
+        why = "not a snapshot";
+    else if (s->hdr->version != SNAPSHOT_VERSION)
+        why = "unsupported version";
+    else if (table_end > s->map_len)
+        why = "truncated";
+    else if (snapshot_crc(s->table, table_end - sizeof(snapshot_header)) != s->hdr->table_crc)
+        why = "section table checksum mismatch";
+    for (uint32_t i = 0; why == nullptr && i < s->hdr->nr_sections; i++) {
+        const snapshot_section *sec = &s->table[i];
+        if (sec->offset % sizeof(uint64_t) != 0 || sec->offset < table_end || sec->offset > s->map_len ||
+            sec->len > (s->map_len - sec->offset) / sizeof(uint64_t))
+            why = "truncated";
+        else if (snapshot_crc((const char *) map + sec->offset, sec->len * sizeof(uint64_t)) != sec->crc)
+            why = "section checksum mismatch";
+    }
+    if (why != nullptr) {
+        bytefs_err("Ignoring snapshot %s: %s", path.c_str(), why);
+        snapshot_unload(s);
+        return false;
+    }
+    return true;
+}
+
+const uint64_t *snapshot_section_data(snapshot_file *s, uint32_t id, uint64_t *len) {
+    for (uint32_t i = 0; i < s->hdr->nr_sections; i++) {
+        if (s->table[i].id == id) {
+            *len = s->table[i].len;
+            return (const uint64_t *) ((const char *) s->map + s->table[i].offset);
+        }
+    }
+    *len = 0;
+    return nullptr;
+}
+
+void snapshot_unload(snapshot_file *s) {
+    if (s->map != nullptr)
+        munmap(s->map, s->map_len);
+    s->map = nullptr;
+    s->map_len = 0;
+    s->hdr = nullptr;
+    s->table = nullptr;
+}
+
+bool snapshot_read_text(FILE *in, std::vector<uint64_t> &out, uint64_t n) {
+    for (uint64_t i = 0; i < n; i++) {
+        int64_t v;
+        if (fscanf(in, "%ld", &v) != 1)
+            return false;
+        out.push_back(v);
+    }
+    return true;
+}
@@ -0,0 +1,84 @@
+#ifndef __SNAPSHOT__
+#define __SNAPSHOT__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/*
+ * Binary warmup snapshot: a header, a table of sections and the section
+ * payloads, each an array of 64-bit words. Every section and the table carry
+ * a CRC32, files are mapped read-only and verified before use.
+ */
+#define SNAPSHOT_MAGIC      0x50414e5342594b53ULL   // "SKYBSNAP"
+#define SNAPSHOT_VERSION    1
+#define SNAPSHOT_SUFFIX     ".snap"
+
+enum snapshot_section_id {
+    SNAP_PREFILL_PAGES = 1,     // sorted pages the workload touches
+    SNAP_SSD_CACHE,             // SSD DRAM cache sets, see sa_cache::snapshot
+    SNAP_HOST_DRAM,             // host DRAM tier sets, same layout
+    SNAP_TPP_INACTIVE,          // TPP inactive LRU list
+    SNAP_TPP_ACTIVE,            // TPP active LRU list, tail first
+    SNAP_TPP_NUMA_SCAN,         // TPP NUMA scan set
+    SNAP_WLOG_HINT,             // read pages, written pages, 64 modified-CL buckets
+
+    /* post-warmup checkpoint, see save_warmup_checkpoint */
+    SNAP_CKPT_CONFIG = 32,      // checkpoint key and the raw ssdparams
+    SNAP_CKPT_NAND,             // pages, blocks, superblocks and LUN/channel timelines
+    SNAP_CKPT_GC,               // free and candidate lists, GC heap, counters
+    SNAP_CKPT_MAPTBL,           // mapped (lpn, ppa) pairs
+    SNAP_CKPT_STREAMS,          // write pointers and temperature counters
+    SNAP_CKPT_WLOG,             // log region pointers, live entries and the IMT
+    SNAP_CKPT_SSD_CACHE,        // full SSD DRAM cache state, see sa_cache::checkpoint
+    SNAP_CKPT_HOST_DRAM,        // full host DRAM tier state
+    SNAP_CKPT_TIERS,            // cache_controller counters
+    SNAP_CKPT_HOST_SPACE,       // TPP memory space and NUMA scan state
+    SNAP_CKPT_STAT,             // raw ssd_stat
+    SNAP_CKPT_CLOCK,            // sim_clock time and the PRNG seed of the measured run
+    SNAP_CKPT_LAT_HIST,         // latency histograms, see ssd_stat_lat_checkpoint
+};
+
+struct snapshot_header {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t nr_sections;
+    uint32_t table_crc;         // over the section table
+    uint32_t reserved;
+};
+
+struct snapshot_section {
+    uint32_t id;
+    uint32_t crc;               // over the payload
+    uint64_t offset;            // from the start of the file, 8-byte aligned
+    uint64_t len;               // in 64-bit words
+};
+
+/* sections collected in memory, then written in one go */
+struct snapshot_writer {
+    std::vector<std::pair<uint32_t, std::vector<uint64_t>>> sections;
+};
+
+/* a verified snapshot mapped into memory */
+struct snapshot_file {
+    void *map = nullptr;
+    uint64_t map_len = 0;
+    const snapshot_header *hdr = nullptr;
+    const snapshot_section *table = nullptr;
+};
+
+void snapshot_add(snapshot_writer *w, uint32_t id, std::vector<uint64_t> &&data);
+/* written to a temporary file and renamed, returns false on I/O errors */
+bool snapshot_save(snapshot_writer *w, const std::string &path);
+
+/* false if the file is missing, truncated, of another version or corrupt */
+bool snapshot_load(snapshot_file *s, const std::string &path);
+/* payload of a section, nullptr if the snapshot has none */
+const uint64_t *snapshot_section_data(snapshot_file *s, uint32_t id, uint64_t *len);
+void snapshot_unload(snapshot_file *s);
+
+/* read n whitespace separated integers of a legacy text file */
+bool snapshot_read_text(FILE *in, std::vector<uint64_t> &out, uint64_t n);
+
+#endif
@@ -0,0 +1,131 @@
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+#include "ssd_prefetch.h"
+#include "ssd_stat.h"
+#include "simulator_clock.h"
+
+/* a demand this many pages from a stream's last page still belongs to it */
+#define SSD_PF_WINDOW           (16)
+/* stride repetitions before a stream issues prefetches */
+#define SSD_PF_CONFIDENCE       (2)
+
+bool ssd_prefetch_enable = false;
+int ssd_prefetch_degree = 4;
+int ssd_prefetch_streams = 16;
+
+extern sim_clock* the_clock_pt;
+
+struct pf_stream {
+    int64_t last_page;
+    int64_t stride;
+    int64_t frontier;               // furthest page prefetched along the stride
+    int confidence;
+    uint64_t last_use;
+};
+
+static std::vector<pf_stream> streams;
+static uint64_t stream_clock;
+// prefetched pages no demand has touched yet
+static std::unordered_set<int64_t> pending;
+// recursive, a prefetch may evict a pending page
+static std::recursive_mutex pf_mutex;
+
+static pf_stream *find_stream(int64_t page, int64_t *delta) {
+    pf_stream *best = nullptr;
+    for (pf_stream &s : streams) {
+        int64_t d = page - s.last_page;
+        if (d >= -SSD_PF_WINDOW && d <= SSD_PF_WINDOW &&
+                (best == nullptr || llabs(d) < llabs(*delta))) {
+            best = &s;
+            *delta = d;
+        }
+    }
+    return best;
+}
+
+static pf_stream *alloc_stream(int64_t page) {
+    if (streams.size() < (size_t) ssd_prefetch_streams) {
+        streams.push_back(pf_stream());
+    } else {
+        size_t lru = 0;
+        for (size_t i = 1; i < streams.size(); i++)
+            if (streams[i].last_use < streams[lru].last_use)
+                lru = i;
+        std::swap(streams[lru], streams.back());
+    }
+    pf_stream *s = &streams.back();
+    s->last_page = page;
+    s->stride = 0;
+    s->frontier = page;
+    s->confidence = 0;
+    return s;
+}
+
+/* prefetch up to ssd_prefetch_degree strides ahead of @page, past the frontier */
+static void issue_stream(pf_stream *s, int64_t page, uint64_t now) {
+    int64_t first = page + s->stride;
+    // continue behind pages an earlier round fetched
+    if ((s->stride > 0 && s->frontier >= first) || (s->stride < 0 && s->frontier <= first))
+        first = s->frontier + s->stride;
+    int64_t last = page + s->stride * ssd_prefetch_degree;
+    for (int64_t p = first; s->stride > 0 ? p <= last : p >= last; p += s->stride) {
+        if (p < 0)
+            break;
+        s->frontier = p;
+        if (pending.count(p) || !ssd_prefetch_page(p, now))
+            continue;
+        pending.insert(p);
+        SSD_STAT_ATOMIC_INC(pf_issued);
+    }
+}
+
+void ssd_prefetch_observe(uint64_t lpa, const issue_response *resp) {
+    if (!ssd_prefetch_enable)
+        return;
+    int64_t page = lpa / PG_SIZE;
+    std::lock_guard<std::recursive_mutex> guard(pf_mutex);
+
+    // first demand of a prefetched page, which may meet it already promoted
+    if (resp->flag & (HOST_DRAM_HIT | SSD_CACHE_HIT | SSD_CACHE_MISS | ONGOING_DELAY)) {
+        auto it = pending.find(page);
+        if (it != pending.end()) {
+            pending.erase(it);
+            if (resp->flag & (HOST_DRAM_HIT | SSD_CACHE_HIT)) {
+                SSD_STAT_ATOMIC_INC(pf_useful);
+            } else {
+                SSD_STAT_ATOMIC_INC(pf_late);
+            }
+        }
+    }
+
+    int64_t delta = 0;
+    pf_stream *s = find_stream(page, &delta);
+    if (s == nullptr) {
+        s = alloc_stream(page);
+    } else if (delta != 0) {
+        if (delta == s->stride) {
+            s->confidence++;
+        } else {
+            s->stride = delta;
+            s->frontier = page;
+            s->confidence = 1;
+        }
+        s->last_page = page;
+        if (s->confidence >= SSD_PF_CONFIDENCE)
+            issue_stream(s, page, the_clock_pt->get_time_sim());
+    }
+    s->last_use = ++stream_clock;
+}
+
+void ssd_prefetch_on_evict(int64_t page_index) {
+    std::lock_guard<std::recursive_mutex> guard(pf_mutex);
+    if (pending.erase(page_index))
+        SSD_STAT_ATOMIC_INC(pf_wasted);
+}
+
+void ssd_prefetch_reset_stat(void) {
+    std::lock_guard<std::recursive_mutex> guard(pf_mutex);
+    pending.clear();
+}
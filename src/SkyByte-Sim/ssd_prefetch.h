@@ -0,0 +1,38 @@
+#ifndef __SSD_PREFETCH_H__
+#define __SSD_PREFETCH_H__
+
+#include <stdint.h>
+
+#include "ftl.h"
+
+/*
+ * Page-granular prefetcher of the SSD cache. It watches the demand requests
+ * that miss the host caches and reach the device, keeps a small table of
+ * page streams, and once a stream repeated its page stride fetches the next
+ * ssd_prefetch_degree pages of the stream from NAND into the SSD cache
+ * (insert_nb, ready when the NAND read completes).
+ *
+ * A prefetched page is useful when its first demand hits the cache, late
+ * when the demand finds the NAND read still in flight, and wasted when it
+ * is evicted before any demand touched it.
+ */
+extern bool ssd_prefetch_enable;
+extern int ssd_prefetch_degree;
+extern int ssd_prefetch_streams;
+
+/* after a demand byte_issue() at @lpa answered with @resp */
+void ssd_prefetch_observe(uint64_t lpa, const issue_response *resp);
+void ssd_prefetch_on_evict(int64_t page_index);
+/* forget the outstanding prefetches, they were issued before the stats window */
+void ssd_prefetch_reset_stat(void);
+
+/* called where the SSD cache evicts a page */
+inline void ssd_prefetch_evicted(int64_t page_index) {
+    if (ssd_prefetch_enable)
+        ssd_prefetch_on_evict(page_index);
+}
+
+/* in ftl.cc, false if the page is cached, in flight, or has no data */
+bool ssd_prefetch_page(int64_t page_index, uint64_t stime);
+
+#endif
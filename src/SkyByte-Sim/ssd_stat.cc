@@ -1,4 +1,8 @@
+#include <mutex>
+
 #include "ssd_stat.h"
+#include "ssd_prefetch.h"
+#include "cxl_link.h"
 #include "cache_controller.h"
 
 extern FILE *output_file;
@@ -12,16 +16,309 @@ int64_t evict_mark_count = 0;
 ssd_stat stat;
 int stat_flag = 0;
 
+// latency histograms, zeroed ones (epoch 0) start out stale
+uint64_t stat_epoch = 1;
+thread_local lat_shard *my_lat_shard = nullptr;
+// shards outlive their threads, print_stat merges them all
+static std::vector<lat_shard *> lat_shards;
+static std::mutex lat_shards_mutex;
+
 extern cache_controller* dram_subsystem;
+extern bool multi_stream_enable;
+extern bool nand_timing_detailed;
+extern nand_sched_policy_enum nand_sched_policy;
+extern int ssd_fill_per_channel;
+
+static void reset_repl_stats(void) {
+    if (dram_subsystem == nullptr)
+        return;
+    dram_subsystem->the_cache.reset_repl_stat();
+    dram_subsystem->host_dram.reset_repl_stat();
+}
+
+static void print_repl_stat(const char *tier, sa_cache &cache, int long_field_len) {
+    repl_stat rs = cache.give_repl_stat();
+    int64_t accesses = rs.hits + rs.misses;
+    double hit_ratio = accesses ? (double) rs.hits / accesses : 0;
+    // a dirty eviction writes the whole page back
+    uint64_t flush_traffic = rs.dirty_evictions * PG_SIZE;
+
+    printf("    %s (%s)\n", tier, repl_policy_name(cache.policy));
+    printf("      Hit ratio:            %-*f = Hit: %-*ld / Acc: %-*ld\n",
+            long_field_len, hit_ratio, long_field_len, rs.hits, long_field_len, accesses);
+    printf("      Evictions:            %-*ld = Clean: %-*ld + Dirty: %-*ld\n",
+            long_field_len, rs.clean_evictions + rs.dirty_evictions,
+            long_field_len, rs.clean_evictions, long_field_len, rs.dirty_evictions);
+    printf("      Flush traffic:        %-*lu (dirty lines: %lu)\n",
+            long_field_len, flush_traffic, (uint64_t) rs.dirty_cl_evicted);
+
+    fprintf(output_file, "%s replacement (%s)\n", tier, repl_policy_name(cache.policy));
+    fprintf(output_file, "    Hit ratio:              %f\n", hit_ratio);
+    fprintf(output_file, "    Hits:                   %-*ld\n", long_field_len, rs.hits);
+    fprintf(output_file, "    Misses:                 %-*ld\n", long_field_len, rs.misses);
+    fprintf(output_file, "    Clean evictions:        %-*ld\n", long_field_len, rs.clean_evictions);
+    fprintf(output_file, "    Dirty evictions:        %-*ld\n", long_field_len, rs.dirty_evictions);
+    fprintf(output_file, "    Dirty lines evicted:    %-*ld\n", long_field_len, rs.dirty_cl_evicted);
+    fprintf(output_file, "    Flush traffic:          %-*lu\n", long_field_len, flush_traffic);
+}
+
+static void print_fill_stat(int long_field_len) {
+    uint64_t fills = stat.fill_issued.load();
+    uint64_t delayed = stat.fill_delayed.load();
+    double avg_depth = fills ? (double) stat.fill_depth_sum.load() / fills : 0;
+    double avg_wait = delayed ? (double) stat.fill_wait_ns.load() / delayed : 0;
+
+    printf("  SSD cache fills (%d per channel)\n", ssd_fill_per_channel);
+    printf("    NAND fills:             %-*lu Merged misses: %lu\n",
+            long_field_len, fills, stat.fill_merged.load());
+    printf("    Delayed fills:          %-*lu Avg wait: %.1f ns\n", long_field_len, delayed, avg_wait);
+    printf("    Channel queue depth:    avg %.2f, max %lu\n", avg_depth, stat.fill_depth_max.load());
+
+    fprintf(output_file, "SSD cache fills\n");
+    fprintf(output_file, "    NAND fills:             %-*lu\n", long_field_len, fills);
+    fprintf(output_file, "    Merged misses:          %-*lu\n", long_field_len, stat.fill_merged.load());
+    fprintf(output_file, "    Delayed fills:          %-*lu\n", long_field_len, delayed);
+    fprintf(output_file, "    Avg fill wait (ns):     %f\n", avg_wait);
+    fprintf(output_file, "    Avg queue depth:        %f\n", avg_depth);
+    fprintf(output_file, "    Max queue depth:        %-*lu\n", long_field_len, stat.fill_depth_max.load());
+}
+
+static void print_cxl_stat(int long_field_len) {
+    uint64_t msgs = stat.cxl_msgs.load();
+    double avg_link = msgs ? (double) stat.cxl_link_ns.load() / msgs : 0;
+    double avg_queue = msgs ? (double) stat.cxl_queue_ns.load() / msgs : 0;
+    uint64_t m2s_bytes = stat.cxl_m2s_slots.load() * CXL_SLOT_BYTES;
+    uint64_t s2m_bytes = stat.cxl_s2m_slots.load() * CXL_SLOT_BYTES;
+
+    printf("  CXL link (gen %d x%d, %d credits)\n", cxl_link_gen, cxl_link_lanes, cxl_link_credits);
+    printf("    Accesses:               %-*lu Credit stalls: %lu\n",
+            long_field_len, msgs, stat.cxl_credit_stalls.load());
+    printf("    Avg link latency:       %-*.1f Avg queueing: %.1f ns\n", long_field_len, avg_link, avg_queue);
+    printf("    Slot bytes:             M2S %lu, S2M %lu\n", m2s_bytes, s2m_bytes);
+
+    fprintf(output_file, "CXL link\n");
+    fprintf(output_file, "    Accesses:               %-*lu\n", long_field_len, msgs);
+    fprintf(output_file, "    Avg link latency (ns):  %f\n", avg_link);
+    fprintf(output_file, "    Avg queueing (ns):      %f\n", avg_queue);
+    fprintf(output_file, "    Credit stalls:          %-*lu\n", long_field_len, stat.cxl_credit_stalls.load());
+    fprintf(output_file, "    M2S slot bytes:         %-*lu\n", long_field_len, m2s_bytes);
+    fprintf(output_file, "    S2M slot bytes:         %-*lu\n", long_field_len, s2m_bytes);
+}
+
+static void print_prefetch_stat(int long_field_len) {
+    uint64_t issued = stat.pf_issued.load();
+    uint64_t useful = stat.pf_useful.load();
+    uint64_t late = stat.pf_late.load();
+    uint64_t wasted = stat.pf_wasted.load();
+    // a stat reset can leave pages issued before it to be counted after
+    uint64_t settled = useful + late + wasted;
+    uint64_t pending = issued > settled ? issued - settled : 0;
+    // demand flash misses are the ones prefetching did not cover
+    uint64_t demand_misses = stat.total_flash_miss_num.load();
+    double accuracy = issued ? (double) (useful + late) / issued : 0;
+    double coverage = useful + late + demand_misses ?
+            (double) (useful + late) / (useful + late + demand_misses) : 0;
+    double timeliness = useful + late ? (double) useful / (useful + late) : 0;
+
+    printf("  SSD prefetch (degree %d, %d streams)\n", ssd_prefetch_degree, ssd_prefetch_streams);
+    printf("    Prefetches:             %-*lu = Useful: %-*lu + Late: %-*lu + Wasted: %-*lu + Pending: %lu\n",
+            long_field_len, issued, long_field_len, useful, long_field_len, late,
+            long_field_len, wasted, pending);
+    printf("    Accuracy:               %-*f Coverage: %-*f Timeliness: %f\n",
+            long_field_len, accuracy, long_field_len, coverage, timeliness);
+
+    fprintf(output_file, "SSD prefetch\n");
+    fprintf(output_file, "    Prefetches:             %-*lu\n", long_field_len, issued);
+    fprintf(output_file, "    Useful:                 %-*lu\n", long_field_len, useful);
+    fprintf(output_file, "    Late:                   %-*lu\n", long_field_len, late);
+    fprintf(output_file, "    Wasted NAND reads:      %-*lu\n", long_field_len, wasted);
+    fprintf(output_file, "    Accuracy:               %f\n", accuracy);
+    fprintf(output_file, "    Coverage:               %f\n", coverage);
+    fprintf(output_file, "    Timeliness:             %f\n", timeliness);
+}
+
+lat_shard *lat_shard_register(void) {
+    lat_shard *shard = (lat_shard *) calloc(1, sizeof(lat_shard));
+    bytefs_assert(shard);
+    std::lock_guard<std::mutex> guard(lat_shards_mutex);
+    lat_shards.push_back(shard);
+    return shard;
+}
+
+void ssd_stat_record_issue(const issue_response *resp) {
+    switch (resp->flag) {
+    case HOST_DRAM_HIT:     ssd_stat_record_lat(LAT_HOST_DRAM_HIT, resp->latency); break;
+    case WRITE_LOG_W:       ssd_stat_record_lat(LAT_WRITE_LOG_W, resp->latency); break;
+    case WRITE_LOG_R:       ssd_stat_record_lat(LAT_WRITE_LOG_R, resp->latency); break;
+    case SSD_CACHE_HIT:     ssd_stat_record_lat(LAT_SSD_CACHE_HIT, resp->latency); break;
+    case SSD_CACHE_MISS:    ssd_stat_record_lat(LAT_SSD_CACHE_MISS, resp->latency); break;
+    case ONGOING_DELAY:     ssd_stat_record_lat(LAT_ONGOING_DELAY, resp->estimated_latency); break;
+    default:                break;
+    }
+}
+
+static const char *lat_class_name(int cls) {
+    switch (cls) {
+    case LAT_HOST_DRAM_HIT:     return "Host DRAM hit";
+    case LAT_WRITE_LOG_W:       return "Write log write";
+    case LAT_WRITE_LOG_R:       return "Write log read";
+    case LAT_SSD_CACHE_HIT:     return "SSD cache hit";
+    case LAT_SSD_CACHE_MISS:    return "SSD cache miss";
+    case LAT_ONGOING_DELAY:     return "Ctx switch wait";
+    case LAT_LOG_FLUSH:         return "Log flush";
+    case LAT_GC:                return "GC victim";
+    case LAT_CXL_LINK:          return "CXL link";
+    }
+    return "unknown";
+}
+
+static void merge_lat_shards(lat_hist *merged) {
+    for (int c = 0; c < NR_LAT_CLASSES; c++)
+        lat_hist_clear(&merged[c], stat_epoch);
+    std::lock_guard<std::mutex> guard(lat_shards_mutex);
+    for (lat_shard *shard : lat_shards)
+        for (int c = 0; c < NR_LAT_CLASSES; c++)
+            lat_hist_merge(&merged[c], &shard->hist[c], stat_epoch);
+}
+
+static void print_lat_hist(FILE *out, const char *name, const lat_hist *h) {
+    fprintf(out, "    %-22s n %-12lu avg %-10.1f p50 %-10lu p99 %-10lu p99.9 %-10lu p99.99 %-10lu max %lu\n",
+            name, h->count, h->count ? (double) h->sum / h->count : 0.0,
+            lat_hist_percentile(h, 50), lat_hist_percentile(h, 99),
+            lat_hist_percentile(h, 99.9), lat_hist_percentile(h, 99.99), h->max);
+}
+
+/* per class, then the NAND queueing delay per channel (stdout) or per LUN (output file) */
+static void print_lat_stat(void) {
+    std::vector<lat_hist> merged(NR_LAT_CLASSES);
+    merge_lat_shards(merged.data());
+    ssdparams *spp = &gdev.sp;
+    lat_hist ch_hist, all_hist;
+    char name[48];
+
+    printf("  Latency distribution (ns)\n");
+    fprintf(output_file, "Latency distribution (ns)\n");
+    for (int c = 0; c < NR_LAT_CLASSES; c++) {
+        print_lat_hist(stdout, lat_class_name(c), &merged[c]);
+        print_lat_hist(output_file, lat_class_name(c), &merged[c]);
+    }
+
+    lat_hist_clear(&all_hist, stat_epoch);
+    for (int ch = 0; ch < spp->nchs; ch++) {
+        lat_hist_clear(&ch_hist, stat_epoch);
+        for (int lun = 0; lun < spp->luns_per_ch; lun++) {
+            lat_hist *h = &gdev.ch[ch].lun[lun].queue_lat;
+            lat_hist_merge(&ch_hist, h, stat_epoch);
+            if (h->epoch == stat_epoch) {
+                snprintf(name, sizeof(name), "NAND queue ch%d lun%d", ch, lun);
+                print_lat_hist(output_file, name, h);
+            }
+        }
+        snprintf(name, sizeof(name), "NAND queue ch%d", ch);
+        print_lat_hist(stdout, name, &ch_hist);
+        lat_hist_merge(&all_hist, &ch_hist, stat_epoch);
+    }
+    print_lat_hist(stdout, "NAND queue all", &all_hist);
+    print_lat_hist(output_file, "NAND queue all", &all_hist);
+}
+
+/* histogram as count, sum, max, then (bucket, count) for its non-empty buckets */
+static void checkpoint_lat_hist(std::vector<uint64_t> &out, const lat_hist *h) {
+    bool live = h->epoch == stat_epoch;
+    out.push_back(live ? h->count : 0);
+    out.push_back(live ? h->sum : 0);
+    out.push_back(live ? h->max : 0);
+    size_t at = out.size();
+    out.push_back(0);
+    for (int i = 0; live && i < LAT_HIST_BUCKETS; i++) {
+        if (h->bucket[i] == 0)
+            continue;
+        out.push_back(i);
+        out.push_back(h->bucket[i]);
+        out[at]++;
+    }
+}
+
+static bool restore_lat_hist(const uint64_t *data, uint64_t len, uint64_t *pos, lat_hist *h) {
+    if (len - *pos < 4)
+        return false;
+    lat_hist_clear(h, stat_epoch);
+    h->count = data[(*pos)++];
+    h->sum = data[(*pos)++];
+    h->max = data[(*pos)++];
+    uint64_t nbuckets = data[(*pos)++];
+    if ((len - *pos) / 2 < nbuckets)
+        return false;
+    for (uint64_t i = 0; i < nbuckets; i++) {
+        uint64_t idx = data[(*pos)++];
+        if (idx >= LAT_HIST_BUCKETS)
+            return false;
+        h->bucket[idx] = data[(*pos)++];
+    }
+    return true;
+}
+
+/* the merged class histograms, then the queueing delay of each LUN */
+void ssd_stat_lat_checkpoint(std::vector<uint64_t> &out) {
+    std::vector<lat_hist> merged(NR_LAT_CLASSES);
+    merge_lat_shards(merged.data());
+    for (int c = 0; c < NR_LAT_CLASSES; c++)
+        checkpoint_lat_hist(out, &merged[c]);
+    for (int ch = 0; ch < gdev.sp.nchs; ch++)
+        for (int lun = 0; lun < gdev.sp.luns_per_ch; lun++)
+            checkpoint_lat_hist(out, &gdev.ch[ch].lun[lun].queue_lat);
+}
+
+/* the class histograms go to the calling thread's shard */
+bool ssd_stat_lat_restore(const uint64_t *data, uint64_t len) {
+    uint64_t pos = 0;
+    if (data == nullptr)
+        return false;
+    if (my_lat_shard == nullptr)
+        my_lat_shard = lat_shard_register();
+    for (int c = 0; c < NR_LAT_CLASSES; c++)
+        if (!restore_lat_hist(data, len, &pos, &my_lat_shard->hist[c]))
+            return false;
+    for (int ch = 0; ch < gdev.sp.nchs; ch++)
+        for (int lun = 0; lun < gdev.sp.luns_per_ch; lun++)
+            if (!restore_lat_hist(data, len, &pos, &gdev.ch[ch].lun[lun].queue_lat))
+                return false;
+    return pos == len;
+}
+
+/* same walk as ssd_stat_lat_restore over the histograms of @nluns LUNs, nothing is restored */
+bool ssd_stat_lat_checkpoint_valid(const uint64_t *data, uint64_t len, uint64_t nluns) {
+    uint64_t pos = 0;
+    if (data == nullptr)
+        return false;
+    for (uint64_t h = 0; h < NR_LAT_CLASSES + nluns; h++) {
+        if (len - pos < 4)
+            return false;
+        uint64_t nbuckets = data[pos + 3];
+        pos += 4;
+        if ((len - pos) / 2 < nbuckets)
+            return false;
+        for (uint64_t i = 0; i < nbuckets; i++, pos += 2)
+            if (data[pos] >= LAT_HIST_BUCKETS)
+                return false;
+    }
+    return pos == len;
+}
 
 int turn_on_stat(void) {
     memset(&stat, 0, sizeof(ssd_stat));
+    reset_repl_stats();
+    ssd_prefetch_reset_stat();
+    stat_epoch++;
     stat_flag = 1;
     return 0;
 }
 
 int reset_ssd_stat(void) {
     memset(&stat, 0, sizeof(ssd_stat));
+    reset_repl_stats();
+    ssd_prefetch_reset_stat();
+    stat_epoch++;
     stat_flag = 0;
     return 0;
 }
@@ -114,6 +411,7 @@ int print_stat(void) {
     printf("    Total read latency:     %-*lu\n", long_field_len, stat.total_r_lat.load());
     printf("    Total write latency:    %-*lu\n", long_field_len, stat.total_w_lat.load());
     printf("    Total program latency:  %-*lu\n", long_field_len, stat.prog_lat.load());
+    print_lat_stat();
 
     printf("  Internal Traffic\n");
     printf("    Total NAND rd user:     %-*lu\n", long_field_len, stat.nand_read_user.load());
@@ -122,6 +420,22 @@ int print_stat(void) {
     printf("    Total NAND wr user:     %-*lu\n", long_field_len, stat.nand_write_user.load());
     printf("    Total NAND wr internal: %-*lu\n", long_field_len, stat.nand_write_internal.load());
     printf("    Total NAND wr GC:       %-*lu\n", long_field_len, stat.nand_write_gc.load());
+    if (nand_timing_detailed) {
+        printf("    P/E suspends:           %-*lu\n", long_field_len, stat.nand_suspends.load());
+        printf("    Multi-plane programs:   %-*lu\n", long_field_len, stat.nand_mplane_programs.load());
+    }
+    {
+        printf("  NAND scheduler (%s)\n", nand_timing_detailed ? "detailed" : nand_sched_policy_name(nand_sched_policy));
+        if (nand_sched_policy != NSCHED_FIFO && !nand_timing_detailed)
+            printf("    Read preemptions:       %-*lu\n", long_field_len, stat.sched_preemptions.load());
+        for (int i = 0; i < NR_REQ_CLASSES; i++) {
+            uint64_t reqs = stat.sched_reqs[i].load();
+            printf("    %-12s requests %-*lu avg wait %-12.1f avg queue depth %.2f\n",
+                    nand_req_class_name(i), long_field_len, reqs,
+                    reqs ? (double) stat.sched_wait_ns[i].load() / reqs : 0.0,
+                    reqs ? (double) stat.sched_queue_depth_sum[i].load() / reqs : 0.0);
+        }
+    }
 
     fprintf(output_file, "Internal Traffic\n");
     fprintf(output_file, "    Total NAND rd user:     %-*lu\n", long_field_len, stat.nand_read_user.load());
@@ -130,6 +444,88 @@ int print_stat(void) {
     fprintf(output_file, "    Total NAND wr user:     %-*lu\n", long_field_len, stat.nand_write_user.load());
     fprintf(output_file, "    Total NAND wr internal: %-*lu\n", long_field_len, stat.nand_write_internal.load());
     fprintf(output_file, "    Total NAND wr GC:       %-*lu\n", long_field_len, stat.nand_write_gc.load());
+    if (nand_timing_detailed) {
+        fprintf(output_file, "    P/E suspends:           %-*lu\n", long_field_len, stat.nand_suspends.load());
+        fprintf(output_file, "    Multi-plane programs:   %-*lu\n", long_field_len, stat.nand_mplane_programs.load());
+    }
+    {
+        fprintf(output_file, "NAND scheduler (%s)\n",
+                nand_timing_detailed ? "detailed" : nand_sched_policy_name(nand_sched_policy));
+        if (nand_sched_policy != NSCHED_FIFO && !nand_timing_detailed)
+            fprintf(output_file, "    Read preemptions:       %-*lu\n", long_field_len, stat.sched_preemptions.load());
+        for (int i = 0; i < NR_REQ_CLASSES; i++) {
+            uint64_t reqs = stat.sched_reqs[i].load();
+            fprintf(output_file, "    %-12s requests:  %-*lu\n", nand_req_class_name(i), long_field_len, reqs);
+            fprintf(output_file, "    %-12s avg wait:  %f\n", nand_req_class_name(i),
+                    reqs ? (double) stat.sched_wait_ns[i].load() / reqs : 0.0);
+            fprintf(output_file, "    %-12s avg depth: %f\n", nand_req_class_name(i),
+                    reqs ? (double) stat.sched_queue_depth_sum[i].load() / reqs : 0.0);
+        }
+    }
+
+    // write amplification over the writes the host data itself needs
+    uint64_t host_writes = stat.nand_write_user.load() + stat.nand_write_internal.load();
+    double write_amp = host_writes ? (double) (host_writes + stat.nand_write_gc.load()) / host_writes : 0;
+    double gc_user_ratio = stat.nand_write_user.load() ?
+            (double) stat.nand_write_gc.load() / stat.nand_write_user.load() : 0;
+    int min_erase, max_erase;
+    double avg_erase;
+    bytefs_gc_erase_spread(&gdev, &min_erase, &max_erase, &avg_erase);
+
+    printf("  Garbage collection (%s)\n", gc_policy_name(gc_policy));
+    printf("    Victims:                %-*lu = FG: %-*lu + BG: %-*lu\n",
+            long_field_len, stat.gc_fg_victims.load() + stat.gc_bg_victims.load(),
+            long_field_len, stat.gc_fg_victims.load(), long_field_len, stat.gc_bg_victims.load());
+    printf("    Migrated pages:         %-*lu\n", long_field_len, stat.gc_migrated_pages.load());
+    printf("    Write amplification:    %-*f (GC/user: %f)\n", long_field_len, write_amp, gc_user_ratio);
+    printf("    Erase count:            min %d, max %d, avg %.2f, spread %d\n",
+            min_erase, max_erase, avg_erase, max_erase - min_erase);
+
+    printf("    Victim valid ratio:    ");
+    for (int i = 0; i < GC_VPC_BUCKETS; i++)
+        printf(" <%3d%%: %-8lu", 100 * (i + 1) / GC_VPC_BUCKETS, stat.gc_victim_vpc_distribution[i].load());
+    printf("\n");
+    printf("    Stream pages:           user %lu, hot %lu, GC %lu, demotion %lu (multi-stream %s)\n",
+            stat.stream_wr_page[WS_USER].load(), stat.stream_wr_page[WS_USER_HOT].load(),
+            stat.stream_wr_page[WS_GC].load(), stat.stream_wr_page[WS_DEMOTION].load(),
+            multi_stream_enable ? "on" : "off");
+
+    fprintf(output_file, "Garbage collection (%s)\n", gc_policy_name(gc_policy));
+    fprintf(output_file, "    FG victims:             %-*lu\n", long_field_len, stat.gc_fg_victims.load());
+    fprintf(output_file, "    BG victims:             %-*lu\n", long_field_len, stat.gc_bg_victims.load());
+    fprintf(output_file, "    Migrated pages:         %-*lu\n", long_field_len, stat.gc_migrated_pages.load());
+    fprintf(output_file, "    Write amplification:    %f\n", write_amp);
+    fprintf(output_file, "    GC/user write ratio:    %f\n", gc_user_ratio);
+    fprintf(output_file, "    Erase count min:        %d\n", min_erase);
+    fprintf(output_file, "    Erase count max:        %d\n", max_erase);
+    fprintf(output_file, "    Erase count avg:        %f\n", avg_erase);
+    for (int i = 0; i < GC_VPC_BUCKETS; i++)
+        fprintf(output_file, "    Victims valid <%3d%%:    %-*lu\n", 100 * (i + 1) / GC_VPC_BUCKETS,
+                long_field_len, stat.gc_victim_vpc_distribution[i].load());
+    fprintf(output_file, "    Stream user pages:      %-*lu\n", long_field_len, stat.stream_wr_page[WS_USER].load());
+    fprintf(output_file, "    Stream hot pages:       %-*lu\n", long_field_len, stat.stream_wr_page[WS_USER_HOT].load());
+    fprintf(output_file, "    Stream GC pages:        %-*lu\n", long_field_len, stat.stream_wr_page[WS_GC].load());
+    fprintf(output_file, "    Stream demotion pages:  %-*lu\n", long_field_len, stat.stream_wr_page[WS_DEMOTION].load());
+
+    printf("  Replacement\n");
+    print_repl_stat("SSD cache", dram_subsystem->the_cache, long_field_len);
+    print_repl_stat("Host DRAM", dram_subsystem->host_dram, long_field_len);
+    print_fill_stat(long_field_len);
+    if (cxl_link_enable)
+        print_cxl_stat(long_field_len);
+    if (ssd_prefetch_enable)
+        print_prefetch_stat(long_field_len);
+
+    uint64_t maptbl_ents = gdev.maptbl.size();
+    printf("  Mapping table\n");
+    printf("    Mapped LPNs:            %-*lu\n", long_field_len, maptbl_ents);
+    printf("    Table bytes:            %-*lu\n", long_field_len, ssd_maptbl_mem_usage());
+    printf("    Hash map bytes (est.):  %-*lu\n", long_field_len, hash_maptbl_mem_estimate(maptbl_ents, sizeof(ppa)));
+
+    fprintf(output_file, "Mapping table\n");
+    fprintf(output_file, "    Mapped LPNs:            %-*lu\n", long_field_len, maptbl_ents);
+    fprintf(output_file, "    Table bytes:            %-*lu\n", long_field_len, ssd_maptbl_mem_usage());
+    fprintf(output_file, "    Hash map bytes (est.):  %-*lu\n", long_field_len, hash_maptbl_mem_estimate(maptbl_ents, sizeof(ppa)));
 
     printf("========== ByteFS rw modification distribution ==========\n");
     double total_byte_issue_nand_wr_modified = 0;
@@ -2,8 +2,31 @@
 #define __SSD_STAT__
 
 #include <atomic>
+#include <vector>
 
 #include "ftl.h"
+#include "lat_hist.h"
+
+/* GC victims bucketed by valid page ratio at reclaim time, 10% per bucket */
+#define GC_VPC_BUCKETS (10)
+
+/* latency distributions each thread records into its own shard */
+enum lat_class {
+    LAT_HOST_DRAM_HIT,
+    LAT_WRITE_LOG_W,
+    LAT_WRITE_LOG_R,
+    LAT_SSD_CACHE_HIT,
+    LAT_SSD_CACHE_MISS,
+    LAT_ONGOING_DELAY,          // the flash wait a context switch hides
+    LAT_LOG_FLUSH,              // one log flush, start to last program
+    LAT_GC,                     // one GC victim, first migration to erase done
+    LAT_CXL_LINK,               // CXL round trip of an access, device time excluded
+    NR_LAT_CLASSES
+};
+
+struct lat_shard {
+    lat_hist hist[NR_LAT_CLASSES];
+};
 
 struct ssd_stat {
     // total issue counter by request count
@@ -61,6 +84,40 @@ struct ssd_stat {
     atomic_uint64_t nand_write_user;
     atomic_uint64_t nand_write_internal;
     atomic_uint64_t nand_write_gc;
+    // detailed NAND timing
+    atomic_uint64_t nand_suspends;
+    atomic_uint64_t nand_mplane_programs;
+    // LUN scheduler, per request class
+    atomic_uint64_t sched_reqs[NR_REQ_CLASSES];
+    atomic_uint64_t sched_wait_ns[NR_REQ_CLASSES];
+    atomic_uint64_t sched_queue_depth_sum[NR_REQ_CLASSES];
+    atomic_uint64_t sched_preemptions;
+    // garbage collection
+    atomic_uint64_t gc_fg_victims;
+    atomic_uint64_t gc_bg_victims;
+    atomic_uint64_t gc_migrated_pages;
+    atomic_uint64_t gc_victim_vpc_distribution[GC_VPC_BUCKETS];
+    // pages programmed per write stream
+    atomic_uint64_t stream_wr_page[NR_WRITE_STREAMS];
+    // SSD cache prefetcher
+    atomic_uint64_t pf_issued;
+    atomic_uint64_t pf_useful;
+    atomic_uint64_t pf_late;
+    atomic_uint64_t pf_wasted;
+    // in-flight fills of the SSD cache
+    atomic_uint64_t fill_issued;
+    atomic_uint64_t fill_merged;        // misses attached to an outstanding fill
+    atomic_uint64_t fill_delayed;       // fills held back by the per channel limit
+    atomic_uint64_t fill_wait_ns;
+    atomic_uint64_t fill_depth_sum;     // fills outstanding on the channel, summed at each fill
+    atomic_uint64_t fill_depth_max;
+    // CXL link
+    atomic_uint64_t cxl_msgs;
+    atomic_uint64_t cxl_m2s_slots;
+    atomic_uint64_t cxl_s2m_slots;
+    atomic_uint64_t cxl_link_ns;
+    atomic_uint64_t cxl_queue_ns;       // waiting for credits and for the link
+    atomic_uint64_t cxl_credit_stalls;
 
     /*LSSD*/
     //Hit ratio
@@ -84,6 +141,30 @@ int turn_on_stat(void);
 int reset_ssd_stat(void);
 int print_stat(void);
 
+// histograms of older epochs count as empty, a reset only bumps the epoch
+extern uint64_t stat_epoch;
+extern thread_local lat_shard *my_lat_shard;
+lat_shard *lat_shard_register(void);
+
+inline void ssd_stat_record_lat(int cls, uint64_t ns) {
+    if (!check_stat_state())
+        return;
+    if (my_lat_shard == nullptr)
+        my_lat_shard = lat_shard_register();
+    lat_hist_record(&my_lat_shard->hist[cls], stat_epoch, ns);
+}
+
+/* called with the LUN timing lock held */
+inline void ssd_stat_record_nand_queue(nand_lun *lun, uint64_t ns) {
+    if (check_stat_state())
+        lat_hist_record(&lun->queue_lat, stat_epoch, ns);
+}
+
+void ssd_stat_record_issue(const issue_response *resp);
+void ssd_stat_lat_checkpoint(std::vector<uint64_t> &out);
+bool ssd_stat_lat_restore(const uint64_t *data, uint64_t len);
+bool ssd_stat_lat_checkpoint_valid(const uint64_t *data, uint64_t len, uint64_t nluns);
+
 #define SSD_STAT_ATOMIC_ADD(name, value) {  \
     if (check_stat_state()) {               \
         stat.name += value;                 \
@@ -10,10 +10,54 @@
 
 
 #define CHNL_TRANSFER_LATENCY_NS (20000)
+
+/* detailed NAND model: one 4KB page over an ONFI 4.x bus at 1.6 GT/s */
+#define NAND_PAGE_XFER_LATENCY (2560)
+/* planes per LUN (die), blocks are interleaved across planes */
+#define NAND_PLANES_PER_LUN (2)
+/* suspends allowed per program/erase before reads have to wait for it */
+#define NAND_MAX_SUSPENDS (8)
+
+/**
+ * Per-cell-type NAND timing. Page latencies are indexed by page type
+ * (LSB, CSB, MSB for TLC), pages cycle through the types within a block; the
+ * averages match the flat latencies the simple model uses.
+ */
+struct nand_cell_timing {
+    int bits_per_cell;
+    int rd_lat[3];
+    int wr_lat[3];
+    int er_lat;
+    int suspend_lat;    /* an ongoing program/erase stops this long after a suspend */
+    int resume_lat;
+};
+
+/*                                 bits  rd_lat                 wr_lat                    er_lat   sus    res */
+#define NAND_TIMING_HLL         {  1,   {NAND_READ_LATENCY},   {NAND_PROG_LATENCY},      NAND_BLOCK_ERASE_LATENCY, 3000, 3000 }
+#define NAND_TIMING_SLC         {  1,   {25000},               {200000},                 1500000, 20000, 20000 }
+#define NAND_TIMING_MLC         {  2,   {40000, 60000},        {300000, 900000},         3000000, 30000, 30000 }
+#define NAND_TIMING_TLC         {  3,   {3000, 4000, 5000},    {45000, 75000, 105000},   853000,  20000, 20000 }
 // #define DMA_TRANSFER_LATENCY_BLOCK ()
 
 
 //memory interface
+/* byte_issue() parts: DRAM access, CXL round trip, SSD cache indexing */
+#define HOST_DRAM_ACCESS_LATENCY (46)
+#define SSD_DRAM_ACCESS_LATENCY (46)
+#define SSD_CACHE_INDEX_LATENCY (72)
+#define CXL_FLAT_LATENCY (40)
+
+/* CXL.mem link model: fixed port and PHY latency per direction */
+#define CXL_PORT_LATENCY (20)
+/* messages are packed into 16B slots; 68B flits (CXL 1.1/2.0) carry 4, 256B flits (CXL 3.x) 15 */
+#define CXL_SLOT_BYTES (16)
+#define CXL_FLIT68_BYTES (68)
+#define CXL_FLIT68_SLOTS (4)
+#define CXL_FLIT256_BYTES (256)
+#define CXL_FLIT256_SLOTS (15)
+/* request/response header of a message, a data message adds its 64B line */
+#define CXL_MSG_HEADER_BYTES (16)
+
 #define PCIE_RC_TRANSFER_LATENCY (500) 
 #define HOST_RC_TRANSFER_LATENCY (500)
 
@@ -3,6 +3,8 @@
 #include <vector>
 #include <unordered_set>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 
 #include "ftl.h"
 #include "trace_utils.h"
@@ -25,7 +27,7 @@ off_t getFileSize(const std::string& filename) {
 
 
 TraceReplayUnit::TraceReplayUnit() :
-    sample_arr(nullptr), sample_idx(0), sample_max_idx(0), sample_buf_len(0),
+    fd(-1), sample_arr(nullptr), map_len(0), readahead_len(0), readahead_next(0),
     abs_sample_idx(0), num_samples(0) {
   resetTrackingInfo();
 }
@@ -34,57 +36,100 @@ TraceReplayUnit::TraceReplayUnit(string filename) : TraceReplayUnit() {
   init(filename);
 }
 
+TraceReplayUnit::~TraceReplayUnit() {
+  deinit();
+}
+
+// the mapping moves along, samples handed out stay valid
+TraceReplayUnit::TraceReplayUnit(TraceReplayUnit &&other) noexcept : TraceReplayUnit() {
+  *this = std::move(other);
+}
+
+TraceReplayUnit &TraceReplayUnit::operator=(TraceReplayUnit &&other) noexcept {
+  if (this != &other) {
+    deinit();
+    tracefile = std::move(other.tracefile);
+    fd = other.fd;
+    sample_arr = other.sample_arr;
+    map_len = other.map_len;
+    readahead_len = other.readahead_len;
+    readahead_next = other.readahead_next;
+    abs_sample_idx = other.abs_sample_idx;
+    num_samples = other.num_samples;
+    other.fd = -1;
+    other.sample_arr = nullptr;
+    other.map_len = 0;
+    other.resetTrackingInfo();
+  }
+  return *this;
+}
+
 // 0 on fail, success otherwise
-int TraceReplayUnit::init(string filename, uint64_t sample_buf_len) {
-  if (ifs.is_open())
-    return ifs.good() && sample_arr != nullptr;
+int TraceReplayUnit::init(string filename, uint64_t readahead_bytes) {
+  if (fd >= 0)
+    return 1;
 
-  ifs.open(filename);
-  if (!ifs.good())
+  fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
     return 0;
-  
+
   uint64_t size = (uint64_t)getFileSize(filename);
-  
+
   assert(size % sizeof(trace_sample) == 0);
 
   resetTrackingInfo();
+  tracefile = filename;
   num_samples = size / sizeof(trace_sample);
-  this->sample_buf_len = sample_buf_len;
-  sample_arr = new trace_sample[this->sample_buf_len];
+  if (size > 0) {
+    void *map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+      close(fd);
+      fd = -1;
+      return 0;
+    }
+    madvise(map, size, MADV_SEQUENTIAL);
+    sample_arr = (const trace_sample *) map;
+    map_len = size;
+  }
 
-  sample_idx = 0;
+  // whole pages, so the windows can be advised
+  uint64_t page = sysconf(_SC_PAGESIZE);
+  readahead_len = std::max((readahead_bytes + page - 1) / page * page, page);
+  __readAhead();
   return 1;
 }
 
 void TraceReplayUnit::deinit() {
-  if (ifs.is_open()) {
-    ifs.close();
-    sample_buf_len = 0;
-    delete[] sample_arr;
+  if (fd >= 0) {
+    if (sample_arr != nullptr)
+      munmap((void *) sample_arr, map_len);
+    close(fd);
+    fd = -1;
+    sample_arr = nullptr;
+    map_len = 0;
   }
   resetTrackingInfo();
 }
 
-trace_sample *TraceReplayUnit::getCurrentTraceSample() {
-  if (sample_max_idx == 0 && ifs.eof())
+const trace_sample *TraceReplayUnit::getCurrentTraceSample() {
+  if (abs_sample_idx >= num_samples)
     return nullptr;
-  __getCurrentTraceSample();
-  return &sample_arr[sample_idx];
+  return &sample_arr[abs_sample_idx];
 }
 
-trace_sample *TraceReplayUnit::getNextTraceSample() {
-  if (sample_max_idx == 0 && ifs.eof())
+const trace_sample *TraceReplayUnit::getNextTraceSample() {
+  if (abs_sample_idx >= num_samples)
     return nullptr;
-  __advanceNextTraceSample();
-  return &sample_arr[sample_idx];
+  if (++abs_sample_idx >= readahead_next)
+    __readAhead();
+  return getCurrentTraceSample();
 }
 
 int TraceReplayUnit::resetReadHead() {
-  if (!ifs.is_open())
+  if (fd < 0)
     return -1;
-  ifs.clear();
-  ifs.seekg(0);
-  resetTrackingInfo();
+  abs_sample_idx = 0;
+  __readAhead();
   return 0;
 }
 
@@ -93,25 +138,24 @@ void TraceReplayUnit::getStatus(replay_progress *progress) {
   progress->inst_num = num_samples;
 }
 
-inline void TraceReplayUnit::__advanceNextTraceSample() {
-  sample_idx++;
-  __getCurrentTraceSample();
-  abs_sample_idx += sample_max_idx != 0;
-}
-
-inline void TraceReplayUnit::__getCurrentTraceSample() {
-  if (sample_idx >= sample_max_idx) {
-    sample_idx = 0;
-    int nread = ifs.read((char *) sample_arr, sizeof(trace_sample) * sample_buf_len).gcount();
-    assert(nread % sizeof(trace_sample) == 0);
-    sample_max_idx = nread / sizeof(trace_sample);
+// entering a new window, start reading the next one and drop the previous one
+void TraceReplayUnit::__readAhead() {
+  if (sample_arr == nullptr) {
+    readahead_next = (uint64_t) -1;
+    return;
   }
+  uint64_t window = abs_sample_idx * sizeof(trace_sample) / readahead_len;
+  uint64_t next_start = (window + 1) * readahead_len;
+  if (next_start < map_len)
+    madvise((char *) sample_arr + next_start, std::min(readahead_len, map_len - next_start), MADV_WILLNEED);
+  if (window > 0)
+    madvise((char *) sample_arr + (window - 1) * readahead_len, readahead_len, MADV_DONTNEED);
+  // first sample starting in the next window
+  readahead_next = (next_start + sizeof(trace_sample) - 1) / sizeof(trace_sample);
 }
 
 void TraceReplayUnit::resetTrackingInfo() {
-  sample_idx = 0;
-  sample_max_idx = 0;
-  sample_buf_len = 0;
+  readahead_next = 0;
   abs_sample_idx = 0;
   num_samples = 0;
 }
@@ -120,7 +164,7 @@ void *parallelLoaderThread(void *thread_args) {
   ParallelLoader::parallel_loader_args *args = static_cast<ParallelLoader::parallel_loader_args *>(thread_args);
   ParallelLoader::parallel_loader_returns *returns = new ParallelLoader::parallel_loader_returns;
   TraceReplayUnit *tru = args->tru;
-  trace_sample *sample;
+  const trace_sample *sample;
 
   volatile uint8_t *const load_autherization_flag = args->load_autherization_flag;
   volatile uint8_t *const worker_report_flag = args->worker_report_flag;
@@ -179,9 +223,9 @@ ParallelLoader::ParallelLoader(vector<string> tracefiles) :
     worker_finish_flags(new uint8_t[nfiles]),
     args(new parallel_loader_args[nfiles]),
     pthread_info(new pthread_t[nfiles]) {
-  memset((void *) load_autherization_flags, 0, sizeof(load_autherization_flags));
-  memset((void *) worker_report_flags, 0, sizeof(worker_report_flags));
-  memset((void *) worker_finish_flags, 0, sizeof(worker_finish_flags));
+  memset((void *) load_autherization_flags, 0, nfiles);
+  memset((void *) worker_report_flags, 0, nfiles);
+  memset((void *) worker_finish_flags, 0, nfiles);
   for (int fileidx = 0; fileidx < nfiles; fileidx++) {
     args[fileidx].loader = this;
     args[fileidx].tru = &trus[fileidx];
@@ -34,30 +34,42 @@ struct logical_core_status {
     Thread *scheduled_thread;
 };
 
+// the next window of a trace is read ahead while the current one is replayed
+#define TRACE_READAHEAD_BYTES (64ULL << 20)
+
+/*
+ * Replays a trace file mapped into memory, samples are handed out in place.
+ * The kernel reads the window after the current one ahead of time and the
+ * window before it is dropped, so traces larger than memory replay too.
+ */
 class TraceReplayUnit {
   public:
     TraceReplayUnit();
     TraceReplayUnit(string tracefile);
-    int init(string tracefile, uint64_t sample_buf_len = 4096 / sizeof(trace_sample));
+    ~TraceReplayUnit();
+    TraceReplayUnit(const TraceReplayUnit &) = delete;
+    TraceReplayUnit &operator=(const TraceReplayUnit &) = delete;
+    TraceReplayUnit(TraceReplayUnit &&other) noexcept;
+    TraceReplayUnit &operator=(TraceReplayUnit &&other) noexcept;
+    int init(string tracefile, uint64_t readahead_bytes = TRACE_READAHEAD_BYTES);
     void deinit();
-    trace_sample *getCurrentTraceSample();
-    trace_sample *getNextTraceSample();
+    const trace_sample *getCurrentTraceSample();
+    const trace_sample *getNextTraceSample();
     int resetReadHead();
 
     void getStatus(replay_progress *progress);
 
   private:
-    inline void __advanceNextTraceSample();
-    inline void __getCurrentTraceSample();
+    void __readAhead();
     void resetTrackingInfo();
 
     string tracefile;
-    ifstream ifs;
+    int fd;
 
-    trace_sample *sample_arr;
-    uint64_t sample_idx;
-    uint64_t sample_max_idx;
-    uint64_t sample_buf_len;
+    const trace_sample *sample_arr;
+    uint64_t map_len;
+    uint64_t readahead_len;
+    uint64_t readahead_next;
 
     uint64_t abs_sample_idx;
     uint64_t num_samples;
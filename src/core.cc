@@ -603,6 +603,32 @@ void core_c::core_heartbeat(bool final) {
   }
 }
 
+// fast-forward over cycles in which the core is known to stay stalled
+void core_c::skip_cycles(Counter n, bool active) {
+  m_core_cycle_count += n;
+  if (!active) return;
+
+  m_cycle += n;
+  if (m_rob->front() == nullptr || m_rob->front()->m_mem_type == NOT_MEM)
+    num_cycles_stalled_non_mem += n;
+  else
+    num_cycles_stalled_mem += n;
+}
+
+// earliest time a thread waiting on an interrupt or context switch fetches again
+int64_t core_c::fetch_resume_time(void) {
+  int64_t resume = INT64_MAX;
+  for (auto I = m_thread_trace_info.begin(), E = m_thread_trace_info.end(); I != E; ++I) {
+    thread_s* trace_info = I->second;
+    if (trace_info == NULL) continue;
+    if (trace_info->handling_interrupt_buffer)
+      resume = min(resume, trace_info->fetch_stall_end_time);
+    if (trace_info->context_switch_waiting_overhead)
+      resume = min(resume, trace_info->context_switch_waiting_overhead_end_time);
+  }
+  return resume;
+}
+
 // check forward progress of the simulation
 Counter core_c::check_forward_progress() {
   // get total retired instruction count
@@ -615,7 +641,8 @@ Counter core_c::check_forward_progress() {
   }
 
 
-  if (m_core_cycle_count - m_last_forward_progress > 0 && m_rob->front()==last_rob_front && m_rob->back()==last_rob_back && !m_rob->has_uncomplete_ops())
+  m_stalled = m_core_cycle_count - m_last_forward_progress > 0 && m_rob->front()==last_rob_front && m_rob->back()==last_rob_back && !m_rob->has_uncomplete_ops();
+  if (m_stalled)
   {
     if (m_rob->front()==nullptr || m_rob->front()->m_mem_type == NOT_MEM)
     {
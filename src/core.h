@@ -153,6 +153,30 @@ public:
     m_core_cycle_count++;
   }
 
+  /*! \fn void skip_cycles(Counter n, bool active)
+   *  \brief Function to fast-forward the core clock over quiescent cycles
+   *  \param n - number of core cycles skipped
+   *  \param active - the core runs a thread, its clock and stall counts advance too
+   *  \return void
+   */
+  void skip_cycles(Counter n, bool active);
+
+  /*! \fn int64_t fetch_resume_time(void)
+   *  \brief Function to return when the first thread blocked on an interrupt or
+   *  context switch fetches again (ns), INT64_MAX if none is blocked
+   *  \return int64_t - simulated time
+   */
+  int64_t fetch_resume_time(void);
+
+  /*! \fn bool is_stalled(void)
+   *  \brief Function to return whether the last forward progress check found
+   *  the core stalled, no retire and no change in the ROB
+   *  \return bool - stalled
+   */
+  bool is_stalled(void) {
+    return m_stalled;
+  }
+
   /*! \fn void advance_queues(void)
    *  \brief Function to advance queues
    *  \return void
@@ -372,6 +396,7 @@ public:
   uint64_t num_cycles_not_stalled;
   uop_c* last_rob_front = 0;
   uop_c* last_rob_back = 0;
+  bool m_stalled = false; /**< stalled at the last forward progress check */
 
   unordered_map<int, unordered_set<Counter>> m_per_thread_fault_parent_uops;
 
@@ -70,6 +70,22 @@ public:
    */
   virtual void run_a_cycle(bool) = 0;
 
+  /**
+   * Fast-forward the controller clock over n quiescent cycles
+   */
+  virtual void skip_cycles(Counter n) {
+    m_cycle += n;
+  }
+
+  /**
+   * Whether every request in the controller waits on the SSD. When true,
+   * cycles_left holds the cycles until the first one completes, or stays
+   * untouched if there is none. Controllers without the SSD path never are.
+   */
+  virtual bool skybyte_parked(Counter* cycles_left) {
+    return false;
+  }
+
 protected:
   /**
    * Send a packet to NOC
@@ -39,6 +39,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "dram_ctrl.h"
 #include "memory.h"
 #include "memreq_info.h"
+#include "mmu.h"
 #include "utils.h"
 #include "bug_detector.h"
 #include "network.h"
@@ -48,6 +49,8 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "SkyByte-Sim/cpu_scheduler.h"
 #include "SkyByte-Sim/utils.h"
 #include "SkyByte-Sim/ftl.h"
+#include "SkyByte-Sim/ssd_prefetch.h"
+#include "SkyByte-Sim/cxl_link.h"
 #include "SkyByte-Sim/simulator_clock.h"
 
 #include "all_knobs.h"
@@ -367,6 +370,15 @@ bool dram_ctrl_c::insert_new_req(mem_req_s* mem_req) {
       }
       uint64_t byte_iss = byte_issue(is_write, mem_req->m_addr, 64, &resp);
       assert(byte_iss==0);
+      cxl_link_transfer(is_write, &resp);
+      if (m_simBase->m_MMU->is_page_table_addr(mem_req->m_addr))
+      {
+        STAT_EVENT(AVG_PTW_SSD_LATENCY_BASE);
+        STAT_EVENT_N(AVG_PTW_SSD_LATENCY, resp.latency);
+        if (resp.flag & issue_status::SSD_CACHE_MISS)
+          STAT_EVENT(PTW_SSD_FLASH_READ);
+      }
+      ssd_prefetch_observe(mem_req->m_addr, &resp);
       entr.sent_time = m_cycle + (uint64_t)(resp.latency*(*KNOB(KNOB_CLOCK_MC)));
 
 
@@ -487,6 +499,26 @@ void dram_ctrl_c::skybyte_schedule() {
   }
 }
 
+void dram_ctrl_c::skip_cycles(Counter n) {
+  for (int ii = 0; ii < m_num_channel; ++ii) {
+    if (avail_data_bus(ii)) {
+      STAT_EVENT_N(DRAM_CHANNEL0_DBUS_IDLE + ii, n);
+    }
+  }
+  m_cycle += n;
+}
+
+bool dram_ctrl_c::skybyte_parked(Counter* cycles_left) {
+  // req_buffer tracks every request until it is sent back, so nothing sits in
+  // the DRB or the output buffers when both sizes match
+  if (req_buffer.size() != req_buffer_queue.size()) return false;
+  if (!req_buffer_queue.empty()) {
+    int64_t sent_time = req_buffer_queue.top().sent_time;
+    *cycles_left = sent_time > (int64_t)m_cycle ? sent_time - m_cycle : 0;
+  }
+  return true;
+}
+
 /* SkyByte */
 
 // tick a cycle
@@ -179,6 +179,16 @@ public:
 
   void skybyte_schedule();
 
+  /**
+   * Fast-forward over n quiescent cycles, idle data buses still count
+   */
+  void skip_cycles(Counter n);
+
+  /**
+   * Every request waits in req_buffer_queue for its SSD completion
+   */
+  bool skybyte_parked(Counter* cycles_left);
+
 protected:
   /**
    * Schedule each bank.
@@ -70,6 +70,7 @@ class pref_base_c;
 class hwp_common_c;
 class map_c;
 class memory_c;
+class mshr_c;
 class macsim_c;
 class port_c;
 class retire_c;
@@ -111,6 +112,8 @@ class noc_c;
 class ManifoldProcessor;
 class trace_read_c;
 class trace_reader_wrapper_c;
+class trace_stream_c;
+class trace_decoder_c;
 class KnobsContainer;
 class ProcessorStatistics;
 class CoreStatistics;
@@ -74,6 +74,7 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include "all_knobs.h"
 #include "all_stats.h"
+#include "trace_stream.h"
 #include "statistics.h"
 
 using namespace std;
@@ -87,6 +88,7 @@ using namespace std;
 
 //The simulator clock
 extern sim_clock* the_clock_pt;
+extern bool event_skip_enable;
 
 
 // =======================================
@@ -228,6 +230,9 @@ void macsim_c::init_memory(void) {
   m_block_id_mapper = new multi_key_map_c;
   m_process_manager = new process_manager_c(m_simBase);
   m_trace_reader = new trace_reader_wrapper_c(m_simBase);
+  m_trace_decoder = new trace_decoder_c(
+    *KNOB(KNOB_TRACE_DECODE_THREADS), *KNOB(KNOB_TRACE_PREFETCH_DEPTH),
+    *KNOB(KNOB_TRACE_PREFETCH_MEM_CAP), *KNOB(KNOB_TRACE_BINARY_CACHE));
 
   // block schedule info
   block_schedule_info_s* block_schedule_info = new block_schedule_info_s;
@@ -606,6 +611,8 @@ void macsim_c::deallocate_memory(void) {
 
   if (*m_simBase->m_knobs->KNOB_BUG_DETECTOR_ENABLE) delete m_bug_detector;
 
+  delete m_trace_decoder;
+
   // deallocate cores
   int num_large_cores = *KNOB(KNOB_NUM_SIM_LARGE_CORES);
   int num_large_medium_cores =
@@ -1024,16 +1031,14 @@ int macsim_c::run_a_cycle() {
   }
 
   //SkyByte wait for other threads to finish
-  the_clock_pt->check_pop_and_incre_time_macsim(the_clock_pt->get_time_sim());
+  int64_t agent_horizon = the_clock_pt->check_pop_and_incre_time_macsim(the_clock_pt->get_time_sim());
 
   // increase simulation cycle
   m_simulation_cycle++;
   STAT_EVENT(CYC_COUNT_TOT);
 
   // apply new time
-  the_clock_pt->clock_mutex.lock();
-  the_clock_pt->time_tick = m_simulation_cycle / (*KNOB(KNOB_CLOCK_CPU));
-  the_clock_pt->clock_mutex.unlock();
+  the_clock_pt->set_time_sim(m_simulation_cycle / (*KNOB(KNOB_CLOCK_CPU)));
 
 
   // m_termination_check[0] cpu [1] gpu
@@ -1046,6 +1051,11 @@ int macsim_c::run_a_cycle() {
     }
   }
 
+#if !defined(USING_SST) && !defined(IRIS)
+  // every agent sleeps on a future event, fast-forward if the machine waits on the SSD
+  if (event_skip_enable && agent_horizon != 0 && !pll_locked)
+    skip_quiescent_cycles(agent_horizon);
+#endif
 
   if (curr_acc_retired_insts != this->acc_retired_insts)
   {
@@ -1073,6 +1083,87 @@ void macsim_c::stat_stalls(FILE* fout){
     fprintf(fout, "Core %d stalls(other): %ld\n", ii, core->num_cycles_stalled_non_mem);
     fprintf(fout, "Core %d retires: %ld\n", ii, core->num_cycles_not_stalled);
   }
+  if (event_skip_enable) {
+    fprintf(fout, "Skipped quiescent cycles: %llu\n", m_skipped_cycles);
+    fprintf(fout, "Quiescent fast-forwards: %llu\n", m_num_skips);
+  }
+}
+
+bool macsim_c::is_quiescent(void) {
+  // cheapest checks first, cores are stalled most of the cycles anyway
+  for (int ii = 0; ii < m_num_sim_cores; ++ii) {
+    if (m_sim_end[ii] || !m_core_started[ii]) continue;
+    if (!m_core_pointers[ii]->is_stalled()) return false;
+  }
+
+  bool ssd_pending = false;
+  for (int ii = 0; ii < m_num_mc; ++ii) {
+    Counter cycles_left = 0;
+    if (!m_dram_controller[ii]->skybyte_parked(&cycles_left)) return false;
+    ssd_pending |= cycles_left > 0;
+  }
+
+  // write-backs hold no MSHR entry, they are only visible in the NoC
+  return ssd_pending && m_MMU->is_idle() && m_memory->is_quiescent() &&
+         m_network->is_idle();
+}
+
+void macsim_c::skip_quiescent_cycles(int64_t agent_horizon) {
+  if (!is_quiescent()) return;
+
+  // simulation cycles until the first thing that could change the machine state
+  double cpu_ghz = *KNOB(KNOB_CLOCK_CPU);
+  auto cycles_until = [this, cpu_ghz](int64_t time_ns) -> Counter {
+    Counter cycle = (Counter)(time_ns * cpu_ghz);
+    return cycle > m_simulation_cycle ? cycle - m_simulation_cycle : 0;
+  };
+
+  Counter horizon = UINT64_MAX;
+  for (int ii = 0; ii < m_num_mc; ++ii) {
+    Counter cycles_left = UINT64_MAX / m_clock_lcm;
+    m_dram_controller[ii]->skybyte_parked(&cycles_left);
+    horizon = min(horizon, cycles_left * m_clock_lcm / m_domain_freq[CLOCK_MC]);
+  }
+  if (agent_horizon != SIM_CLOCK_NO_EVENT)
+    horizon = min(horizon, cycles_until(agent_horizon));
+  for (int ii = 0; ii < m_num_sim_cores; ++ii) {
+    int64_t resume = m_core_pointers[ii]->fetch_resume_time();
+    if (resume != INT64_MAX) horizon = min(horizon, cycles_until(resume));
+  }
+
+  // skip whole clock periods so every domain keeps its phase, and stop one
+  // period early so the completion itself is simulated cycle by cycle
+  Counter periods = horizon / m_clock_lcm;
+  if (periods < 2) return;
+  --periods;
+
+  for (int ii = 0; ii < m_num_sim_cores; ++ii) {
+    core_c* core = m_core_pointers[ii];
+    Counter n = periods * m_domain_freq[ii];
+    bool active = !m_sim_end[ii] && m_core_started[ii];
+    core->skip_cycles(n, active);
+    m_core_cycle[ii] += n;
+    m_memory->skip_cycles_core(ii, n);
+    if (active) {
+      STAT_CORE_EVENT_N(ii, CYC_COUNT, n);
+      STAT_CORE_EVENT_N(ii, NUM_SAMPLES, n);
+      STAT_CORE_EVENT_N(ii, NUM_ACTIVE_BLOCKS, n * core->m_running_block_num);
+      STAT_CORE_EVENT_N(ii, NUM_ACTIVE_THREADS, n * core->m_running_thread_num);
+    }
+  }
+  m_network->skip_cycles(periods * m_domain_freq[CLOCK_NOC]);
+  m_memory->skip_cycles(periods * m_domain_freq[CLOCK_LLC]);
+  for (int ii = 0; ii < m_num_mc; ++ii)
+    m_dram_controller[ii]->skip_cycles(periods * m_domain_freq[CLOCK_MC]);
+
+  Counter skipped = periods * m_clock_lcm;
+  m_MMU->skip_cycles(skipped);
+  m_simulation_cycle += skipped;
+  STAT_EVENT_N(CYC_COUNT_TOT, skipped);
+  this->acc_nooped_cycles += skipped;
+  m_skipped_cycles += skipped;
+  m_num_skips++;
+  the_clock_pt->set_time_sim(m_simulation_cycle / (*KNOB(KNOB_CLOCK_CPU)));
 }
 
 
@@ -105,6 +105,18 @@ public:
 
   void stat_stalls(FILE* fout);
 
+  /**
+   * Whether every started core is stalled, no cache, MMU or memory controller
+   * has work, and every outstanding miss waits on the SSD
+   */
+  bool is_quiescent(void);
+
+  /**
+   * Fast-forward over quiescent cycles up to the next SSD completion, sleeping
+   * agent or fetch resume, whichever comes first (agent_horizon in ns)
+   */
+  void skip_quiescent_cycles(int64_t agent_horizon);
+
   /**
    * Finalize simulation (wrapper)
    */
@@ -204,6 +216,8 @@ public:
   uint64_t m_hmc_trans_id_gen;
   Counter acc_nooped_cycles = 0;
   Counter acc_retired_insts = 0;
+  Counter m_skipped_cycles = 0; /**< cycles fast-forwarded while quiescent */
+  Counter m_num_skips = 0; /**< number of fast-forwards */
   int m_num_active_threads; /**< number of active threads */
   int
     m_num_waiting_dispatched_threads; /**< number of threads waiting for begin dispatched */
@@ -245,6 +259,7 @@ public:
   dram_c **m_dram_controller; /**< dram controller */
   int m_num_mc; /**< number of memory controllers */
   trace_reader_wrapper_c *m_trace_reader; /**< trace reader */
+  trace_decoder_c *m_trace_decoder; /**< background trace decompression */
 
   // bug detector
   bug_detector_c *m_bug_detector; /**< bug detector */
@@ -34,9 +34,13 @@ POSSIBILITY OF SUCH DAMAGE.
  * Description  : main file
  *********************************************************************************************/
 
+#include <deque>
 #include <filesystem>
+#include <functional>
 #include <iostream>
 #include <fstream>
+#include <map>
+#include <thread>
 #include <sstream>
 #include <unordered_set>
 #include <set>
@@ -47,12 +51,17 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <sys/wait.h>
 
 #include "SkyByte-Sim/trace_utils.h"
 #include "SkyByte-Sim/ssd_stat.h"
+#include "SkyByte-Sim/interval_stat.h"
 #include "SkyByte-Sim/cpu_scheduler.h"
 #include "SkyByte-Sim/utils.h"
 #include "SkyByte-Sim/ftl.h"
+#include "SkyByte-Sim/cache.h"
+#include "SkyByte-Sim/ssd_prefetch.h"
+#include "SkyByte-Sim/cxl_link.h"
 #include "SkyByte-Sim/simulator_clock.h"
 
 
@@ -90,11 +99,21 @@ extern ssd gdev;
 //Parameters:
 extern bool promotion_enable;
 extern bool write_log_enable;
+extern bool multi_stream_enable;
+extern bool temperature_classify;
+extern bool nand_timing_detailed;
+extern bool nand_suspend_enable;
+extern bool nand_cache_ops;
+extern nand_sched_policy_enum nand_sched_policy;
+extern uint64_t nand_sched_max_delay;
 extern bool device_triggered_ctx_swt;
 extern long cs_threshold;
 
 extern long ssd_cache_size_byte;
 extern int ssd_cache_way;
+extern int ssd_fill_per_channel;
+extern repl_policy_enum ssd_cache_policy;
+extern repl_policy_enum host_dram_policy;
 extern long host_dram_size_byte;
 
 string baseline_config_filename;
@@ -104,6 +123,8 @@ string workload_name;
 
 double ssd_host_rate = 0;
 extern double write_log_ratio;
+extern uint64_t log_writer_threads;
+extern uint64_t flush_threads;
 
 string btype;
 string bench;
@@ -127,8 +148,16 @@ unordered_set<uint64_t> prefill_pages;
 bool prefill_pass = false;
 ThreadScheduler* skybyte_scheduler_pt;
 bool dram_only = false;
+bool event_skip_enable = false;
+bool warmup_checkpoint = true;
 bool dram_baseline = false;
 std::vector<uint64_t> ordered_vector;
+// prefill_pages and ordered_vector were loaded by the batch parent, shared by its runs
+static bool prefill_shared = false;
+// a child of a batch, its warmup passes exit with BATCH_EXIT_WARMUP_PASS
+static bool batch_child = false;
+/* a run that stopped after writing warmup hints, the batch starts it again */
+#define BATCH_EXIT_WARMUP_PASS 3
 uint64_t mark_inst_num = 0;
 
 int64_t cache_marked_num = 0;
@@ -194,6 +223,133 @@ std::string extractFilename(const std::string& path) {
     return path;
 }
 
+/*
+ * Load the binary warmup snapshot base.snap. Without one, from_text converts
+ * the text files older versions wrote and the result is saved as base.snap.
+ * Returns false if neither exists.
+ */
+static bool load_warmup_snapshot(const std::string& base, snapshot_file* snap,
+                                 const std::function<bool(snapshot_writer*)>& from_text) {
+  std::string path = base + SNAPSHOT_SUFFIX;
+  if (snapshot_load(snap, path))
+    return true;
+  snapshot_writer w;
+  if (!from_text(&w))
+    return false;
+  bytefs_log("Converting text warmup files of %s to %s", base.c_str(), path.c_str());
+  bytefs_assert_msg(snapshot_save(&w, path) && snapshot_load(snap, path),
+                    "cannot write snapshot %s", path.c_str());
+  return true;
+}
+
+/* the workload config file name without directory and extension */
+static std::string workload_basename(const std::string& workload_config) {
+  std::string name = extractFilename(workload_config);
+  size_t last_dot = name.find_last_of('.');
+  if (last_dot != std::string::npos && last_dot < name.length() - 1) {
+      name = name.substr(0, last_dot);
+  }
+  return name;
+}
+
+/* prefill pages in ascending order, already built when shared by a batch */
+static void build_ordered_vector() {
+  if (prefill_shared)
+    return;
+  ordered_vector.clear();
+  ordered_vector.reserve(prefill_pages.size());
+  for (const auto& element : prefill_pages) {
+      ordered_vector.push_back(element);
+  }
+  std::sort(ordered_vector.begin(), ordered_vector.end());
+}
+
+/* one run of a batch, what -b, -t and -f give a single run */
+struct batch_run {
+  std::string baseline;
+  std::string setting;
+  std::string bench;
+};
+
+/*
+ * Batch file: one run per line, "<baseline config> <setting config or -> <output name>",
+ * lines starting with # are comments.
+ */
+static std::vector<batch_run> read_batch_file(const std::string& path) {
+  std::ifstream batch_file(path);
+  if (!batch_file.good()) {
+    printf("Batch file <%s> does not exist\n", path.c_str());
+    assert(false);
+  }
+  std::vector<batch_run> runs;
+  std::string line;
+  while (std::getline(batch_file, line)) {
+    std::stringstream ss(line);
+    batch_run run;
+    if (!(ss >> run.baseline) || run.baseline[0] == '#')
+      continue;
+    if (!(ss >> run.setting >> run.bench)) {
+      printf("Error: Invalid batch entry <%s>, aborting...\n", line.c_str());
+      assert(false);
+    }
+    if (run.setting == "-")
+      run.setting.clear();
+    runs.push_back(run);
+  }
+  return runs;
+}
+
+/*
+ * Forks one process per run, at most jobs at a time. What the caller loaded
+ * before is shared copy-on-write, so a run only pays for the memory it writes.
+ * Until shared_ready() reports the per-workload warmup state loaded, one run
+ * is in flight at a time, so only that run does the workload's prefill pass.
+ * A run that exits after a warmup pass is started again until it completes.
+ * Returns the run to execute in a child, nullptr in the parent once all runs
+ * exited, *failed being the number that did not exit cleanly.
+ */
+static const batch_run* fork_batch_runs(const std::vector<batch_run>& runs, int jobs, int* failed,
+                                        const std::function<bool(void)>& shared_ready) {
+  std::map<pid_t, const batch_run*> running;
+  std::deque<const batch_run*> pending;
+  for (const batch_run& run : runs)
+    pending.push_back(&run);
+  *failed = 0;
+  while (!pending.empty() || !running.empty()) {
+    int limit = shared_ready() ? jobs : 1;
+    if (!pending.empty() && (int) running.size() < limit) {
+      fflush(stdout);
+      fflush(stderr);
+      pid_t pid = fork();
+      assert(pid >= 0);
+      if (pid == 0)
+        return pending.front();
+      printf("Batch: %s started (pid %d)\n", pending.front()->bench.c_str(), pid);
+      running[pid] = pending.front();
+      pending.pop_front();
+      continue;
+    }
+    int status;
+    pid_t pid = wait(&status);
+    if (pid < 0)
+      break;
+    auto it = running.find(pid);
+    if (it == running.end())
+      continue;
+    if (WIFEXITED(status) && WEXITSTATUS(status) == BATCH_EXIT_WARMUP_PASS) {
+      printf("Batch: %s warmup pass done\n", it->second->bench.c_str());
+      pending.push_front(it->second);
+      running.erase(it);
+      continue;
+    }
+    bool ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    *failed += !ok;
+    printf("Batch: %s %s\n", it->second->bench.c_str(), ok ? "done" : "FAILED");
+    running.erase(it);
+  }
+  return nullptr;
+}
+
 // input parameter parsing
   param param;
 
@@ -209,8 +365,11 @@ int main(int argc, char** argv) {
 
   // param.logical_core_num = 0;
 
+  std::string batch_filename;
+  int batch_jobs = std::thread::hardware_concurrency();
+
   int opt;
-  while ((opt = getopt(argc, argv, "rhpdw:c:o:b:f:s:t:")) != -1) {
+  while ((opt = getopt(argc, argv, "rhpdw:c:o:b:f:s:t:m:j:")) != -1) {
     switch (opt) {
       case 'w': {
         workload_config_filename = optarg;
@@ -247,6 +406,14 @@ int main(int argc, char** argv) {
         dram_baseline = true;
         break;
       }
+      case 'm': {
+        batch_filename = optarg;
+        break;
+      }
+      case 'j': {
+        batch_jobs = stoi(optarg);
+        break;
+      }
       case 's' :{
         int type = stoi(optarg);
         if (type==1)
@@ -275,11 +442,60 @@ int main(int argc, char** argv) {
         printf("  -o  output status redirect tty\n");
         printf("  -f  output file name\n");
         printf("  -p  print timing model\n");
+        printf("  -m  batch file, runs its configs instead of -b/-t/-f\n");
+        printf("  -j  number of batch runs at a time\n");
         return -1;
       }
     }
   }
 
+  // batch mode: the prefill pages are loaded once, every run is a child sharing them
+  if (!batch_filename.empty())
+  {
+    std::vector<batch_run> runs = read_batch_file(batch_filename);
+    if (batch_jobs <= 0) {
+      printf("Error: Invalid number of batch jobs %d, aborting...\n", batch_jobs);
+      assert(false);
+    }
+
+    std::string shared_prefill_path = "../output/warmup_traces/" +
+        workload_basename(workload_config_filename) + "_prefill_data" + SNAPSHOT_SUFFIX;
+    // written by the first run on a fresh workload, loaded here once it exists
+    auto load_shared_prefill = [&]() {
+      snapshot_file shared_prefill;
+      if (dram_baseline || prefill_shared)
+        return true;
+      if (!snapshot_load(&shared_prefill, shared_prefill_path))
+        return false;
+      uint64_t prefill_size = 0;
+      const uint64_t* pages = snapshot_section_data(&shared_prefill, SNAP_PREFILL_PAGES, &prefill_size);
+      bytefs_assert_msg(pages, "snapshot has no prefill pages");
+      prefill_pages.reserve(prefill_size);
+      prefill_pages.insert(pages, pages + prefill_size);
+      ordered_vector.assign(pages, pages + prefill_size);
+      snapshot_unload(&shared_prefill);
+      prefill_shared = true;
+      return true;
+    };
+
+    int failed = 0;
+    const batch_run* run = fork_batch_runs(runs, batch_jobs, &failed, load_shared_prefill);
+    if (run == nullptr)
+    {
+      printf("Batch: %lu runs, %d failed\n", runs.size(), failed);
+      return failed ? 1 : 0;
+    }
+    baseline_config_filename = run->baseline;
+    setting_config_filename = run->setting;
+    bench = run->bench;
+    batch_child = true;
+    // the runs would interleave on the terminal, each logs to its own file
+    std::string log_filename = "../output/" + bench + ".log";
+    bytefs_assert_msg(freopen(log_filename.c_str(), "w", stdout), "cannot open %s", log_filename.c_str());
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    dup2(fileno(stdout), fileno(stderr));
+  }
+
   std::string t_policy_name;
   t_policy = Thread_Policy_enum::RR; //Default
 
@@ -314,7 +530,66 @@ int main(int argc, char** argv) {
         // size settings
         else if (command == "ssd_cache_size_byte")      { ssd_cache_size_byte = std::stoul(value); }
         else if (command == "ssd_cache_way")            { ssd_cache_way = std::stoi(value); }
+        else if (command == "ssd_fill_per_channel")     { ssd_fill_per_channel = std::stoi(value); assert(ssd_fill_per_channel >= 0); }
+        else if (command == "ssd_cache_policy" || command == "host_dram_policy") {
+          repl_policy_enum policy;
+          if (!parse_repl_policy(value, &policy)) {
+            printf("Error: Invalid replacement policy <%s> for <%s>, aborting...\n", value.c_str(), command.c_str());
+            assert(false);
+          }
+          if (command == "ssd_cache_policy") ssd_cache_policy = policy;
+          else host_dram_policy = policy;
+        }
         else if (command == "host_dram_size_byte")      { host_dram_size_byte = std::stoul(value); }
+        // garbage collection
+        else if (command == "gc_policy") {
+          if (!parse_gc_policy(value, &gc_policy)) {
+            printf("Error: Invalid GC policy <%s>, aborting...\n", value.c_str());
+            assert(false);
+          }
+        }
+        else if (command == "gc_fg_threshold")          { gc_fg_threshold = std::stoi(value); }
+        else if (command == "gc_bg_threshold")          { gc_bg_threshold = std::stoi(value); }
+        else if (command == "multi_stream_enable")      { multi_stream_enable = std::stoi(value) != 0; }
+        else if (command == "temperature_classify")     { temperature_classify = std::stoi(value) != 0; }
+        // NAND timing model
+        else if (command == "nand_timing_detailed")     { nand_timing_detailed = std::stoi(value) != 0; }
+        else if (command == "nand_suspend_enable")      { nand_suspend_enable = std::stoi(value) != 0; }
+        else if (command == "nand_cache_ops")           { nand_cache_ops = std::stoi(value) != 0; }
+        // fast-forward macsim over cycles the cores only wait on the SSD
+        else if (command == "event_skip_enable")        { event_skip_enable = std::stoi(value) != 0; }
+        else if (command == "warmup_checkpoint")        { warmup_checkpoint = std::stoi(value) != 0; }
+        // time series of the SSD model
+        else if (command == "stat_interval_us")         { stat_interval_us = std::stoul(value); }
+        else if (command == "stat_interval_fields") {
+          if (!parse_interval_fields(value)) {
+            printf("Error: Invalid interval stat fields <%s>, aborting...\n", value.c_str());
+            assert(false);
+          }
+        }
+        // page prefetcher of the SSD cache
+        else if (command == "ssd_prefetch_enable")      { ssd_prefetch_enable = std::stoi(value) != 0; }
+        else if (command == "ssd_prefetch_degree")      { ssd_prefetch_degree = std::stoi(value); assert(ssd_prefetch_degree > 0); }
+        else if (command == "ssd_prefetch_streams")     { ssd_prefetch_streams = std::stoi(value); assert(ssd_prefetch_streams > 0); }
+        // CXL.mem link model
+        else if (command == "cxl_link_enable")          { cxl_link_enable = std::stoi(value) != 0; }
+        else if (command == "cxl_link_gen")             { cxl_link_gen = std::stoi(value); assert(cxl_link_gen >= 1 && cxl_link_gen <= 3); }
+        else if (command == "cxl_link_lanes") {
+          cxl_link_lanes = std::stoi(value);
+          if (cxl_link_lanes <= 0 || cxl_link_lanes > 16 || (cxl_link_lanes & (cxl_link_lanes - 1))) {
+            printf("Error: Invalid CXL link width <%s>, aborting...\n", value.c_str());
+            assert(false);
+          }
+        }
+        else if (command == "cxl_link_credits")         { cxl_link_credits = std::stoi(value); assert(cxl_link_credits > 0); }
+        // NAND scheduler
+        else if (command == "nand_sched_policy") {
+          if (!parse_nand_sched_policy(value, &nand_sched_policy)) {
+            printf("Error: Invalid NAND scheduler policy <%s>, aborting...\n", value.c_str());
+            assert(false);
+          }
+        }
+        else if (command == "nand_sched_max_delay")     { nand_sched_max_delay = std::stoul(value); }
         // comments or empty line
         else if (command == "#" || command == "")       {}
         else {
@@ -323,6 +598,24 @@ int main(int argc, char** argv) {
         }
     }
 
+  if (!gc_thresholds_valid()) {
+    printf("Error: Invalid GC thresholds fg <%d> bg <%d>, aborting...\n", gc_fg_threshold, gc_bg_threshold);
+    assert(false);
+  }
+
+  // hot pages need a stream of their own to go to
+  if (temperature_classify && !multi_stream_enable) {
+    printf("Error: temperature_classify requires multi_stream_enable, aborting...\n");
+    assert(false);
+  }
+
+  // the detailed model orders commands per plane and suspends programs itself
+  if (nand_sched_policy != NSCHED_FIFO && nand_timing_detailed) {
+    printf("Error: nand_sched_policy <%s> requires the simple NAND timing model, aborting...\n",
+           nand_sched_policy_name(nand_sched_policy));
+    assert(false);
+  }
+
   if (t_policy_name == "RR") {
     t_policy = Thread_Policy_enum::RR;
   } else if (t_policy_name == "RANDOM") {
@@ -396,6 +689,8 @@ int main(int argc, char** argv) {
           else if (command == "ssd_host_rate")            { ssd_host_rate = std::stof(value); ssd_cache_size_byte = (long) (host_dram_size_byte * ssd_host_rate);}
           else if (command == "cs_threshold")             { cs_threshold = std::stoul(value); }
           else if (command == "write_log_ratio")          { write_log_ratio = std::stof(value); }
+          else if (command == "log_writer_threads")       { log_writer_threads = std::stoul(value); assert(log_writer_threads > 0); }
+          else if (command == "flush_threads")            { flush_threads = std::stoul(value); assert(flush_threads > 0); }
           // comments or empty line
           else if (command == "#" || command == "")       {}
           else {
@@ -437,9 +732,7 @@ int main(int argc, char** argv) {
   output_file = fopen(main_filename.c_str(), "w");
   
 
-  FILE* prefill_and_warmup_data_file;
-
-  FILE* prefill_data_file_read;
+  snapshot_file prefill_snapshot;
 
   // auto it = std::next(baseline_config_filename.begin(), baseline_config_filename.find('.'));
   // baseline_config_filename.erase(it, std::next(it, 7));
@@ -462,39 +755,44 @@ int main(int argc, char** argv) {
   bytefs_log("Data fill BEGIN");
   uint64_t start_timestamp = (uint64_t) -1;
 
-  workload_name = extractFilename(workload_config_filename);
-  size_t last_dot = workload_name.find_last_of('.');
-    
-  // Extract the substring starting from the position after the last slash
-  if (last_dot != std::string::npos && last_dot < workload_name.length() - 1) {
-      workload_name = workload_name.substr(0, last_dot);
-  }
+  workload_name = workload_basename(workload_config_filename);
 
   std::string warmup_trace_workload_name = "../output/warmup_traces/" + workload_name;
   workload_name = "../output/" + workload_name;
 
-  string workload_dram_prefill = warmup_trace_workload_name + "_prefill_data.txt";
+  string workload_dram_prefill = warmup_trace_workload_name + "_prefill_data";
 
 
   if (!dram_baseline) 
   {
-    prefill_data_file_read = fopen((workload_dram_prefill).c_str(), "r");
-    if (prefill_data_file_read != NULL)
+    bool have_prefill = prefill_shared || load_warmup_snapshot(workload_dram_prefill, &prefill_snapshot,
+        [&](snapshot_writer* w) {
+          FILE* text = fopen((workload_dram_prefill + ".txt").c_str(), "r");
+          if (text == NULL)
+            return false;
+          std::vector<uint64_t> size, pages;
+          bool ok = snapshot_read_text(text, size, 1) && snapshot_read_text(text, pages, size[0]);
+          fclose(text);
+          std::sort(pages.begin(), pages.end());
+          snapshot_add(w, SNAP_PREFILL_PAGES, std::move(pages));
+          return ok;
+        });
+    if (have_prefill)
     {
       if (dram_only)
       {
         return 0;
       }
       
-      uint64_t page;
-      uint64_t prefill_size = 0;
-      assert(fscanf(prefill_data_file_read, "%ld", &prefill_size));
-      for (size_t i = 0; i < prefill_size; i++)
+      if (!prefill_shared)
       {
-        assert(fscanf(prefill_data_file_read, "%ld", &page));
-        prefill_pages.insert(page);
+        uint64_t prefill_size = 0;
+        const uint64_t* pages = snapshot_section_data(&prefill_snapshot, SNAP_PREFILL_PAGES, &prefill_size);
+        bytefs_assert_msg(pages, "snapshot has no prefill pages");
+        prefill_pages.reserve(prefill_size);
+        prefill_pages.insert(pages, pages + prefill_size);
+        snapshot_unload(&prefill_snapshot);
       }
-      fclose(prefill_data_file_read);
     }
     else
     {
@@ -594,32 +892,14 @@ DRAM_profiling:
     }
     
 
-    prefill_and_warmup_data_file = fopen((workload_dram_prefill).c_str(), "w");
-  
-    // Define a vector to store elements in order
-      ordered_vector.clear();
-
-      // Reserve space in the vector to avoid reallocations
-      ordered_vector.reserve(prefill_pages.size());
-
-      // Traverse the unordered set and insert elements into the ordered vector
-      for (const auto& element : prefill_pages) {
-          ordered_vector.push_back(element);
-      }
-
-      // Sort the vector to maintain the order
-      std::sort(ordered_vector.begin(), ordered_vector.end());
+    build_ordered_vector();
 
       std::cout << ordered_vector.front() << std::endl;
       std::cout << ordered_vector.back() << std::endl;
     
-    fprintf(prefill_and_warmup_data_file, "%ld\n", ordered_vector.size());
-
-    for (auto page : ordered_vector) {
-      fprintf(prefill_and_warmup_data_file, "%ld\n", page);
-    }
-
-    fclose(prefill_and_warmup_data_file);
+    snapshot_writer prefill_writer;
+    snapshot_add(&prefill_writer, SNAP_PREFILL_PAGES, std::vector<uint64_t>(ordered_vector));
+    snapshot_save(&prefill_writer, workload_dram_prefill + SNAPSHOT_SUFFIX);
 
     if (dram_only || dram_baseline)
     {
@@ -630,8 +910,38 @@ DRAM_profiling:
   }
   //Start the warmup pass!
 
-  FILE* warmup_hint_data_file = fopen((bench_wmp + "_warmup_hint_dram_system.txt").c_str(),"r");
-  if (warmup_hint_data_file == NULL) //Need to run one time warmup with pinatrace
+  // the whole post-warmup state, shared by the configs of this workload with the same key
+  char checkpoint_key[17];
+  snprintf(checkpoint_key, sizeof(checkpoint_key), "%016lx", warmup_checkpoint_key());
+  std::string checkpoint_path = warmup_trace_workload_name + "_ckpt_" + checkpoint_key + SNAPSHOT_SUFFIX;
+  snapshot_file checkpoint;
+  bool have_checkpoint = warmup_checkpoint && snapshot_load(&checkpoint, checkpoint_path);
+  // a stale or truncated checkpoint is warmed up again and overwritten
+  if (have_checkpoint && !warmup_checkpoint_valid(&checkpoint))
+  {
+    bytefs_log("Discarding checkpoint %s, its layout does not match this build", checkpoint_path.c_str());
+    snapshot_unload(&checkpoint);
+    have_checkpoint = false;
+  }
+
+  snapshot_file dram_system_snapshot;
+  bool have_dram_system = have_checkpoint || load_warmup_snapshot(bench_wmp + "_warmup_hint_dram_system", &dram_system_snapshot,
+      [&](snapshot_writer* w) {
+        FILE* text = fopen((bench_wmp + "_warmup_hint_dram_system.txt").c_str(), "r");
+        if (text == NULL)
+          return false;
+        bool ok = dram_system_from_text(text, w);
+        fclose(text);
+        if (ok && tpp_enable)
+        {
+          FILE* text_tpp = fopen((bench_wmp + "_warmup_hint_tpp_system.txt").c_str(), "r");
+          ok = text_tpp != NULL && tpp_system_from_text(text_tpp, w);
+          if (text_tpp != NULL)
+            fclose(text_tpp);
+        }
+        return ok;
+      });
+  if (!have_dram_system) //Need to run one time warmup with pinatrace
   {
     the_clock_pt = &the_clock;
 
@@ -642,19 +952,7 @@ DRAM_profiling:
     bytefs_log("SSD init END");
     
 
-    // Define a vector to store elements in order
-      ordered_vector.clear();
-
-      // Reserve space in the vector to avoid reallocations
-      ordered_vector.reserve(prefill_pages.size());
-
-      // Traverse the unordered set and insert elements into the ordered vector
-      for (const auto& element : prefill_pages) {
-          ordered_vector.push_back(element);
-      }
-
-      // Sort the vector to maintain the order
-      std::sort(ordered_vector.begin(), ordered_vector.end());
+    build_ordered_vector();
 
     std::cout << ordered_vector.front() << std::endl;
     std::cout << ordered_vector.back() << std::endl;
@@ -675,7 +973,7 @@ DRAM_profiling:
     unordered_set<uint64_t> pinatrace_pages;
     for (string filename : param.trace_filenames) {
       TraceReplayUnit tru;
-      trace_sample *sample;
+      const trace_sample *sample;
       tru.init(filename);
       printf("Loading file %s\n", filename.c_str());
       while ((sample = tru.getCurrentTraceSample()) != nullptr) {
@@ -772,20 +1070,18 @@ DRAM_profiling:
       bytefs_log("Service threads stopped");
 
       //copy the caches in the DRAM subsystem
-      warmup_hint_data_file = fopen((bench_wmp + "_warmup_hint_dram_system.txt").c_str(),"w");
-      copy_dram_system(warmup_hint_data_file);
+      snapshot_writer dram_system_writer;
+      copy_dram_system(&dram_system_writer);
 
       //TPP only: copy states in TPP system
       if (tpp_enable)
       {
-        FILE* warmup_hint_data_file_tpp = fopen((bench_wmp + "_warmup_hint_tpp_system.txt").c_str(),"w");
-        copy_tpp_system(warmup_hint_data_file_tpp);
-        fclose(warmup_hint_data_file_tpp);
+        copy_tpp_system(&dram_system_writer);
       }
 
-      fclose(warmup_hint_data_file);
+      snapshot_save(&dram_system_writer, bench_wmp + "_warmup_hint_dram_system" + SNAPSHOT_SUFFIX);
 
-      return 0;
+      return batch_child ? BATCH_EXIT_WARMUP_PASS : 0;
   }
   else
   {
@@ -798,19 +1094,7 @@ DRAM_profiling:
       bytefs_log("SSD init END");
       
 
-      // Define a vector to store elements in order
-        ordered_vector.clear();
-
-        // Reserve space in the vector to avoid reallocations
-        ordered_vector.reserve(prefill_pages.size());
-
-        // Traverse the unordered set and insert elements into the ordered vector
-        for (const auto& element : prefill_pages) {
-            ordered_vector.push_back(element);
-        }
-
-        // Sort the vector to maintain the order
-        std::sort(ordered_vector.begin(), ordered_vector.end());
+      build_ordered_vector();
 
       std::cout << ordered_vector.front() << std::endl;
       std::cout << ordered_vector.back() << std::endl;
@@ -819,19 +1103,29 @@ DRAM_profiling:
       fprintf(output_file, "Total Data Footprint: %ld kB (%.3f GB)\n",
           total_footprint_kb, total_footprint_kb / 1024.0 / 1024.0);
 
+    if (have_checkpoint)
+    {
+      bytefs_log("Restoring warmup checkpoint %s", checkpoint_path.c_str());
+      reset_ssd_stat();
+      turn_on_stat();
+      bytefs_assert_msg(restore_warmup_checkpoint(&checkpoint),
+                        "checkpoint %s does not match this config", checkpoint_path.c_str());
+      snapshot_unload(&checkpoint);
+    }
+    else
+    {
       for (auto page : ordered_vector) {
         bytefs_fill_data(page);
       }
 
       //First time prefill (for the incoming macsim trace) done!
 
-      replay_dram_system(warmup_hint_data_file);
+      replay_dram_system(&dram_system_snapshot);
       if (tpp_enable)
       {
-        FILE* warmup_hint_data_file_tpp = fopen((bench_wmp + "_warmup_hint_tpp_system.txt").c_str(),"r");
-        replay_tpp_system(warmup_hint_data_file_tpp);
-        fclose(warmup_hint_data_file_tpp);
+        replay_tpp_system(&dram_system_snapshot);
       }
+      snapshot_unload(&dram_system_snapshot);
 
       std::cout<<"DRAM Subsystem warmup Replay done!"<<std::endl;
 
@@ -841,10 +1135,23 @@ DRAM_profiling:
       }
 
       ssd_backend_reset_timestamp();
+    }
 
 
-    FILE* warmup_hint_data_file_2 = fopen((bench_wmp + "_warmup_hint_data_wlog.txt").c_str(),"r");
-    if (warmup_hint_data_file_2 == NULL && write_log_enable)
+    // read pages, written pages and the 64 modified cacheline buckets of the log flush
+    snapshot_file wlog_snapshot;
+    bool have_wlog = have_checkpoint || load_warmup_snapshot(bench_wmp + "_warmup_hint_data_wlog", &wlog_snapshot,
+        [&](snapshot_writer* w) {
+          FILE* text = fopen((bench_wmp + "_warmup_hint_data_wlog.txt").c_str(), "r");
+          if (text == NULL)
+            return false;
+          std::vector<uint64_t> hint;
+          bool ok = snapshot_read_text(text, hint, 2 + 64);
+          fclose(text);
+          snapshot_add(w, SNAP_WLOG_HINT, std::move(hint));
+          return ok;
+        });
+    if (!have_wlog && write_log_enable)
     {
       //Second time wram up run begins
 
@@ -917,41 +1224,33 @@ DRAM_profiling:
         read_pgnum = read_write_num.first;
         write_pgnum = read_write_num.second;
       }
-      warmup_hint_data_file_2 = fopen((bench_wmp + "_warmup_hint_data_wlog.txt").c_str(),"w");
-
-      fprintf(warmup_hint_data_file_2, "%ld\n", read_pgnum);
-      fprintf(warmup_hint_data_file_2, "%ld\n", write_pgnum);
-      for (size_t i = 0; i < 64; i++)
-      {
-        fprintf(warmup_hint_data_file_2, "%ld\n", tmp_array[i]);
-      }
-
-      fclose(warmup_hint_data_file_2);
+      std::vector<uint64_t> hint = {read_pgnum, write_pgnum};
+      hint.insert(hint.end(), tmp_array, tmp_array + 64);
+      snapshot_writer wlog_writer;
+      snapshot_add(&wlog_writer, SNAP_WLOG_HINT, std::move(hint));
+      snapshot_save(&wlog_writer, bench_wmp + "_warmup_hint_data_wlog" + SNAPSHOT_SUFFIX);
 
       print_stat();
-      return 0;
+      return batch_child ? BATCH_EXIT_WARMUP_PASS : 0;
 
     }
     else
     {  
         need_mark = false;
 
+      if (!have_checkpoint)
+      {
         reset_ssd_stat();
         turn_on_stat();
 
         if (write_log_enable)
         {
-          uint64_t read_pgnum = 0;
-          uint64_t write_pgnum = 0;
-          uint64_t tmp_array[64];
-
-
-          assert(fscanf(warmup_hint_data_file_2, "%ld", &read_pgnum));
-          assert(fscanf(warmup_hint_data_file_2, "%ld", &write_pgnum));
-          for (size_t i = 0; i < 64; i++)
-          {
-            assert(fscanf(warmup_hint_data_file_2, "%ld", &tmp_array[i]));
-          } 
+          uint64_t hint_len = 0;
+          const uint64_t* hint = snapshot_section_data(&wlog_snapshot, SNAP_WLOG_HINT, &hint_len);
+          bytefs_assert_msg(hint && hint_len == 2 + 64, "snapshot has no write log hint");
+          uint64_t read_pgnum = hint[0];
+          uint64_t write_pgnum = hint[1];
+          const uint64_t* tmp_array = hint + 2;
           //Warmup for write log
           warmup_write_log(read_pgnum, write_pgnum);
 
@@ -961,6 +1260,8 @@ DRAM_profiling:
           }
 
         }
+        snapshot_unload(&wlog_snapshot);
+      }
         
         // warmup_ssd_dram(warmup_dirty_ratio_cache, warmup_dirty_ratio_dram, read_pgnum, write_pgnum, cache_overall_cover_rate, 
         // host_overall_cover_rate, cache_uncovered_dirty_rate, host_uncovered_dirty_rate);
@@ -982,8 +1283,22 @@ DRAM_profiling:
         std::sort(ordered_memory_space.begin(), ordered_memory_space.end());
       }
 
-      prefill_pages.clear();
-      ordered_vector.clear();
+      if (warmup_checkpoint && !have_checkpoint)
+      {
+        snapshot_writer checkpoint_writer;
+        save_warmup_checkpoint(&checkpoint_writer);
+        if (snapshot_save(&checkpoint_writer, checkpoint_path))
+          bytefs_log("Warmup checkpoint saved to %s", checkpoint_path.c_str());
+        else
+          bytefs_err("Cannot write warmup checkpoint %s", checkpoint_path.c_str());
+      }
+
+      // shared pages stay untouched, freeing them would copy them into this run
+      if (!prefill_shared)
+      {
+        prefill_pages.clear();
+        ordered_vector.clear();
+      }
 
       ssd *ssd = &gdev;
 
@@ -997,7 +1312,7 @@ DRAM_profiling:
       bytefs_log("Scheduler online");
       sleep(1);
 
-      
+      interval_stat_start(main_filename + "_intervals.csv", the_clock_pt->get_time_sim());
 
       scheduler.startExecution();
 
@@ -1034,6 +1349,7 @@ DRAM_profiling:
       the_clock_pt->force_finish();
       bytefs_stop_threads_gracefully();
       bytefs_log("Service threads stopped");
+      interval_stat_stop(the_clock_pt->get_time_sim());
 
       print_stat();
 
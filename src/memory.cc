@@ -704,6 +704,12 @@ void dcu_c::run_a_cycle(bool pll_lock) {
   ++m_cycle;
 }
 
+bool dcu_c::is_idle(void) {
+  return m_in_queue->m_entry.empty() && m_wb_queue->m_entry.empty() &&
+         m_fill_queue->m_entry.empty() && m_out_queue->m_entry.empty() &&
+         m_retry_queue.empty();
+}
+
 // Main cache access function
 // process requests in the input queue
 // input queue:
@@ -1569,6 +1575,189 @@ void dcu_c::invalidate(Addr addr) {
 
 ///////////////////////////////////////////////////////////////////////////////////////////////
 
+// line granularity of the MSHR index
+#define MSHR_LINE_SHIFT 6
+// entries covering more lines are searched linearly
+#define MSHR_MAX_INDEX_LINES 4
+
+// =======================================
+// mshr_c constructor
+// =======================================
+mshr_c::mshr_c(macsim_c* simBase, int size) {
+  m_simBase = simBase;
+  m_size = size;
+  m_num_free = size;
+  m_head = -1;
+  m_tail = -1;
+  m_seq = 0;
+
+  m_slot = new slot_s[m_size];
+  for (int ii = 0; ii < m_size; ++ii) {
+    m_slot[ii].m_req = new mem_req_s(simBase);
+    m_slot[ii].m_req->m_mshr = this;
+    m_slot[ii].m_req->m_mshr_slot = ii;
+    m_slot[ii].m_prev = -1;
+    m_slot[ii].m_next = ii + 1 < m_size ? ii + 1 : -1;
+    m_slot[ii].m_seq = 0;
+    m_slot[ii].m_line = 0;
+    m_slot[ii].m_num_lines = 0;
+    m_slot[ii].m_wide = false;
+  }
+  m_free = m_size > 0 ? 0 : -1;
+
+  // keep the index at most half full
+  m_index_bits = 4;
+  while ((1 << m_index_bits) < 2 * m_size * MSHR_MAX_INDEX_LINES)
+    ++m_index_bits;
+  m_index = new index_s[1 << m_index_bits];
+  for (int ii = 0; ii < (1 << m_index_bits); ++ii) m_index[ii].m_slot = -1;
+}
+
+// mshr_c destructor
+mshr_c::~mshr_c() {
+  for (int ii = 0; ii < m_size; ++ii) delete m_slot[ii].m_req;
+  delete[] m_slot;
+  delete[] m_index;
+}
+
+// allocate an entry at the tail of the allocation order
+mem_req_s* mshr_c::allocate(void) {
+  if (m_free == -1) return NULL;
+
+  int slot = m_free;
+  m_free = m_slot[slot].m_next;
+  --m_num_free;
+
+  m_slot[slot].m_seq = m_seq++;
+  m_slot[slot].m_prev = m_tail;
+  m_slot[slot].m_next = -1;
+  if (m_tail != -1)
+    m_slot[m_tail].m_next = slot;
+  else
+    m_head = slot;
+  m_tail = slot;
+
+  return m_slot[slot].m_req;
+}
+
+// free an entry; the index is cleared from the recorded lines, not m_addr
+void mshr_c::free(mem_req_s* req) {
+  ASSERT(req->m_mshr == this);
+  int slot = req->m_mshr_slot;
+  unindex(slot);
+
+  if (m_slot[slot].m_prev != -1)
+    m_slot[m_slot[slot].m_prev].m_next = m_slot[slot].m_next;
+  else
+    m_head = m_slot[slot].m_next;
+  if (m_slot[slot].m_next != -1)
+    m_slot[m_slot[slot].m_next].m_prev = m_slot[slot].m_prev;
+  else
+    m_tail = m_slot[slot].m_prev;
+
+  m_slot[slot].m_next = m_free;
+  m_free = slot;
+  ++m_num_free;
+}
+
+// re-index an entry
+void mshr_c::update(mem_req_s* req) {
+  ASSERT(req->m_mshr == this);
+  unindex(req->m_mshr_slot);
+  index(req->m_mshr_slot);
+}
+
+// search the earliest allocated entry covering [addr, addr + size)
+mem_req_s* mshr_c::search(Addr addr, int size) {
+  Addr line = addr >> MSHR_LINE_SHIFT;
+  int mask = (1 << m_index_bits) - 1;
+  int match = -1;
+
+  for (int ii = home(line); m_index[ii].m_slot != -1; ii = (ii + 1) & mask) {
+    int slot = m_index[ii].m_slot;
+    if (m_index[ii].m_line == line && covers(m_slot[slot].m_req, addr, size) &&
+        (match == -1 || m_slot[slot].m_seq < m_slot[match].m_seq))
+      match = slot;
+  }
+
+  for (auto I = m_wide.begin(), E = m_wide.end(); I != E; ++I) {
+    if (covers(m_slot[*I].m_req, addr, size) &&
+        (match == -1 || m_slot[*I].m_seq < m_slot[match].m_seq))
+      match = *I;
+  }
+
+  return match == -1 ? NULL : m_slot[match].m_req;
+}
+
+bool mshr_c::covers(mem_req_s* req, Addr addr, int size) {
+  return req->m_addr <= addr && req->m_addr + req->m_size >= addr + size;
+}
+
+int mshr_c::home(Addr line) {
+  return (int)((line * 0x9E3779B97F4A7C15ULL) >> (64 - m_index_bits));
+}
+
+// linear probing, a line may be indexed by several entries
+void mshr_c::insert_index(Addr line, int slot) {
+  int mask = (1 << m_index_bits) - 1;
+  int ii = home(line);
+  while (m_index[ii].m_slot != -1) ii = (ii + 1) & mask;
+  m_index[ii].m_line = line;
+  m_index[ii].m_slot = slot;
+}
+
+// backward shift deletion, so that the index needs no tombstones
+void mshr_c::remove_index(Addr line, int slot) {
+  int mask = (1 << m_index_bits) - 1;
+  int ii = home(line);
+  while (m_index[ii].m_line != line || m_index[ii].m_slot != slot) {
+    ASSERT(m_index[ii].m_slot != -1);
+    ii = (ii + 1) & mask;
+  }
+
+  int jj = ii;
+  while (true) {
+    jj = (jj + 1) & mask;
+    if (m_index[jj].m_slot == -1) break;
+    // an entry may move back unless its home lies in (ii, jj]
+    int kk = home(m_index[jj].m_line);
+    if (ii <= jj ? (ii < kk && kk <= jj) : (ii < kk || kk <= jj)) continue;
+    m_index[ii] = m_index[jj];
+    ii = jj;
+  }
+  m_index[ii].m_slot = -1;
+}
+
+void mshr_c::index(int slot) {
+  mem_req_s* req = m_slot[slot].m_req;
+  Addr first = req->m_addr >> MSHR_LINE_SHIFT;
+  Addr last = (req->m_addr + (req->m_size ? req->m_size : 1) - 1) >>
+              MSHR_LINE_SHIFT;
+
+  if (last - first >= MSHR_MAX_INDEX_LINES) {
+    m_slot[slot].m_wide = true;
+    m_wide.push_back(slot);
+    return;
+  }
+
+  m_slot[slot].m_line = first;
+  m_slot[slot].m_num_lines = (int)(last - first) + 1;
+  for (int ii = 0; ii < m_slot[slot].m_num_lines; ++ii)
+    insert_index(first + ii, slot);
+}
+
+void mshr_c::unindex(int slot) {
+  if (m_slot[slot].m_wide) {
+    m_wide.remove(slot);
+    m_slot[slot].m_wide = false;
+  }
+  for (int ii = 0; ii < m_slot[slot].m_num_lines; ++ii)
+    remove_index(m_slot[slot].m_line + ii, slot);
+  m_slot[slot].m_num_lines = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
 int memory_c::m_unique_id = 0;
 
 // =======================================
@@ -1608,15 +1797,9 @@ memory_c::memory_c(macsim_c* simBase) {
   //  ASSERT(m_num_core == m_num_llc);
 
   // allocate mshr
-  m_mshr = new list<mem_req_s*>[m_num_core];
-  m_mshr_free_list = new list<mem_req_s*>[m_num_core];
-
-  for (int ii = 0; ii < m_num_core; ++ii) {
-    for (int jj = 0; jj < *m_simBase->m_knobs->KNOB_MEM_MSHR_SIZE; ++jj) {
-      mem_req_s* entry = new mem_req_s(simBase);
-      m_mshr_free_list[ii].push_back(entry);
-    }
-  }
+  m_mshr = new mshr_c*[m_num_core];
+  for (int ii = 0; ii < m_num_core; ++ii)
+    m_mshr[ii] = new mshr_c(simBase, *m_simBase->m_knobs->KNOB_MEM_MSHR_SIZE);
 
   m_mem_req_pool = new pool_c<mem_req_s>;
 
@@ -1712,8 +1895,7 @@ memory_c::~memory_c() {
   for (int ii = 0; ii < m_num_core; ++ii) {
     delete m_l1_cache[ii];
     delete m_l2_cache[ii];
-    m_mshr_free_list[ii].clear();
-    m_mshr[ii].clear();
+    delete m_mshr[ii];
   }
 
   for (int ii = 0; ii < m_num_l3; ++ii) delete m_l3_cache[ii];
@@ -1721,7 +1903,6 @@ memory_c::~memory_c() {
   for (int ii = 0; ii < m_num_llc; ++ii) delete m_llc_cache[ii];
 
   delete[] m_mshr;
-  delete[] m_mshr_free_list;
   delete[] m_l1_cache;
   delete[] m_l2_cache;
   delete[] m_l3_cache;
@@ -1742,7 +1923,7 @@ bool memory_c::new_mem_req(Mem_Req_Type type, Addr addr, uns size,
                            Counter unique_num, pref_req_info_s* pref_info,
                            int core_id, int thread_id, bool ptx) {
   DEBUG_CORE(core_id, "MSHR[%d] new_req type:%s (%d)\n", core_id,
-             mem_req_c::mem_req_type_name[type], (int)m_mshr[core_id].size());
+             mem_req_c::mem_req_type_name[type], m_mshr[core_id]->get_num_used());
 
   if (m_stop_prefetch > m_cycle && type == MRT_DPRF) {
     DEBUG_CORE(core_id, "PREFETCHING blocked\n");
@@ -1884,26 +2065,12 @@ bool memory_c::new_mem_req(Mem_Req_Type type, Addr addr, uns size,
 
 // allocate a new memory request
 mem_req_s* memory_c::allocate_new_entry(int core_id) {
-  if (m_mshr_free_list[core_id].empty()) return NULL;
-
-  mem_req_s* new_req = m_mshr_free_list[core_id].back();
-  m_mshr_free_list[core_id].pop_back();
-  m_mshr[core_id].push_back(new_req);
-
-  return new_req;
+  return m_mshr[core_id]->allocate();
 }
 
 // search matching request
 mem_req_s* memory_c::search_req(int core_id, Addr addr, int size) {
-  for (auto I = m_mshr[core_id].begin(), E = m_mshr[core_id].end(); I != E;
-       ++I) {
-    mem_req_s* req = (*I);
-    if (req->m_addr <= addr && req->m_addr + req->m_size >= addr + size) {
-      return req;
-    }
-  }
-
-  return NULL;
+  return m_mshr[core_id]->search(addr, size);
 }
 
 // initialize a new request
@@ -1943,6 +2110,9 @@ void memory_c::init_new_req(mem_req_s* req, Mem_Req_Type type, Addr addr,
   ASSERT(req->m_merge.empty());
 
   set_cache_id(req);
+
+  // ptx stores come from the request pool
+  if (req->m_mshr) req->m_mshr->update(req);
 }
 
 // adjust a new request
@@ -1977,6 +2147,9 @@ void memory_c::adjust_req(mem_req_s* req, Mem_Req_Type type, Addr addr,
   req->m_skip = false;
 
   set_cache_id(req);
+
+  // the entry stays in the MSHR it was allocated from
+  req->m_mshr->update(req);
 }
 
 // set each cache-level id : L1,L2: private to core, LLC: shared by cores
@@ -2009,8 +2182,7 @@ void memory_c::free_req(int core_id, mem_req_s* req) {
     delete req;
   } else {
     req->init();
-    m_mshr[core_id].remove(req);
-    m_mshr_free_list[core_id].push_back(req);
+    req->m_mshr->free(req);
   }
 }
 
@@ -2023,7 +2195,7 @@ void memory_c::free_write_req(mem_req_s* req) {
 
 // get number of available mshr entries
 int memory_c::get_num_avail_entry(int core_id) {
-  return m_mshr_free_list[core_id].size();
+  return m_mshr[core_id]->get_num_free();
 }
 
 // access L1 cache from execution stage
@@ -2077,6 +2249,33 @@ void memory_c::run_a_cycle(bool pll_lock) {
   ++m_cycle;
 }
 
+void memory_c::skip_cycles_core(int core_id, Counter n) {
+  m_l2_cache[core_id]->skip_cycles(n);
+  m_l1_cache[core_id]->skip_cycles(n);
+}
+
+void memory_c::skip_cycles(Counter n) {
+  for (int ii = 0; ii < m_num_llc; ++ii) m_llc_cache[ii]->skip_cycles(n);
+  for (int ii = 0; ii < m_num_l3; ++ii) m_l3_cache[ii]->skip_cycles(n);
+  m_cycle += n;
+}
+
+bool memory_c::is_quiescent(void) {
+  for (int ii = 0; ii < m_num_core; ++ii) {
+    bool waiting = true;
+    m_mshr[ii]->for_each([&](mem_req_s* req) {
+      if (req->m_state != MEM_DRAM_START) waiting = false;
+    });
+    if (!waiting) return false;
+    if (!m_l1_cache[ii]->is_idle() || !m_l2_cache[ii]->is_idle()) return false;
+  }
+  for (int ii = 0; ii < m_num_l3; ++ii)
+    if (!m_l3_cache[ii]->is_idle()) return false;
+  for (int ii = 0; ii < m_num_llc; ++ii)
+    if (!m_llc_cache[ii]->is_idle()) return false;
+  return true;
+}
+
 void memory_c::run_a_cycle_core(int core_id, bool pll_lock) {
   m_l2_cache[core_id]->run_a_cycle(pll_lock);
   m_l1_cache[core_id]->run_a_cycle(pll_lock);
@@ -2156,8 +2355,7 @@ void memory_c::print_mshr(void) {
             "IN_TIME", "DELTA", "TYPE", "STATE", "MERGED", "MERGED_ID",
             "MERGED_TYPE", "MERGED_STATE");
 
-    for (auto I = m_mshr[ii].begin(), E = m_mshr[ii].end(); I != E; ++I) {
-      mem_req_s* req = (*I);
+    m_mshr[ii]->for_each([&](mem_req_s* req) {
       fprintf(
         fp, "%-20d %-10llu %-10llu %-15s %-15s %-7d %-20d %-15s %-15s\n",
         req->m_id, req->m_in, m_cycle - req->m_in,
@@ -2169,7 +2367,7 @@ void memory_c::print_mshr(void) {
            : "NULL"),
         (req->m_merged_req ? mem_req_c::mem_state[req->m_merged_req->m_state]
                            : NULL));
-    }
+    });
     fprintf(fp, "\n");
   }
   fclose(fp);
@@ -2178,12 +2376,11 @@ void memory_c::print_mshr(void) {
 // flush all prefetches in the mshr
 void memory_c::flush_prefetch(int core_id) {
   list<mem_req_s*> done_list;
-  for (auto I = m_mshr[core_id].begin(), E = m_mshr[core_id].end(); I != E;
-       ++I) {
-    if ((*I)->m_type == MRT_DPRF && (*I)->m_merge.empty()) {
-      done_list.push_back((*I));
+  m_mshr[core_id]->for_each([&](mem_req_s* req) {
+    if (req->m_type == MRT_DPRF && req->m_merge.empty()) {
+      done_list.push_back(req);
     }
-  }
+  });
 
   for (auto I = done_list.begin(), E = done_list.end(); I != E; ++I) {
     if ((*I)->m_queue != NULL) {
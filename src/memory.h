@@ -216,6 +216,18 @@ public:
    */
   void run_a_cycle(bool);
 
+  /**
+   * Fast-forward the cache clock over n quiescent cycles
+   */
+  void skip_cycles(Counter n) {
+    m_cycle += n;
+  }
+
+  /**
+   * No request in any queue of this cache
+   */
+  bool is_idle(void);
+
   /**
    * Check available buffer space
    */
@@ -323,6 +335,113 @@ private:
   Counter m_cycle; /**< clock cycle */
 };
 
+///////////////////////////////////////////////////////////////////////////////////////////////
+/// \brief MSHR of one core
+///
+/// A fixed pool of entries. Allocated entries are linked in allocation order
+/// and indexed in an open-addressed hash table by every line they cover, so
+/// search, allocate and free take constant time. When several entries cover an
+/// address, search returns the earliest allocated one.
+///////////////////////////////////////////////////////////////////////////////////////////////
+class mshr_c
+{
+public:
+  /**
+   * Constructor
+   */
+  mshr_c(macsim_c* simBase, int size);
+
+  /**
+   * Destructor
+   */
+  ~mshr_c();
+
+  /**
+   * Allocate an entry, NULL if full
+   */
+  mem_req_s* allocate(void);
+
+  /**
+   * Return an entry to the free list. m_addr may already be cleared.
+   */
+  void free(mem_req_s* req);
+
+  /**
+   * Re-index an entry after its m_addr or m_size changed
+   */
+  void update(mem_req_s* req);
+
+  /**
+   * Search the entry covering [addr, addr + size)
+   */
+  mem_req_s* search(Addr addr, int size);
+
+  /**
+   * Number of free entries
+   */
+  int get_num_free(void) {
+    return m_num_free;
+  }
+
+  /**
+   * Number of allocated entries
+   */
+  int get_num_used(void) {
+    return m_size - m_num_free;
+  }
+
+  /**
+   * Call func on each allocated entry in allocation order. func must not
+   * free entries.
+   */
+  template <typename F>
+  void for_each(F func) {
+    for (int slot = m_head; slot != -1; slot = m_slot[slot].m_next)
+      func(m_slot[slot].m_req);
+  }
+
+private:
+  /**
+   * Entry of the pool
+   */
+  struct slot_s {
+    mem_req_s* m_req; /**< request */
+    int m_prev; /**< previous allocated entry */
+    int m_next; /**< next allocated entry, or next free entry */
+    Counter m_seq; /**< allocation order */
+    Addr m_line; /**< first indexed line */
+    int m_num_lines; /**< number of indexed lines, 0 if not indexed */
+    bool m_wide; /**< too many lines, kept on the wide list instead */
+  };
+
+  /**
+   * Index entry, m_slot is -1 when empty
+   */
+  struct index_s {
+    Addr m_line; /**< line address */
+    int m_slot; /**< entry index */
+  };
+
+  int home(Addr line);
+  void insert_index(Addr line, int slot);
+  void remove_index(Addr line, int slot);
+  void index(int slot);
+  void unindex(int slot);
+  bool covers(mem_req_s* req, Addr addr, int size);
+
+  int m_size; /**< number of entries */
+  int m_num_free; /**< number of free entries */
+  slot_s* m_slot; /**< entries */
+  int m_head; /**< oldest allocated entry */
+  int m_tail; /**< youngest allocated entry */
+  int m_free; /**< free list head */
+  Counter m_seq; /**< allocation counter */
+  index_s* m_index; /**< line index */
+  int m_index_bits; /**< log2 of the index size */
+  list<int> m_wide; /**< entries spanning too many lines to index */
+  macsim_c* m_simBase; /**< macsim_c base class for simulation globals */
+};
+
 ///////////////////////////////////////////////////////////////////////////////////////////////
 /// \brief memory system
 ///////////////////////////////////////////////////////////////////////////////////////////////
@@ -406,6 +525,22 @@ public:
    */
   void run_a_cycle_uncore(bool);
 
+  /**
+   * Fast-forward L1/L2 (core, private) caches over n quiescent cycles
+   */
+  void skip_cycles_core(int core_id, Counter n);
+
+  /**
+   * Fast-forward the memory system (LLC, L3) over n quiescent cycles
+   */
+  void skip_cycles(Counter n);
+
+  /**
+   * Every cache queue is empty and every outstanding miss waits in a memory
+   * controller for the SSD
+   */
+  bool is_quiescent(void);
+
   /**
    * Deallocate completed memory request
    */
@@ -538,8 +673,7 @@ protected:
   dcu_c** m_l2_cache; /**< L2 caches */
   dcu_c** m_l3_cache; /**< L3 caches */
   dcu_c** m_llc_cache; /**< LLC caches */
-  list<mem_req_s*>* m_mshr; /**< mshr entry per L1 cache */
-  list<mem_req_s*>* m_mshr_free_list; /**< mshr entry free list */
+  mshr_c** m_mshr; /**< mshr per L1 cache */
   int m_num_core; /**< number of cores */
   int m_num_cpu;
   int m_num_gpu;
@@ -171,6 +171,10 @@ typedef struct mem_req_s {
   Counter m_noc_cycle; /**< noc start cycle */
   macsim_c* m_simBase; /**< reference to macsim base class for sim globals */
 
+  // MSHR bookkeeping, kept across init()
+  mshr_c* m_mshr = NULL; /**< owning MSHR, NULL if not an MSHR entry */
+  int m_mshr_slot = -1; /**< entry index in the owning MSHR */
+
   //Skybyte:
   bool m_need_context_switch = false;
   uint64_t fetch_stall_end_time = 0;
@@ -133,6 +133,22 @@ void MMU::initialize(macsim_c *simBase) {
     m_simBase, m_simBase->m_knobs->KNOB_TLB_NUM_ENTRY->getValue(), m_page_size);
 
   m_walk_latency = m_simBase->m_knobs->KNOB_PAGE_TABLE_WALK_LATENCY->getValue();
+
+  m_walk_levels = m_simBase->m_knobs->KNOB_PAGE_TABLE_LEVELS->getValue();
+  if (m_walk_levels) {
+    ASSERTM(m_walk_levels == 4 || m_walk_levels == 5,
+            "page_table_levels should be 0, 4 or 5.\n");
+    ASSERTM(m_offset_bits == 12 || m_offset_bits == 21 || m_offset_bits == 30,
+            "Radix page table walks need 4KB, 2MB or 1GB pages.\n");
+    m_leaf_level = (m_offset_bits - 12) / 9;
+    m_pwc_latency = m_simBase->m_knobs->KNOB_PWC_LATENCY->getValue();
+
+    // levels above the leaf cache the pointer to the next table
+    long pwc_entries = m_simBase->m_knobs->KNOB_PWC_NUM_ENTRY->getValue();
+    m_pwc.resize(m_walk_levels);
+    for (int level = m_leaf_level + 1; level < m_walk_levels; ++level)
+      m_pwc[level] = make_unique<ReplacementUnit>(m_simBase, pwc_entries);
+  }
   m_fault_latency = m_simBase->m_knobs->KNOB_PAGE_FAULT_LATENCY->getValue();
   m_eviction_latency =
     m_simBase->m_knobs->KNOB_PAGE_EVICTION_LATENCY->getValue();
@@ -189,11 +205,15 @@ bool MMU::translate(uop_c *cur_uop) {
         .end())  // this page is already being serviced, so piggyback
     it->second.emplace_back(cur_uop);
   else {
-    Counter ready_cycle = m_cycle + m_walk_latency;
-    m_walk_queue_cycle.emplace(ready_cycle, list<Addr>());
-    m_walk_queue_cycle[ready_cycle].emplace_back(page_number);
     m_walk_queue_page.emplace(page_number, list<uop_c *>());
     m_walk_queue_page[page_number].emplace_back(cur_uop);
+    if (m_walk_levels)
+      start_walk(cur_uop, page_number);
+    else {
+      Counter ready_cycle = m_cycle + m_walk_latency;
+      m_walk_queue_cycle.emplace(ready_cycle, list<Addr>());
+      m_walk_queue_cycle[ready_cycle].emplace_back(page_number);
+    }
   }
 
   cur_uop->m_state = OS_TRANS_WALK_QUEUE;
@@ -282,6 +302,18 @@ void MMU::run_a_cycle(bool pll_lock) {
     m_fault_retry_queue_processing.clear();
   }
 
+  // issue page table entry reads of radix walks
+  // a read rejected by a full MSHR is retried in the next cycle
+  for (auto it = m_walk_read_cycle.begin(); it != m_walk_read_cycle.end();
+       /* do nothing */) {
+    if (it->first <= m_cycle) {
+      for (auto &&p : it->second)
+        if (!issue_walk_read(p)) m_walk_read_cycle[m_cycle + 1].emplace_back(p);
+      it = m_walk_read_cycle.erase(it);
+    } else
+      break;
+  }
+
   // do page table walks
   for (auto it = m_walk_queue_cycle.begin(); it != m_walk_queue_cycle.end();
        /* do nothing */) {
@@ -378,6 +410,90 @@ void MMU::do_page_table_walks(uop_c *cur_uop) {
   }
 }
 
+// begin a radix walk below the deepest level that hits in the page walk caches
+void MMU::start_walk(uop_c *cur_uop, Addr page_number) {
+  Addr vaddr = cur_uop->m_vaddr;
+  int level = m_walk_levels - 1;
+  for (int l = m_leaf_level + 1; l < m_walk_levels; ++l) {
+    Addr key = vaddr >> (12 + 9 * l);
+    if (m_pwc[l]->lookup(key)) {
+      m_pwc[l]->update(key);
+      level = l - 1;
+      break;
+    }
+  }
+
+  if (level < m_walk_levels - 1)
+    STAT_EVENT(PWC_HIT);
+  else
+    STAT_EVENT(PWC_MISS);
+
+  m_walks[page_number] = {vaddr, cur_uop->m_core_id, cur_uop->m_thread_id,
+                          level, m_cycle};
+  m_walk_read_cycle[m_cycle + m_pwc_latency].emplace_back(page_number);
+
+  DEBUG("walk begins at %llu page_number:%llx level:%d\n", m_cycle,
+        page_number, level);
+}
+
+// read the next entry through the L2 like an L1 miss
+bool MMU::issue_walk_read(Addr page_number) {
+  PageWalk &walk = m_walks[page_number];
+  Addr line_addr = get_pte_addr(walk.vaddr, walk.level) & ~63ULL;
+
+  function<bool(mem_req_s *)> done_func = [this,
+                                           page_number](mem_req_s *req) {
+    if (!dcache_fill_line_wrapper(req)) return false;
+    walk_read_done(page_number);
+    return true;
+  };
+
+  if (!m_simBase->m_memory->new_mem_req(MRT_DFETCH, line_addr, 64, false,
+                                        false, 0, NULL, done_func, 0, NULL,
+                                        walk.core_id, walk.thread_id, false))
+    return false;
+
+  STAT_EVENT(PTW_MEM_ACCESS);
+  return true;
+}
+
+void MMU::walk_read_done(Addr page_number) {
+  auto it = m_walks.find(page_number);
+  assert(it != m_walks.end());
+  PageWalk &walk = it->second;
+
+  if (walk.level > m_leaf_level) {
+    Addr key = walk.vaddr >> (12 + 9 * walk.level);
+    if (m_pwc[walk.level]->lookup(key))
+      m_pwc[walk.level]->update(key);
+    else
+      m_pwc[walk.level]->insert(key);
+
+    --walk.level;
+    m_walk_read_cycle[m_cycle].emplace_back(page_number);
+    return;
+  }
+
+  // translation found, continue as the flat model does after its latency
+  STAT_EVENT(AVG_PTW_LATENCY_BASE);
+  STAT_EVENT_N(AVG_PTW_LATENCY, m_cycle - walk.start_cycle);
+  m_walks.erase(it);
+
+  m_walk_queue_cycle.emplace(m_cycle, list<Addr>());
+  m_walk_queue_cycle[m_cycle].emplace_back(page_number);
+}
+
+// Tables are placed in the page table region by hashing their level and the
+// address bits above them, so the same trace touches the same table pages in
+// every run (the SSD is prefilled with the pages a prefill pass touched).
+Addr MMU::get_pte_addr(Addr vaddr, int level) {
+  Addr table = vaddr >> (12 + 9 * (level + 1));
+  Addr hash = (table ^ ((Addr)level << 58)) * 0x9E3779B97F4A7C15ULL;
+  Addr frame = hash >> (64 - (PAGE_TABLE_REGION_BITS - 12));
+  Addr index = (vaddr >> (12 + 9 * level)) & 511;
+  return PAGE_TABLE_REGION_BASE + (frame << 12) + index * 8;
+}
+
 void MMU::handle_page_faults() {
   // do batch processing if it has started
   if (m_batch_processing) {
@@ -50,6 +50,10 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "uop.h"
 #include "tlb.h"
 
+// physical region holding the radix page table, above user addresses
+#define PAGE_TABLE_REGION_BASE 0xF00000000000ULL
+#define PAGE_TABLE_REGION_BITS 32
+
 class MMU  // Memory Management Unit
 {
 private:
@@ -87,6 +91,9 @@ private:
       delete[] m_entries;
     }
 
+    bool lookup(Addr page_number) {
+      return m_table.find(page_number) != m_table.end();
+    }
     void insert(Addr page_number);
     void update(Addr page_number);
     Addr getVictim();
@@ -129,13 +136,41 @@ public:
   void initialize(macsim_c *simBase);
   void finalize();
   void run_a_cycle(bool);
+  void skip_cycles(Counter n) {
+    m_cycle += n;
+  }
+  bool is_idle() const {
+    return m_walk_queue_cycle.empty() && m_retry_queue.empty() &&
+           m_fault_retry_queue.empty() && m_fault_buffer.empty() &&
+           m_fault_buffer_processing.empty() && !m_batch_processing &&
+           m_walks.empty();
+  }
 
   bool translate(uop_c *cur_uop);
   void handle_page_faults();
 
+  bool is_page_table_addr(Addr addr) const {
+    return m_walk_levels && addr >= PAGE_TABLE_REGION_BASE &&
+           addr < PAGE_TABLE_REGION_BASE + (1ULL << PAGE_TABLE_REGION_BITS);
+  }
+
 private:
+  // radix page table walk in flight
+  struct PageWalk {
+    Addr vaddr;
+    int core_id;
+    int thread_id;
+    int level;  // level of the next entry to read
+    Counter start_cycle;
+  };
+
   void do_page_table_walks(uop_c *cur_uop);
 
+  void start_walk(uop_c *cur_uop, Addr page_number);
+  bool issue_walk_read(Addr page_number);
+  void walk_read_done(Addr page_number);
+  Addr get_pte_addr(Addr vaddr, int level);
+
   void begin_batch_processing();
   bool do_batch_processing();
 
@@ -162,6 +197,13 @@ private:
   unique_ptr<ReplacementUnit> m_replacement_unit;
 
   long m_walk_latency;
+
+  int m_walk_levels;  // 0: flat m_walk_latency
+  int m_leaf_level;  // 0: 4KB, 1: 2MB, 2: 1GB pages
+  int m_pwc_latency;
+  vector<unique_ptr<ReplacementUnit>> m_pwc;  // page walk cache per level
+  unordered_map<Addr, PageWalk> m_walks;  // indexed by page number
+  map<Counter, list<Addr>> m_walk_read_cycle;  // next entry read by cycle
   long m_fault_latency;
   long m_eviction_latency;
 
@@ -120,6 +120,17 @@ network_c::~network_c() {
   delete m_credit_pool;
 }
 
+void network_c::skip_cycles(Counter n) {
+  for (int ii = 0; ii < m_num_router; ++ii) m_router[ii]->skip_cycles(n);
+  m_cycle += n;
+}
+
+bool network_c::is_idle(void) {
+  for (int ii = 0; ii < m_num_router; ++ii)
+    if (!m_router[ii]->is_idle()) return false;
+  return true;
+}
+
 bool network_c::send(mem_req_s* req, int src_level, int src_id, int dst_level,
                      int dst_id) {
   req->m_msg_src = m_router_map[src_level * 1000 + src_id];
@@ -276,6 +287,22 @@ void router_c::run_a_cycle(bool pll_lock) {
   ++m_cycle;
 }
 
+void router_c::skip_cycles(Counter n) {
+  m_cycle += n;
+}
+
+// nothing to inject, eject or forward, and no credit on its way back
+bool router_c::is_idle(void) {
+  if (!m_injection_buffer->empty() || !m_req_buffer->empty() ||
+      !m_pending_credit->empty())
+    return false;
+  for (int ii = 0; ii < m_num_port; ++ii)
+    for (int jj = 0; jj < m_num_vc; ++jj)
+      if (!m_input_buffer[ii][jj].empty() || !m_output_buffer[ii][jj].empty())
+        return false;
+  return true;
+}
+
 // insert a packet from the network interface (NI)
 bool router_c::inject_packet(mem_req_s* req) {
   if (m_injection_buffer->size() < m_injection_buffer_max_size) {
@@ -156,6 +156,8 @@ public:
   virtual int get_id(void);
   virtual void set_id(int id);
   virtual void run_a_cycle(bool pll_lock);
+  virtual void skip_cycles(Counter n);
+  virtual bool is_idle(void);
   virtual void print_link_info() = 0;
   virtual void print(ofstream& out);
   virtual void insert_packet(flit_c* flit, int ip, int ivc);
@@ -326,6 +328,12 @@ public:
 
   virtual void run_a_cycle(bool pll_lock) = 0;
 
+  // fast-forward every router over n quiescent cycles
+  virtual void skip_cycles(Counter n);
+
+  // no packet or credit anywhere in the network
+  bool is_idle(void);
+
   virtual void print() = 0;
 
 protected:
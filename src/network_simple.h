@@ -47,6 +47,8 @@ public:
   ~router_simple_c();
 
   virtual void run_a_cycle(bool);
+  virtual void skip_cycles(Counter n) {
+  }
   void process(void);
   virtual void print_link_info(void);
   virtual void stage_rc(void);
@@ -91,10 +91,12 @@ uint64_t FCFSPageMapper::translate(uint64_t virtual_address) {
 RegionBasedFCFSPageMapper::RegionBasedFCFSPageMapper(macsim_c* simBase,
                                                      uint32_t page_size,
                                                      uint64_t region_size)
-  : PageMapper(simBase, page_size, 0), m_region_size(region_size) {
+  : PageMapper(simBase, page_size, 0),
+    m_region_size(max(region_size, (uint64_t)page_size)) {
   REPORT("## Region-based FCFS virtual to physical translation enabled");
-  ASSERTM(region_size >= page_size,
-          "The page size should be smaller than the region size.\n");
+  // with 2MB or 1GB pages a region is at least one page
+  if (region_size < page_size)
+    REPORT("## Region size raised to the page size (%u)", page_size);
 }
 
 // Destructor
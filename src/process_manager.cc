@@ -78,6 +78,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "process_manager.h"
 #include "pref_common.h"
 #include "trace_read.h"
+#include "trace_stream.h"
 
 #include "debug_macros.h"
 
@@ -159,6 +160,7 @@ thread_s::thread_s(macsim_c *simBase) {
   m_buffer = new char[1000 * buf_ele_size];
   m_prev_trace_info = NULL;
   m_next_trace_info = NULL;
+  m_trace_stream = NULL;
 
   for (int ii = 0; ii < MAX_PUP; ++ii) {
     m_trace_uop_array[ii] = new trace_uop_s;
@@ -817,11 +819,19 @@ thread_s *process_manager_c::create_thread(process_s *process, int tid,
   sstr >> filename;
 
 #ifndef USING_QSIM
-  // open trace file
-  trace_info->m_trace_file = gzopen(filename.c_str(), "r");
+  // open trace file, cpu traces are decoded by the background decoders if enabled
+  if (!process->m_acc && m_simBase->m_trace_decoder->enabled()) {
+    trace_info->m_trace_file = NULL;
+    trace_info->m_trace_stream = m_simBase->m_trace_decoder->open(filename);
+    if (!trace_info->m_trace_stream->is_open())
+      ASSERTM(0, "error opening trace file:%s\n", filename.c_str());
+  } else {
+    trace_info->m_trace_stream = NULL;
+    trace_info->m_trace_file = gzopen(filename.c_str(), "r");
+    if (trace_info->m_trace_file == NULL)
+      ASSERTM(0, "error opening trace file:%s\n", filename.c_str());
+  }
   cout<<"Filename: "<<filename<<" Opened."<<endl;
-  if (trace_info->m_trace_file == NULL)
-    ASSERTM(0, "error opening trace file:%s\n", filename.c_str());
 #endif
 
   trace_info->m_file_opened = true;
@@ -1020,7 +1030,12 @@ int process_manager_c::terminate_thread(int core_id, thread_s *trace_info,
     }
   }
 
-  gzclose(trace_info->m_trace_file);
+  if (trace_info->m_trace_stream) {
+    m_simBase->m_trace_decoder->close(trace_info->m_trace_stream);
+    trace_info->m_trace_stream = NULL;
+  } else {
+    gzclose(trace_info->m_trace_file);
+  }
 
   // release thread_trace_info to the pool
   m_simBase->m_thread_pool->release_entry(trace_info);
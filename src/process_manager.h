@@ -212,6 +212,7 @@ typedef struct thread_s {
   int m_orig_thread_id; /**< adjusted block id */
   int m_block_id; /**< block id */
   gzFile m_trace_file; /**< gzip trace file */
+  trace_stream_c* m_trace_stream; /**< decoded in the background, NULL if read directly */
   bool m_file_opened; /**< trace file opened? */
   bool m_main_thread; /**< main thread (usually thread id 0) */
   uint64_t m_inst_count; /**< total instruction counts */
@@ -66,6 +66,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #endif
 
 #include "all_knobs.h"
+#include "trace_stream.h"
 
 ///////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -180,6 +181,16 @@ trace_read_c::trace_read_c(macsim_c *simBase, ofstream *dprint_output) {
 trace_read_c::~trace_read_c() {
 }
 
+/**
+ * Read from the decoded stream of a thread, or inflate its trace file directly
+ */
+static inline int read_trace_file(thread_s *thread_trace_info, void *buf,
+                                  unsigned len) {
+  if (thread_trace_info->m_trace_stream)
+    return thread_trace_info->m_trace_stream->read(buf, len);
+  return gzread(thread_trace_info->m_trace_file, buf, len);
+}
+
 /**
  * This function is called once for each thread/warp when the thread/warp is started.
  * The simulator does read-ahead of the trace file to get next pc address
@@ -194,8 +205,8 @@ void trace_read_c::setup_trace(int core_id, int sim_thread_id) {
   // will be read ahead to get next pc address
   if (core->m_running_thread_num) {
 #ifndef USING_QSIM
-    gzread(thread_trace_info->m_trace_file,
-           thread_trace_info->m_prev_trace_info, m_trace_size);
+    read_trace_file(thread_trace_info,
+                    thread_trace_info->m_prev_trace_info, m_trace_size);
            std::cout<<"Trace size = "<<m_trace_size<<std::endl;
 #else
     m_tg->read_trace(core_id, (void *)(thread_trace_info->m_prev_trace_info),
@@ -234,8 +245,8 @@ bool trace_read_c::read_trace(int core_id, void *trace_info, int sim_thread_id,
       if (thread_trace_info->m_buffer_index == 0) {
 #ifndef USING_QSIM
         thread_trace_info->m_buffer_index_max =
-          gzread(thread_trace_info->m_trace_file, thread_trace_info->m_buffer,
-                 m_trace_size * k_trace_buffer_size);
+          read_trace_file(thread_trace_info, thread_trace_info->m_buffer,
+                          m_trace_size * k_trace_buffer_size);
 #else
         int uops_read = m_tg->read_trace(core_id, thread_trace_info->m_buffer,
                                          m_trace_size * k_trace_buffer_size);
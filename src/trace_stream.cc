@@ -0,0 +1,324 @@
+/*
+Copyright (c) <2012>, <Georgia Institute of Technology> All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted
+provided that the following conditions are met:
+
+Redistributions of source code must retain the above copyright notice, this list of conditions
+and the following disclaimer.
+
+Redistributions in binary form must reproduce the above copyright notice, this list of
+conditions and the following disclaimer in the documentation and/or other materials provided
+with the distribution.
+
+Neither the name of the <Georgia Institue of Technology> nor the names of its contributors
+may be used to endorse or promote products derived from this software without specific prior
+written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/**********************************************************************************************
+ * File         : trace_stream.cc
+ * Author       : HPArch Research Group
+ * Date         :
+ * Description  : Background trace decompression
+ *********************************************************************************************/
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "assert_macros.h"
+#include "trace_stream.h"
+
+static inline void trace_stream_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#else
+  std::this_thread::yield();
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+//  trace_stream_c
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+trace_stream_c::trace_stream_c(trace_decoder_c *decoder, const string &filename)
+  : m_decoder(decoder),
+    m_filename(filename),
+    m_cache_name(filename + TRACE_CACHE_SUFFIX),
+    m_gz(NULL),
+    m_cache_fd(-1),
+    m_cache_out(NULL),
+    m_cache_bytes(0),
+    m_depth(decoder->m_depth),
+    m_batch(decoder->m_depth, NULL),
+    m_batch_len(decoder->m_depth, 0),
+    m_produced(0),
+    m_consumed(0),
+    m_eof(false),
+    m_offset(0),
+    m_busy(false),
+    m_closing(false),
+    m_waiting(false) {
+  memset(&m_src_info, 0, sizeof(m_src_info));
+  struct stat src_stat;
+  if (stat(filename.c_str(), &src_stat) != 0) return;
+  m_src_info.m_src_size = src_stat.st_size;
+  m_src_info.m_src_mtime_ns =
+    (int64_t)src_stat.st_mtim.tv_sec * 1000000000 + src_stat.st_mtim.tv_nsec;
+
+  // replay a complete cache of the same trace without touching zlib
+  if (decoder->m_binary_cache) {
+    int fd = ::open(m_cache_name.c_str(), O_RDONLY);
+    if (fd >= 0) {
+      trace_cache_header_s header;
+      struct stat cache_stat;
+      bool valid =
+        ::read(fd, &header, sizeof(header)) == sizeof(header) &&
+        fstat(fd, &cache_stat) == 0 &&
+        memcmp(header.m_magic, TRACE_CACHE_MAGIC, sizeof(header.m_magic)) == 0 &&
+        header.m_src_size == m_src_info.m_src_size &&
+        header.m_src_mtime_ns == m_src_info.m_src_mtime_ns &&
+        header.m_data_bytes + sizeof(header) == (uint64_t)cache_stat.st_size;
+      if (valid) {
+        m_cache_fd = fd;
+        return;
+      }
+      ::close(fd);
+    }
+  }
+
+  m_gz = gzopen(filename.c_str(), "r");
+  if (m_gz != NULL && decoder->m_binary_cache) open_cache_out();
+}
+
+trace_stream_c::~trace_stream_c() {
+  if (m_cache_out != NULL) close_cache_out(false);
+  if (m_gz != NULL) gzclose(m_gz);
+  if (m_cache_fd >= 0) ::close(m_cache_fd);
+  for (char *batch : m_batch) delete[] batch;
+}
+
+void trace_stream_c::open_cache_out(void) {
+  // unique per stream, the same trace may be opened by several threads
+  m_cache_tmp_name = m_cache_name + ".tmp." + std::to_string(getpid()) + "." +
+                     std::to_string((uintptr_t)this);
+  m_cache_out = fopen(m_cache_tmp_name.c_str(), "wb");
+  if (m_cache_out == NULL) return;
+
+  // placeholder header, the magic is only written once the trace is complete
+  trace_cache_header_s header = m_src_info;
+  if (fwrite(&header, sizeof(header), 1, m_cache_out) != 1) close_cache_out(false);
+}
+
+void trace_stream_c::close_cache_out(bool complete) {
+  if (complete) {
+    trace_cache_header_s header = m_src_info;
+    memcpy(header.m_magic, TRACE_CACHE_MAGIC, sizeof(header.m_magic));
+    header.m_data_bytes = m_cache_bytes;
+    complete = fseek(m_cache_out, 0, SEEK_SET) == 0 &&
+               fwrite(&header, sizeof(header), 1, m_cache_out) == 1;
+  }
+  complete = fclose(m_cache_out) == 0 && complete;
+  m_cache_out = NULL;
+
+  if (complete && rename(m_cache_tmp_name.c_str(), m_cache_name.c_str()) == 0) return;
+  unlink(m_cache_tmp_name.c_str());
+}
+
+int trace_stream_c::read_source(char *buf, unsigned len) {
+  if (m_gz != NULL) return gzread(m_gz, buf, len);
+
+  unsigned total = 0;
+  while (total < len) {
+    ssize_t nread = ::read(m_cache_fd, buf + total, len - total);
+    if (nread < 0) return -1;
+    if (nread == 0) break;
+    total += nread;
+  }
+  return total;
+}
+
+void trace_stream_c::fill_batch(void) {
+  uint64_t slot = m_produced.load(std::memory_order_relaxed) % m_depth;
+  if (m_batch[slot] == NULL) m_batch[slot] = new char[TRACE_STREAM_BATCH_BYTES];
+
+  int nread = read_source(m_batch[slot], TRACE_STREAM_BATCH_BYTES);
+  bool eof = nread < TRACE_STREAM_BATCH_BYTES;
+  // a read error leaves the trace truncated, keep it out of the cache
+  bool complete = nread >= 0 && (m_gz == NULL || gzeof(m_gz));
+  if (nread < 0) nread = 0;
+
+  if (m_cache_out != NULL) {
+    if (nread > 0 && fwrite(m_batch[slot], 1, nread, m_cache_out) != (size_t)nread)
+      close_cache_out(false);
+    else
+      m_cache_bytes += nread;
+    if (m_cache_out != NULL && eof) close_cache_out(complete);
+  }
+
+  if (nread > 0) {
+    m_batch_len[slot] = nread;
+    m_decoder->m_buffered.fetch_add(nread);
+    m_produced.fetch_add(1, std::memory_order_release);
+  }
+  if (eof) m_eof.store(true, std::memory_order_release);
+}
+
+int trace_stream_c::read(void *buf, unsigned len) {
+  unsigned copied = 0;
+  uint64_t consumed = m_consumed.load(std::memory_order_relaxed);
+  int spins = 0;
+  while (copied < len) {
+    if (consumed == m_produced.load(std::memory_order_acquire)) {
+      // m_eof is set after the last batch is published
+      if (m_eof.load(std::memory_order_acquire) &&
+          consumed == m_produced.load(std::memory_order_acquire))
+        break;
+      if (++spins < TRACE_STREAM_SPIN_ITERS) {
+        trace_stream_relax();
+        continue;
+      }
+
+      // the decoder publishes before it takes the lock to notify, so the
+      // check under the lock cannot miss a batch
+      std::unique_lock<std::mutex> lk(m_decoder->m_lock);
+      m_waiting = true;
+      m_data_cv.wait(lk, [this, consumed] {
+        return consumed != m_produced.load(std::memory_order_acquire) ||
+               m_eof.load(std::memory_order_acquire);
+      });
+      m_waiting = false;
+      spins = 0;
+      continue;
+    }
+
+    uint64_t slot = consumed % m_depth;
+    unsigned chunk = std::min(len - copied, m_batch_len[slot] - m_offset);
+    memcpy((char *)buf + copied, m_batch[slot] + m_offset, chunk);
+    copied += chunk;
+    m_offset += chunk;
+
+    // batch done, hand it back to the decoders
+    if (m_offset == m_batch_len[slot]) {
+      m_offset = 0;
+      m_decoder->m_buffered.fetch_sub(m_batch_len[slot]);
+      m_consumed.store(++consumed);
+      m_decoder->notify_space();
+    }
+  }
+  return copied;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+//  trace_decoder_c
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+trace_decoder_c::trace_decoder_c(int num_threads, int depth, uint64_t mem_cap,
+                                 bool binary_cache)
+  : m_depth(std::max(depth, 2)),
+    m_mem_cap(mem_cap),
+    m_binary_cache(binary_cache),
+    m_next(0),
+    m_buffered(0),
+    m_idle(0),
+    m_stop(false) {
+  for (int ii = 0; ii < num_threads; ++ii)
+    m_workers.emplace_back(&trace_decoder_c::worker_loop, this);
+}
+
+trace_decoder_c::~trace_decoder_c() {
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_stop = true;
+  }
+  m_work_cv.notify_all();
+  for (auto &worker : m_workers) worker.join();
+  for (trace_stream_c *stream : m_streams) delete stream;
+}
+
+trace_stream_c *trace_decoder_c::open(const string &filename) {
+  trace_stream_c *stream = new trace_stream_c(this, filename);
+  if (!stream->is_open()) return stream;
+
+  std::lock_guard<std::mutex> guard(m_lock);
+  m_streams.push_back(stream);
+  m_work_cv.notify_one();
+  return stream;
+}
+
+void trace_decoder_c::close(trace_stream_c *stream) {
+  {
+    std::unique_lock<std::mutex> lk(m_lock);
+    stream->m_closing = true;
+    m_done_cv.wait(lk, [stream] { return !stream->m_busy; });
+    auto itr = std::find(m_streams.begin(), m_streams.end(), stream);
+    if (itr != m_streams.end()) m_streams.erase(itr);
+  }
+
+  // batches decoded but never read
+  uint64_t consumed = stream->m_consumed.load();
+  for (uint64_t ii = consumed; ii < stream->m_produced.load(); ++ii)
+    m_buffered.fetch_sub(stream->m_batch_len[ii % stream->m_depth]);
+  delete stream;
+}
+
+trace_stream_c *trace_decoder_c::pick(void) {
+  size_t num_streams = m_streams.size();
+  for (size_t ii = 0; ii < num_streams; ++ii) {
+    size_t index = (m_next + ii) % num_streams;
+    trace_stream_c *stream = m_streams[index];
+    if (stream->m_busy || stream->m_closing ||
+        stream->m_eof.load(std::memory_order_relaxed))
+      continue;
+
+    uint64_t ready = stream->m_produced.load() - stream->m_consumed.load();
+    if (ready >= (uint64_t)stream->m_depth) continue;
+    if (ready > 0 && m_buffered.load() + TRACE_STREAM_BATCH_BYTES > m_mem_cap) continue;
+
+    m_next = index + 1;
+    stream->m_busy = true;
+    return stream;
+  }
+  return NULL;
+}
+
+void trace_decoder_c::worker_loop(void) {
+  std::unique_lock<std::mutex> lk(m_lock);
+  while (true) {
+    // counted idle before looking, so a consumer freeing a batch meanwhile wakes us
+    ++m_idle;
+    trace_stream_c *stream = NULL;
+    while (!m_stop && (stream = pick()) == NULL) m_work_cv.wait(lk);
+    --m_idle;
+    if (m_stop) return;
+
+    lk.unlock();
+    stream->fill_batch();
+    lk.lock();
+
+    stream->m_busy = false;
+    if (stream->m_waiting) stream->m_data_cv.notify_one();
+    if (stream->m_closing) m_done_cv.notify_all();
+  }
+}
+
+void trace_decoder_c::notify_space(void) {
+  if (m_idle.load() > 0) {
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_work_cv.notify_one();
+  }
+}
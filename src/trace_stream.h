@@ -0,0 +1,216 @@
+/*
+Copyright (c) <2012>, <Georgia Institute of Technology> All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted
+provided that the following conditions are met:
+
+Redistributions of source code must retain the above copyright notice, this list of conditions
+and the following disclaimer.
+
+Redistributions in binary form must reproduce the above copyright notice, this list of
+conditions and the following disclaimer in the documentation and/or other materials provided
+with the distribution.
+
+Neither the name of the <Georgia Institue of Technology> nor the names of its contributors
+may be used to endorse or promote products derived from this software without specific prior
+written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/**********************************************************************************************
+ * File         : trace_stream.h
+ * Author       : HPArch Research Group
+ * Date         :
+ * Description  : Background trace decompression
+ *********************************************************************************************/
+
+#ifndef TRACE_STREAM_H_INCLUDED
+#define TRACE_STREAM_H_INCLUDED
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <zlib.h>
+
+#include "global_defs.h"
+
+using std::string;
+
+#define TRACE_STREAM_BATCH_BYTES (256 * 1024) /**< decoded bytes per batch */
+#define TRACE_CACHE_SUFFIX ".dec" /**< binary cache file, next to the trace */
+#define TRACE_CACHE_MAGIC "MSTRDEC1"
+#define TRACE_STREAM_SPIN_ITERS 4096 /**< consumer spins before it sleeps on an empty ring */
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+/// \brief header of a pre-decoded binary trace cache
+///
+/// The magic is written last, a cache whose magic does not match was not
+/// completed. The source size and modification time tie it to one trace.
+///////////////////////////////////////////////////////////////////////////////////////////////
+typedef struct trace_cache_header_s {
+  char m_magic[8]; /**< TRACE_CACHE_MAGIC once complete */
+  uint64_t m_src_size; /**< size of the gzip trace */
+  int64_t m_src_mtime_ns; /**< modification time of the gzip trace */
+  uint64_t m_data_bytes; /**< decoded bytes following the header */
+} trace_cache_header_s;
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+/// \brief decoded trace of one thread
+///
+/// Decoder threads inflate the trace (or read its binary cache) into a ring of
+/// batches, the simulation thread copies records out of the ring with read().
+/// One producer (whichever decoder claimed the stream) and one consumer.
+///////////////////////////////////////////////////////////////////////////////////////////////
+class trace_stream_c
+{
+  friend class trace_decoder_c;
+
+public:
+  /**
+   * Constructor, opens the trace or its cache
+   */
+  trace_stream_c(trace_decoder_c *decoder, const string &filename);
+
+  /**
+   * Destructor
+   */
+  ~trace_stream_c();
+
+  /**
+   * Trace opened successfully
+   */
+  bool is_open(void) { return m_gz != NULL || m_cache_fd >= 0; }
+
+  /**
+   * Copy up to len decoded bytes into buf, same contract as gzread.
+   * Waits only if the decoders fell behind, spinning briefly before it sleeps.
+   */
+  int read(void *buf, unsigned len);
+
+private:
+  /**
+   * Decode the next batch, called by a decoder thread
+   */
+  void fill_batch(void);
+
+  /**
+   * Read up to len bytes from the trace or its cache
+   */
+  int read_source(char *buf, unsigned len);
+
+  /**
+   * Start writing a cache while the trace is inflated
+   */
+  void open_cache_out(void);
+
+  /**
+   * Publish the cache once the whole trace was decoded, drop it otherwise
+   */
+  void close_cache_out(bool complete);
+
+  trace_decoder_c *m_decoder; /**< decoder pool serving the stream */
+  string m_filename; /**< trace file */
+  string m_cache_name; /**< binary cache file */
+  string m_cache_tmp_name; /**< cache being written */
+  gzFile m_gz; /**< trace, NULL when replaying from the cache */
+  int m_cache_fd; /**< cache being read, -1 if none */
+  FILE *m_cache_out; /**< cache being written, NULL if none */
+  uint64_t m_cache_bytes; /**< bytes written to the cache */
+  trace_cache_header_s m_src_info; /**< source identity for the cache header */
+
+  int m_depth; /**< batches in the ring */
+  std::vector<char *> m_batch; /**< batch buffers, allocated on first use */
+  std::vector<unsigned> m_batch_len; /**< decoded bytes in each batch */
+  std::atomic<uint64_t> m_produced; /**< batches decoded */
+  std::atomic<uint64_t> m_consumed; /**< batches fully read */
+  std::atomic<bool> m_eof; /**< trace decoded to the end */
+  unsigned m_offset; /**< read offset into the current batch */
+
+  // protected by the decoder mutex
+  bool m_busy; /**< a decoder is filling a batch */
+  bool m_closing; /**< thread terminated, no more batches */
+  bool m_waiting; /**< consumer sleeps on m_data_cv */
+  std::condition_variable m_data_cv; /**< consumer waits for a batch */
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+/// \brief pool of decoder threads shared by all trace streams
+///
+/// Decoders pick streams round robin and fill one batch at a time, as long as
+/// the stream's ring has room and the decoded bytes waiting in all rings stay
+/// below the memory cap. A stream with nothing buffered is always served.
+///////////////////////////////////////////////////////////////////////////////////////////////
+class trace_decoder_c
+{
+  friend class trace_stream_c;
+
+public:
+  /**
+   * Constructor, no threads are started with num_threads 0
+   */
+  trace_decoder_c(int num_threads, int depth, uint64_t mem_cap,
+                  bool binary_cache);
+
+  /**
+   * Destructor, stops the decoder threads
+   */
+  ~trace_decoder_c();
+
+  /**
+   * Whether traces are decoded in the background
+   */
+  bool enabled(void) { return !m_workers.empty(); }
+
+  /**
+   * Open a trace stream and start decoding it
+   */
+  trace_stream_c *open(const string &filename);
+
+  /**
+   * Stop decoding a stream and delete it
+   */
+  void close(trace_stream_c *stream);
+
+private:
+  /**
+   * Decoder thread body
+   */
+  void worker_loop(void);
+
+  /**
+   * Claim a stream that needs a batch, NULL if none, called with m_lock held
+   */
+  trace_stream_c *pick(void);
+
+  /**
+   * Wake a decoder after the consumer freed a batch
+   */
+  void notify_space(void);
+
+  int m_depth; /**< batches per stream */
+  uint64_t m_mem_cap; /**< cap on decoded bytes waiting in all rings */
+  bool m_binary_cache; /**< read and write binary caches */
+  std::vector<std::thread> m_workers; /**< decoder threads */
+  std::vector<trace_stream_c *> m_streams; /**< open streams */
+  size_t m_next; /**< round robin position in m_streams */
+  std::atomic<uint64_t> m_buffered; /**< decoded bytes waiting in all rings */
+  std::atomic<int> m_idle; /**< decoders waiting for work */
+  bool m_stop; /**< decoders exit once set */
+  std::mutex m_lock;
+  std::condition_variable m_work_cv; /**< decoders wait for work */
+  std::condition_variable m_done_cv; /**< close waits for the batch in flight */
+};
+
+#endif